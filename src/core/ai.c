@@ -0,0 +1,456 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include "ai.h"
+#include "kernels.h"
+#include "log.h"
+#include "elems/area.h"
+#include "elems/potion.h"
+#include "elems/troop.h"
+
+enum AI_PrivateConstants {
+    /* Attacks the lookahead policy plays out, best by AI_ScoreAttack first */
+    AI_CANDIDATE_CNT = 6,
+    AI_MIN_SEND_CNT = 8,
+    /* Areas nearest to an area it may send its troops to, all of them on small maps */
+    AI_TARGET_CNT = 32,
+    /* Troops a wave leaves with and ticks between waves, as SIM_EmitTroops has them */
+    AI_WAVE_CNT = 5,
+    AI_WAVE_TICKS = 25,
+    /* Production an area is worth, counted over this many ticks */
+    AI_VALUE_TICKS = 30 * SIM_TICK_RATE,
+    AI_AREA_VALUE = 10,
+    /* Keeps close targets from winning on travel time alone */
+    AI_TRAVEL_BIAS = 2 * SIM_TICK_RATE,
+    /* Ticks between deadline checks while a candidate is played */
+    AI_CHECK_TICKS = 32
+};
+
+const AI_Policy* g_AIPolicies[] = {&AI_GreedyPolicy, &AI_LookaheadPolicy};
+
+/* NULL for "random" and unknown names, both of which leave players to SIM_RunAI */
+const AI_Policy* AI_GetPolicy(const char *name) {
+    for (int i = 0; i < (int)SDL_arraysize(g_AIPolicies); i++) {
+        if (!strcmp(g_AIPolicies[i]->name, name)) return g_AIPolicies[i];
+    }
+    if (strcmp(name, "random")) LogInfo("No AI named %s, going with random", name);
+    return NULL;
+}
+
+/* Troops heading for each area, incoming[area * player_cnt + owner] */
+void AI_CountIncoming(Map *map, int *incoming) {
+    memset(incoming, 0, sizeof(int) * map->area_cnt * map->player_cnt);
+    TroopStore *troops = map->troops;
+    for (int i = 0; i < troops->cnt; i++) {
+        ++incoming[troops->dst[i] * map->player_cnt + troops->owner[i]];
+    }
+}
+
+/* Troops the area would make until AI_VALUE_TICKS, and what owning it is worth besides */
+int AI_GetAreaValue(Map *map, int area) {
+    AreaState *state = &map->area_states[area];
+    int room = SDL_max(0, map->areas[area]->capacity - state->troop_cnt);
+    return AI_AREA_VALUE + SDL_min(room, AI_VALUE_TICKS / SDL_max(state->troop_rate, 1));
+}
+
+/* Ticks for troops of player to go from src to dst, the last wave included */
+int AI_GetTravelTicks(Map *map, int player, int src, int dst) {
+    SDL_Point from = map->areas[src]->center, to = map->areas[dst]->center;
+    double dist = sqrt((double)(from.x - to.x) * (from.x - to.x) + (double)(from.y - to.y) * (from.y - to.y));
+    int speed = (map->player_states[player].potion.type == TROOP_SPEED_X2 ? KRN_SPEED_ONE : KRN_SPEED_ONE / 2);
+    int waves = map->area_states[src].troop_cnt / AI_WAVE_CNT;
+    return dist * KRN_SPEED_ONE / speed + waves * AI_WAVE_TICKS;
+}
+
+/*
+ * How good it is for player to send everything in src to dst, by what
+ * dst is worth over the time it takes to get there. 0 or less for
+ * attacks that can't take dst or are not needed to hold it.
+ */
+int AI_ScoreAttack(Map *map, int player, int src, int dst, const int *incoming) {
+    AreaState *from = &map->area_states[src], *to = &map->area_states[dst];
+    if (ELE_GetAreaAppliedPotionType(map, dst) == AREA_SHIELD && to->conqueror != player) return 0;
+    int travel = AI_GetTravelTicks(map, player, src, dst);
+    const int *coming = &incoming[dst * map->player_cnt];
+    /* Some are lost to troops crossing their way */
+    int sent = from->troop_cnt * 9 / 10;
+    int enemies = 0;
+    for (int i = 0; i < map->player_cnt; i++) {
+        if (i != player && i != to->conqueror) enemies += coming[i];
+    }
+    int gain;
+    if (to->conqueror == player) {
+        /* Reinforcement, only where the area would fall otherwise */
+        int threat = enemies - to->troop_cnt - coming[player];
+        if (threat <= 0 || sent < threat) return 0;
+        gain = AI_GetAreaValue(map, dst);
+    } else {
+        int defenders = to->troop_cnt;
+        if (to->conqueror >= 0) {
+            defenders += coming[to->conqueror];
+            if (to->troop_cnt < map->areas[dst]->capacity) defenders += travel / SDL_max(to->troop_rate, 1);
+        }
+        if (sent + coming[player] <= defenders) return 0;
+        gain = AI_GetAreaValue(map, dst);
+        /* Taken from another player rather than from nobody */
+        if (to->conqueror >= 0) gain += gain / 2;
+    }
+    /* src is left empty, and lost if anyone is on the way */
+    int threat = 0;
+    for (int i = 0; i < map->player_cnt; i++) {
+        if (i != player) threat += incoming[src * map->player_cnt + i];
+    }
+    if (threat > 0) gain -= AI_GetAreaValue(map, src);
+    return gain * 1000 / (travel + AI_TRAVEL_BIAS);
+}
+
+int AI_CmpAreas(const void *first, const void *second) {
+    return *(const int*)first - *(const int*)second;
+}
+
+/*
+ * Up to max best attacks of player into cmds and their scores, best
+ * first. Each area only looks at the areas nearest to it.
+ */
+int AI_FindCandidates(Map *map, int player, AI_Context *ctx, SIM_Command *cmds, int *scores, int max) {
+    int *incoming = ctx->incoming;
+    AI_CountIncoming(map, incoming);
+    int cnt = 0;
+    /* The AI_TARGET_CNT nearest besides src itself */
+    int targets[AI_TARGET_CNT + 1];
+    for (int src = 0; src < map->area_cnt; src++) {
+        AreaState *state = &map->area_states[src];
+        if (state->conqueror != player || state->attack >= 0 || state->troop_cnt < AI_MIN_SEND_CNT) continue;
+        SDL_Point center = map->areas[src]->center;
+        int target_cnt = ELE_GetNearestAreas(map, center.x, center.y, targets, AI_TARGET_CNT + 1);
+        /* In index order, so equal scores pick the attack a scan of every area would */
+        qsort(targets, target_cnt, sizeof(int), AI_CmpAreas);
+        for (int t = 0; t < target_cnt; t++) {
+            int dst = targets[t];
+            if (dst == src) continue;
+            int score = AI_ScoreAttack(map, player, src, dst, incoming);
+            if (score <= 0 || (cnt == max && score <= scores[cnt - 1])) continue;
+            int at = (cnt < max ? cnt++ : cnt - 1);
+            for (; at > 0 && scores[at - 1] < score; at--) {
+                scores[at] = scores[at - 1];
+                cmds[at] = cmds[at - 1];
+            }
+            scores[at] = score;
+            cmds[at] = (SIM_Command){
+                SIM_CMD_ATTACK, map->players[player]->id, map->areas[src]->id, map->areas[dst]->id
+            };
+        }
+    }
+    return cnt;
+}
+
+/*
+ * Where the match is heading for player: the areas it holds once the
+ * troops on their way have arrived, by AI_GetAreaValue, against the
+ * other players' average.
+ */
+int AI_Evaluate(Map *map, int player, AI_Context *ctx) {
+    int *incoming = ctx->incoming;
+    AI_CountIncoming(map, incoming);
+    int values[MAP_MAX_PLAYER_CNT];
+    memset(values, 0, sizeof(values));
+    for (int i = 0; i < map->area_cnt; i++) {
+        AreaState *state = &map->area_states[i];
+        const int *coming = &incoming[i * map->player_cnt];
+        int owner = state->conqueror;
+        int defenders = state->troop_cnt + (owner >= 0 ? coming[owner] : 0);
+        int strongest = -1, total = 0;
+        for (int k = 0; k < map->player_cnt; k++) {
+            if (k == owner) continue;
+            total += coming[k];
+            if (strongest < 0 || coming[k] > coming[strongest]) strongest = k;
+        }
+        int troops = defenders - total;
+        if (strongest >= 0 && coming[strongest] - (total - coming[strongest]) > defenders) {
+            owner = strongest;
+            troops = coming[strongest] - (total - coming[strongest]) - defenders;
+        }
+        if (owner >= 0) values[owner] += AI_GetAreaValue(map, i) + SDL_max(troops, 0);
+    }
+    int others = 0, alive = 0;
+    for (int i = 0; i < map->player_cnt; i++) {
+        if (i == player || map->player_states[i].area_cnt + map->player_states[i].troop_cnt == 0) continue;
+        others += values[i];
+        ++alive;
+    }
+    return 2 * values[player] - others / SDL_max(alive, 1);
+}
+
+int AI_PastDeadline(AI_Context *ctx) {
+    return ctx->deadline != 0 && SDL_GetPerformanceCounter() >= ctx->deadline;
+}
+
+int AI_DecideGreedy(Map *map, int player, AI_Context *ctx, SIM_Command *cmd) {
+    int score;
+    ctx->evaluation_cnt = AI_FindCandidates(map, player, ctx, cmd, &score, 1);
+    return ctx->evaluation_cnt > 0;
+}
+
+/*
+ * AI_Evaluate of map AI_LOOKAHEAD_TICKS on with cmd run first, NULL for
+ * none. The others play as SIM_RunAI would, on streams of their own so
+ * the policy can't read the match's. 0 with timed_out set if the
+ * deadline came first.
+ */
+int AI_PlayOut(Map *map, int player, AI_Context *ctx, const SIM_Command *cmd) {
+    ARN_Reset(ctx->arena);
+    Map *clone = ELE_CloneMatch(map, ctx->arena, ctx->grid);
+    if (clone == NULL) {
+        ctx->timed_out = 1;
+        return 0;
+    }
+    clone->human = NULL;
+    clone->commanded = 1u << player;
+    SIM_SeedMatch(clone, (Uint64)map->frame * AI_MAX_PLAYER_CNT + player);
+    for (int tick = 0; tick < AI_LOOKAHEAD_TICKS; tick++) {
+        if (tick % AI_CHECK_TICKS == 0 && AI_PastDeadline(ctx)) {
+            ctx->timed_out = 1;
+            return 0;
+        }
+        SIM_Step(clone, cmd, (tick == 0 && cmd != NULL));
+        if (SIM_GetWinner(clone) != NULL) break;
+    }
+    return AI_Evaluate(clone, player, ctx);
+}
+
+/*
+ * Plays out the best AI_CANDIDATE_CNT attacks and doing nothing, and
+ * goes with whichever ends best. Out of time, the best played out so
+ * far is taken, or the heuristic's best if the baseline didn't finish.
+ */
+int AI_DecideLookahead(Map *map, int player, AI_Context *ctx, SIM_Command *cmd) {
+    SIM_Command cmds[AI_CANDIDATE_CNT];
+    int scores[AI_CANDIDATE_CNT];
+    int cnt = AI_FindCandidates(map, player, ctx, cmds, scores, AI_CANDIDATE_CNT);
+    if (cnt == 0) return 0;
+    int best = -1;
+    int best_value = AI_PlayOut(map, player, ctx, NULL);
+    if (ctx->timed_out) {
+        *cmd = cmds[0];
+        return 1;
+    }
+    for (int i = 0; i < cnt; i++) {
+        int value = AI_PlayOut(map, player, ctx, &cmds[i]);
+        if (ctx->timed_out) break;
+        ++ctx->evaluation_cnt;
+        if (value > best_value) {
+            best = i;
+            best_value = value;
+        }
+    }
+    if (best < 0) return 0;
+    *cmd = cmds[best];
+    return 1;
+}
+
+const AI_Policy AI_GreedyPolicy = {"greedy", AI_DecideGreedy};
+const AI_Policy AI_LookaheadPolicy = {"lookahead", AI_DecideLookahead};
+
+/* One decision of policy for players[player], within budget_us unless 0 */
+int AI_Decide(
+    const AI_Policy *policy, Map *map, int player, Uint64 budget_us,
+    ARN_Arena *arena, Grid *grid, int *incoming, SIM_Command *cmd, AI_Stats *stats
+) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    AI_Context ctx = {arena, grid, incoming, 0, 0, 0};
+    if (budget_us > 0) ctx.deadline = start + budget_us * SDL_GetPerformanceFrequency() / 1000000;
+    int result = policy->decide(map, player, &ctx, cmd);
+    Uint64 us = (SDL_GetPerformanceCounter() - start) * 1000000 / SDL_GetPerformanceFrequency();
+    ++stats->decision_cnt;
+    stats->command_cnt += result;
+    stats->evaluation_cnt += ctx.evaluation_cnt;
+    stats->timeout_cnt += ctx.timed_out;
+    stats->total_us += us;
+    stats->max_us = SDL_max(stats->max_us, us);
+    return result;
+}
+
+void AI_AddStats(AI_Stats *stats, const AI_Stats *add) {
+    stats->decision_cnt += add->decision_cnt;
+    stats->command_cnt += add->command_cnt;
+    stats->evaluation_cnt += add->evaluation_cnt;
+    stats->timeout_cnt += add->timeout_cnt;
+    stats->total_us += add->total_us;
+    stats->max_us = SDL_max(stats->max_us, add->max_us);
+}
+
+int AI_RunWorker(void *data) {
+    AI_Worker *worker = data;
+    SDL_LockMutex(worker->lock);
+    while (1) {
+        while (!worker->busy && !worker->quit) SDL_CondWait(worker->work, worker->lock);
+        if (worker->quit) break;
+        Map *snapshot = worker->snapshot;
+        int players[AI_MAX_PLAYER_CNT];
+        int player_cnt = worker->player_cnt;
+        memcpy(players, worker->players, sizeof(int) * player_cnt);
+        SDL_UnlockMutex(worker->lock);
+        SIM_Command cmds[AI_MAX_PLAYER_CNT];
+        int cmd_cnt = 0;
+        AI_Stats stats = {0};
+        for (int i = 0; i < player_cnt; i++) {
+            cmd_cnt += AI_Decide(worker->policy, snapshot, players[i], worker->budget,
+                worker->search_arena, worker->grid, worker->incoming, &cmds[cmd_cnt], &stats);
+        }
+        SDL_LockMutex(worker->lock);
+        memcpy(worker->cmds, cmds, sizeof(SIM_Command) * cmd_cnt);
+        worker->cmd_cnt = cmd_cnt;
+        AI_AddStats(&worker->stats, &stats);
+        worker->busy = 0;
+    }
+    SDL_UnlockMutex(worker->lock);
+    return 0;
+}
+
+/* Thread and lock only, the worker can go on deciding on the game thread */
+void AI_StopWorker(AI_Worker *worker) {
+    if (worker->thread != NULL) {
+        SDL_LockMutex(worker->lock);
+        worker->quit = 1;
+        SDL_CondSignal(worker->work);
+        SDL_UnlockMutex(worker->lock);
+        SDL_WaitThread(worker->thread, NULL);
+    }
+    if (worker->work != NULL) SDL_DestroyCond(worker->work);
+    if (worker->lock != NULL) SDL_DestroyMutex(worker->lock);
+    worker->thread = NULL;
+    worker->work = NULL;
+    worker->lock = NULL;
+}
+
+void AI_DestroyWorker(AI_Worker *worker) {
+    AI_StopWorker(worker);
+    ARN_Destroy(worker->snapshot_arena);
+    ARN_Destroy(worker->search_arena);
+    ELE_DestroyGrid(worker->grid);
+    free(worker->incoming);
+}
+
+int AI_StartWorker(AI_Worker *worker) {
+    worker->lock = SDL_CreateMutex();
+    worker->work = SDL_CreateCond();
+    if (worker->lock == NULL || worker->work == NULL) {
+        LogError("Unable to create AI worker lock: %s");
+        return -1;
+    }
+    worker->thread = SDL_CreateThread(AI_RunWorker, "ai", worker);
+    if (worker->thread == NULL) {
+        LogError("Unable to create AI worker thread: %s");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Pool driving the players in map->commanded with policy, decisions
+ * within budget_us each unless 0. Without worker threads, asked for
+ * with worker_cnt 0 or when they can't be had, AI_Update decides on the
+ * game thread, which makes a match with budget 0 deterministic.
+ */
+AI_Pool* AI_CreatePool(const AI_Policy *policy, Map *map, int worker_cnt, Uint64 budget_us) {
+    AI_Pool *pool = malloc(sizeof(AI_Pool));
+    memset(pool, 0, sizeof(AI_Pool));
+    pool->policy = policy;
+    pool->budget = budget_us;
+    pool->players = map->commanded;
+    pool->worker_cnt = SDL_max(0, SDL_min(worker_cnt, SDL_min((int)AI_MAX_WORKER_CNT, map->player_cnt)));
+    pool->workers = malloc(sizeof(AI_Worker) * SDL_max(pool->worker_cnt, 1));
+    memset(pool->workers, 0, sizeof(AI_Worker) * SDL_max(pool->worker_cnt, 1));
+    for (int i = 0; i < SDL_max(pool->worker_cnt, 1); i++) {
+        AI_Worker *worker = &pool->workers[i];
+        worker->policy = policy;
+        worker->budget = budget_us;
+        worker->snapshot_arena = ARN_Create(0);
+        worker->search_arena = ARN_Create(0);
+        worker->grid = ELE_CreateGrid(map->troop_grid->cell_size);
+        worker->incoming = malloc(sizeof(int) * SDL_max(map->area_cnt * map->player_cnt, 1));
+    }
+    for (int i = 0; i < pool->worker_cnt; i++) {
+        if (AI_StartWorker(&pool->workers[i]) == 0) continue;
+        LogInfo("AI goes on the game thread");
+        for (int k = 0; k <= i; k++) AI_StopWorker(&pool->workers[k]);
+        for (int k = 1; k < pool->worker_cnt; k++) AI_DestroyWorker(&pool->workers[k]);
+        pool->worker_cnt = 0;
+        break;
+    }
+    return pool;
+}
+
+/* Waits for the decisions under way, the map they are on must still be there */
+void AI_DestroyPool(AI_Pool *pool) {
+    if (pool == NULL) return;
+    for (int i = 0; i < SDL_max(pool->worker_cnt, 1); i++) AI_DestroyWorker(&pool->workers[i]);
+    free(pool->workers);
+    free(pool);
+}
+
+/* Whether players[player] is the pool's and due for a decision at map->frame */
+int AI_IsDue(AI_Pool *pool, Map *map, int player) {
+    return (pool->players >> player & 1) && map->frame >= pool->next_frame[player] &&
+        map->player_states[player].area_cnt > 0;
+}
+
+/*
+ * Once a tick, before SIM_Step. Puts the commands decided since the
+ * last call into cmds, at most max_cmd_cnt of them, and hands the
+ * players due to idle workers with a snapshot of map. Workers that are
+ * busy are left to it, so this never waits on one.
+ */
+int AI_Update(AI_Pool *pool, Map *map, SIM_Command *cmds, int max_cmd_cnt) {
+    int cnt = 0;
+    if (pool->worker_cnt == 0) {
+        AI_Worker *worker = &pool->workers[0];
+        for (int i = 0; i < map->player_cnt && cnt < max_cmd_cnt; i++) {
+            if (!AI_IsDue(pool, map, i)) continue;
+            pool->next_frame[i] = map->frame + AI_THINK_TICKS;
+            cnt += AI_Decide(pool->policy, map, i, pool->budget,
+                worker->search_arena, worker->grid, worker->incoming, &cmds[cnt], &worker->stats);
+        }
+        return cnt;
+    }
+    for (int w = 0; w < pool->worker_cnt; w++) {
+        AI_Worker *worker = &pool->workers[w];
+        if (SDL_TryLockMutex(worker->lock) != 0) continue;
+        if (worker->busy) {
+            SDL_UnlockMutex(worker->lock);
+            continue;
+        }
+        /* Whatever doesn't fit this tick is dropped, the player decides again soon */
+        int take = SDL_min(worker->cmd_cnt, max_cmd_cnt - cnt);
+        memcpy(&cmds[cnt], worker->cmds, sizeof(SIM_Command) * take);
+        cnt += take;
+        worker->cmd_cnt = 0;
+        worker->player_cnt = 0;
+        for (int i = w; i < map->player_cnt; i += pool->worker_cnt) {
+            if (AI_IsDue(pool, map, i)) worker->players[worker->player_cnt++] = i;
+        }
+        if (worker->player_cnt > 0) {
+            ARN_Reset(worker->snapshot_arena);
+            worker->snapshot = ELE_CloneMatch(map, worker->snapshot_arena, worker->grid);
+            if (worker->snapshot != NULL) {
+                for (int k = 0; k < worker->player_cnt; k++) {
+                    pool->next_frame[worker->players[k]] = map->frame + AI_THINK_TICKS;
+                }
+                worker->busy = 1;
+                SDL_CondSignal(worker->work);
+            }
+        }
+        SDL_UnlockMutex(worker->lock);
+    }
+    return cnt;
+}
+
+void AI_GetStats(AI_Pool *pool, AI_Stats *stats) {
+    memset(stats, 0, sizeof(AI_Stats));
+    for (int i = 0; i < SDL_max(pool->worker_cnt, 1); i++) {
+        AI_Worker *worker = &pool->workers[i];
+        if (worker->lock != NULL) SDL_LockMutex(worker->lock);
+        AI_AddStats(stats, &worker->stats);
+        if (worker->lock != NULL) SDL_UnlockMutex(worker->lock);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#ifndef _AI_H
+#define _AI_H
+
+#include <SDL2/SDL.h>
+#include "sim.h"
+#include "arena.h"
+#include "elems/map.h"
+#include "elems/grid.h"
+
+/*
+ * Opponents that choose their attacks outside the simulation. SIM_Step
+ * runs its own random AI for every player but the human and those in
+ * Map::commanded. An AI_Policy drives the latter, handing in
+ * SIM_Commands the way the human does, so journals and replays record
+ * its moves like any other.
+ *
+ * Policies decide on a snapshot of the match taken with ELE_CloneMatch,
+ * which they may clone and step further. An AI_Pool runs them on
+ * worker threads, the game thread only takes snapshots and collects
+ * commands and never waits for a decision.
+ */
+
+enum AI_Constants {
+    /* Players of a match a pool can drive, one bit of Map::commanded each */
+    AI_MAX_PLAYER_CNT = 32,
+    AI_MAX_WORKER_CNT = 8,
+    /* Ticks between two decisions of a player */
+    AI_THINK_TICKS = SIM_TICK_RATE,
+    /* How far the lookahead policy plays every candidate attack */
+    AI_LOOKAHEAD_TICKS = 4 * SIM_TICK_RATE,
+    AI_DEFAULT_BUDGET_US = 20000
+};
+
+struct AI_Context {
+    /* Scratch for clones of the snapshot, reset by the policy as it likes */
+    ARN_Arena *arena;
+    Grid *grid;
+    /* Scratch of area_cnt * player_cnt for AI_CountIncoming, on the heap as maps can be large */
+    int *incoming;
+    /* SDL_GetPerformanceCounter value to decide by, 0 for no limit */
+    Uint64 deadline;
+    /* Set by the policy: candidates looked at, and whether the deadline cut that short */
+    int evaluation_cnt;
+    int timed_out;
+};
+typedef struct AI_Context AI_Context;
+
+struct AI_Policy {
+    const char *name;
+    /* Attack of players[player] on map into cmd, 1 if there is one worth making */
+    int (*decide)(Map *map, int player, AI_Context *ctx, SIM_Command *cmd);
+};
+typedef struct AI_Policy AI_Policy;
+
+struct AI_Stats {
+    int decision_cnt;
+    int command_cnt;
+    int evaluation_cnt;
+    /* Decisions the time budget cut short */
+    int timeout_cnt;
+    Uint64 total_us, max_us;
+};
+typedef struct AI_Stats AI_Stats;
+
+struct AI_Worker {
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *work;
+    /* Everything below up to snapshot_arena is guarded by lock */
+    int busy, quit;
+    /* Match to decide on, in snapshot_arena, and whose turn it is */
+    Map *snapshot;
+    int players[AI_MAX_PLAYER_CNT];
+    int player_cnt;
+    /* Decided and not collected yet */
+    SIM_Command cmds[AI_MAX_PLAYER_CNT];
+    int cmd_cnt;
+    AI_Stats stats;
+
+    /* Only touched by the game thread while the worker isn't busy */
+    ARN_Arena *snapshot_arena;
+    /* The worker's own */
+    ARN_Arena *search_arena;
+    Grid *grid;
+    /* area_cnt * player_cnt of the pool's map, see AI_Context */
+    int *incoming;
+
+    const AI_Policy *policy;
+    Uint64 budget;
+};
+typedef struct AI_Worker AI_Worker;
+
+struct AI_Pool {
+    const AI_Policy *policy;
+    /* worker_cnt threads, or one worker run on the game thread if 0 */
+    AI_Worker *workers;
+    int worker_cnt;
+    Uint64 budget;
+    /* Players driven, by index, and the frame each decides next at */
+    Uint32 players;
+    int next_frame[AI_MAX_PLAYER_CNT];
+};
+typedef struct AI_Pool AI_Pool;
+
+extern const AI_Policy AI_GreedyPolicy;
+extern const AI_Policy AI_LookaheadPolicy;
+extern const AI_Policy* AI_GetPolicy(const char *name);
+
+extern int AI_Decide(
+    const AI_Policy *policy, Map *map, int player, Uint64 budget_us,
+    ARN_Arena *arena, Grid *grid, int *incoming, SIM_Command *cmd, AI_Stats *stats
+);
+
+extern AI_Pool* AI_CreatePool(const AI_Policy *policy, Map *map, int worker_cnt, Uint64 budget_us);
+extern void AI_DestroyPool(AI_Pool *pool);
+extern int AI_Update(AI_Pool *pool, Map *map, SIM_Command *cmds, int max_cmd_cnt);
+extern void AI_GetStats(AI_Pool *pool, AI_Stats *stats);
+
+#endif /* _AI_H */
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include "arena.h"
+#include "log.h"
+
+ARN_Arena* ARN_Create(Sint64 chunk_size) {
+    ARN_Arena *arena = calloc(1, sizeof(ARN_Arena));
+    arena->chunk_size = (chunk_size > 0 ? chunk_size : ARN_DEFAULT_CHUNK_SIZE);
+    return arena;
+}
+
+void ARN_FreeChunks(ARN_Chunk *chunk) {
+    while (chunk != NULL) {
+        ARN_Chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+void ARN_Destroy(ARN_Arena *arena) {
+    if (arena == NULL) return;
+    ARN_FreeChunks(arena->chunk);
+    free(arena);
+}
+
+ARN_Chunk* ARN_AddChunk(ARN_Arena *arena, Sint64 size) {
+    ARN_Chunk *chunk = malloc(sizeof(ARN_Chunk) + size);
+    if (chunk == NULL) {
+        LogInfo("Unable to allocate %lld bytes for arena", (long long)size);
+        return NULL;
+    }
+    chunk->next = arena->chunk;
+    chunk->size = size;
+    chunk->used = 0;
+    arena->chunk = chunk;
+    return chunk;
+}
+
+/* ARN_ALIGN aligned, NULL only when out of memory */
+void* ARN_Alloc(ARN_Arena *arena, Sint64 size) {
+    size = (size + ARN_ALIGN - 1) / ARN_ALIGN * ARN_ALIGN;
+    ARN_Chunk *chunk = arena->chunk;
+    if (chunk == NULL || chunk->used + size > chunk->size) {
+        chunk = ARN_AddChunk(arena, SDL_max(arena->chunk_size, size));
+        if (chunk == NULL) return NULL;
+    }
+    void *ptr = (Uint8*)(chunk + 1) + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    return ptr;
+}
+
+/*
+ * Everything allocated is gone. Chunks that spilled over are merged
+ * into one as big as all of them, so the next round fits in one chunk.
+ */
+void ARN_Reset(ARN_Arena *arena) {
+    ARN_Chunk *chunk = arena->chunk;
+    if (chunk != NULL && chunk->next != NULL) {
+        Sint64 size = 0;
+        for (ARN_Chunk *it = chunk; it != NULL; it = it->next) size += it->size;
+        ARN_FreeChunks(chunk);
+        arena->chunk = NULL;
+        arena->chunk_size = SDL_max(arena->chunk_size, size);
+        chunk = ARN_AddChunk(arena, arena->chunk_size);
+    }
+    if (chunk != NULL) chunk->used = 0;
+    arena->used = 0;
+}
\ No newline at end of file
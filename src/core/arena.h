@@ -0,0 +1,40 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Bump allocator for short-lived objects that all go at once, like the
+ * match clones of a search. Nothing is freed on its own, ARN_Reset
+ * drops everything allocated so far.
+ */
+
+enum ARN_Constants {
+    ARN_ALIGN = 16,
+    ARN_DEFAULT_CHUNK_SIZE = 1 << 20
+};
+
+struct ARN_Chunk {
+    struct ARN_Chunk *next;
+    Sint64 size;
+    Sint64 used;
+    Sint64 reserved;
+};
+typedef struct ARN_Chunk ARN_Chunk;
+
+struct ARN_Arena {
+    /* Chunk allocated from, the full ones follow it */
+    ARN_Chunk *chunk;
+    Sint64 chunk_size;
+    /* Bytes handed out since the last reset */
+    Sint64 used;
+};
+typedef struct ARN_Arena ARN_Arena;
+
+extern ARN_Arena* ARN_Create(Sint64 chunk_size);
+extern void ARN_Destroy(ARN_Arena *arena);
+
+extern void* ARN_Alloc(ARN_Arena *arena, Sint64 size);
+extern void ARN_Reset(ARN_Arena *arena);
+
+#endif /* _ARENA_H */
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include "autosave.h"
+#include "log.h"
+#include "elems/map.h"
+#include "elems/mapfile.h"
+#include "elems/catalog.h"
+
+struct ASV_Job {
+    char filename[64];
+    Uint8 *data;
+    Sint64 size;
+    /* Also add the map to MAP_CATALOG_FILE */
+    int catalog;
+    Uint64 snapshot_us;
+
+    struct ASV_Job *next;
+};
+typedef struct ASV_Job ASV_Job;
+
+SDL_Thread *g_SaveThread = NULL;
+SDL_mutex *g_SaveLock = NULL;
+/* Signalled on new jobs and on quit, and when the writer goes idle */
+SDL_cond *g_SaveWork = NULL, *g_SaveIdle = NULL;
+/* Everything below is guarded by g_SaveLock */
+ASV_Job *g_SaveQueue = NULL;
+int g_SaveBusy = 0, g_SaveQuit = 0;
+ASV_Stats g_SaveStats;
+
+Uint64 ASV_Microseconds(Uint64 start) {
+    return (SDL_GetPerformanceCounter() - start) * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+/* Writer side, the catalog entry is built from the snapshot and not the live map */
+void ASV_Write(ASV_Job *job) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    int result = ELE_WriteMapFile(job->filename, job->data, job->size);
+    if (result == 0 && job->catalog) {
+        Map *map = ELE_ParseMap(job->data, job->size, 0, 0, NULL);
+        if (map != NULL) {
+            ELE_UpdateMapCatalog(MAP_CATALOG_FILE, map, job->data, job->size);
+            ELE_DestroyMap(map);
+        }
+    }
+    Uint64 us = ASV_Microseconds(start);
+    LogInfo("Saved %s in the background: snapshot %llu us, write %llu us",
+        job->filename, (unsigned long long)job->snapshot_us, (unsigned long long)us);
+    if (g_SaveLock != NULL) SDL_LockMutex(g_SaveLock);
+    ++g_SaveStats.write_cnt;
+    g_SaveStats.last_write_us = us;
+    g_SaveStats.max_write_us = SDL_max(g_SaveStats.max_write_us, us);
+    g_SaveStats.total_write_us += us;
+    if (g_SaveLock != NULL) SDL_UnlockMutex(g_SaveLock);
+    free(job->data);
+    free(job);
+}
+
+int ASV_Writer(void *data) {
+    (void)data;
+    SDL_LockMutex(g_SaveLock);
+    while (1) {
+        while (g_SaveQueue == NULL && !g_SaveQuit) SDL_CondWait(g_SaveWork, g_SaveLock);
+        if (g_SaveQueue == NULL) break;
+        ASV_Job *job = g_SaveQueue;
+        g_SaveQueue = job->next;
+        g_SaveBusy = 1;
+        SDL_UnlockMutex(g_SaveLock);
+        ASV_Write(job);
+        SDL_LockMutex(g_SaveLock);
+        g_SaveBusy = 0;
+        SDL_CondBroadcast(g_SaveIdle);
+    }
+    SDL_UnlockMutex(g_SaveLock);
+    return 0;
+}
+
+int ASV_Init() {
+    memset(&g_SaveStats, 0, sizeof(g_SaveStats));
+    g_SaveQuit = 0;
+    g_SaveLock = SDL_CreateMutex();
+    g_SaveWork = SDL_CreateCond();
+    g_SaveIdle = SDL_CreateCond();
+    if (g_SaveLock == NULL || g_SaveWork == NULL || g_SaveIdle == NULL) {
+        LogError("Unable to create autosave lock: %s");
+        return -1;
+    }
+    g_SaveThread = SDL_CreateThread(ASV_Writer, "autosave", NULL);
+    if (g_SaveThread == NULL) {
+        /* ASV_Save writes on the calling thread then */
+        LogError("Unable to create autosave thread: %s");
+        return -1;
+    }
+    return 0;
+}
+
+/* Waits for the pending saves */
+void ASV_Quit() {
+    if (g_SaveLock == NULL) return;
+    if (g_SaveThread != NULL) {
+        SDL_LockMutex(g_SaveLock);
+        g_SaveQuit = 1;
+        SDL_CondSignal(g_SaveWork);
+        SDL_UnlockMutex(g_SaveLock);
+        SDL_WaitThread(g_SaveThread, NULL);
+        g_SaveThread = NULL;
+    }
+    ASV_Stats *stats = &g_SaveStats;
+    if (stats->snapshot_cnt) {
+        LogInfo("Autosave: %d snapshots, avg %llu us, max %llu us; %d writes, avg %llu us, max %llu us",
+            stats->snapshot_cnt, (unsigned long long)(stats->total_snapshot_us / stats->snapshot_cnt),
+            (unsigned long long)stats->max_snapshot_us, stats->write_cnt,
+            (unsigned long long)(stats->total_write_us / SDL_max(stats->write_cnt, 1)),
+            (unsigned long long)stats->max_write_us);
+    }
+    SDL_DestroyCond(g_SaveWork);
+    SDL_DestroyCond(g_SaveIdle);
+    SDL_DestroyMutex(g_SaveLock);
+    g_SaveLock = NULL;
+}
+
+/*
+ * Snapshot of map with ELE_MapFileFlags flags, written to filename
+ * later. Only the serialization runs on the calling thread.
+ */
+int ASV_Save(Map *map, const char *filename, Uint32 flags, int catalog) {
+    if (strlen(filename) >= sizeof(((ASV_Job*)0)->filename)) {
+        LogInfo("Autosave file name too long: %s", filename);
+        return -1;
+    }
+    Uint64 start = SDL_GetPerformanceCounter();
+    ASV_Job *job = malloc(sizeof(ASV_Job));
+    job->data = ELE_SerializeMap(map, flags, &job->size);
+    Uint64 us = ASV_Microseconds(start);
+    if (job->data == NULL) {
+        free(job);
+        return -1;
+    }
+    strcpy(job->filename, filename);
+    job->catalog = catalog;
+    job->snapshot_us = us;
+    job->next = NULL;
+    if (g_SaveLock != NULL) SDL_LockMutex(g_SaveLock);
+    ++g_SaveStats.snapshot_cnt;
+    g_SaveStats.last_snapshot_us = us;
+    g_SaveStats.max_snapshot_us = SDL_max(g_SaveStats.max_snapshot_us, us);
+    g_SaveStats.total_snapshot_us += us;
+    g_SaveStats.last_size = job->size;
+    g_SaveStats.last_checksum = ((MapFileHeader*)job->data)->checksum;
+    if (g_SaveThread == NULL) {
+        if (g_SaveLock != NULL) SDL_UnlockMutex(g_SaveLock);
+        ASV_Write(job);
+        return 0;
+    }
+    ASV_Job **tail = &g_SaveQueue;
+    for (; *tail != NULL; tail = &(*tail)->next) {
+        ASV_Job *queued = *tail;
+        if (strcmp(queued->filename, filename) || queued->catalog != catalog) continue;
+        /* Same file not written yet, the new snapshot takes its place */
+        job->next = queued->next;
+        *tail = job;
+        free(queued->data);
+        free(queued);
+        ++g_SaveStats.superseded_cnt;
+        SDL_UnlockMutex(g_SaveLock);
+        return 0;
+    }
+    *tail = job;
+    SDL_CondSignal(g_SaveWork);
+    SDL_UnlockMutex(g_SaveLock);
+    return 0;
+}
+
+/* Blocks until every save so far is on disk, before reading one back */
+void ASV_Flush() {
+    if (g_SaveThread == NULL) return;
+    SDL_LockMutex(g_SaveLock);
+    while (g_SaveQueue != NULL || g_SaveBusy) SDL_CondWait(g_SaveIdle, g_SaveLock);
+    SDL_UnlockMutex(g_SaveLock);
+}
+
+void ASV_GetStats(ASV_Stats *stats) {
+    if (g_SaveLock != NULL) SDL_LockMutex(g_SaveLock);
+    *stats = g_SaveStats;
+    if (g_SaveLock != NULL) SDL_UnlockMutex(g_SaveLock);
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef _AUTOSAVE_H
+#define _AUTOSAVE_H
+
+#include <SDL2/SDL.h>
+#include "elems/map.h"
+
+/*
+ * Map saves off the main thread. ASV_Save serializes the map into a
+ * flat buffer right away and a writer thread puts it on disk through
+ * ELE_WriteMapFile. At most one save per file waits behind the one
+ * being written, a newer snapshot replaces it.
+ */
+
+struct ASV_Stats {
+    int snapshot_cnt;
+    int write_cnt;
+    /* Snapshots replaced by a newer one before being written */
+    int superseded_cnt;
+    Uint64 last_snapshot_us, max_snapshot_us, total_snapshot_us;
+    Uint64 last_write_us, max_write_us, total_write_us;
+    Sint64 last_size;
+    /* MapFileHeader::checksum of the last snapshot */
+    Uint32 last_checksum;
+};
+typedef struct ASV_Stats ASV_Stats;
+
+extern int ASV_Init(void);
+extern void ASV_Quit(void);
+
+extern int ASV_Save(Map *map, const char *filename, Uint32 flags, int catalog);
+extern void ASV_Flush(void);
+
+extern void ASV_GetStats(ASV_Stats *stats);
+
+#endif /* _AUTOSAVE_H */
\ No newline at end of file
@@ -2,33 +2,63 @@
 #define _AREA_H
 
 #include <SDL2/SDL.h>
-#include "player.h"
 
+enum ELE_AreaSpriteConstants {
+    MAX_AREA_BORDER_SIZE = 8
+};
+
+/*
+ * White masks of an area rasterized once by ELE_ColorArea and tinted
+ * when drawn. Textures are made lazily, one per border size in use.
+ */
+struct AreaSprite {
+    SDL_Rect box;
+    /* Geometry the masks were made from */
+    SDL_Point *vertices;
+    int vertex_cnt;
+    SDL_Texture *shape;
+    SDL_Texture *inner[MAX_AREA_BORDER_SIZE + 1];
+};
+typedef struct AreaSprite AreaSprite;
+
+/* What a map is drawn from, the same for every match on it */
 struct Area {
     int id;
-    Player *conqueror;
     int capacity;
-    int troop_cnt;
-    int troop_rate;
-    int troop_inc_delay;
 
     SDL_Point center;
     int radius;
     SDL_Point *vertices;
     int vertex_cnt;
+    /* Vertices belong to another area or a mapped map file, never freed */
+    int shared_vertices;
+    AreaSprite *sprite;
+};
+typedef struct Area Area;
+
+/* Match state of the area, in Map::area_states */
+struct AreaState {
+    /* Index into Map::players, -1 for none */
+    int conqueror;
+    int troop_cnt;
+    int troop_rate;
+    int troop_inc_delay;
 
-    struct Area *attack;
+    /* Index into Map::areas, -1 for none */
+    int attack;
     int attack_delay;
     int attack_cnt;
 };
-typedef struct Area Area;
+typedef struct AreaState AreaState;
 
 extern Area* ELE_CreateArea(
-    int id, Player *conqueror, int capacity, int troop_cnt, int troop_rate,
-    SDL_Point center, int radius, SDL_Point *vertices, int vertex_cnt
+    int id, int capacity, SDL_Point center, int radius,
+    SDL_Point *vertices, int vertex_cnt
 );
+extern Area* ELE_CloneArea(Area *area);
 extern void ELE_DestroyArea(Area *area);
 
+extern void ELE_DestroyAreaSprite(Area *area);
 extern void ELE_ColorArea(
     Area *area,
     SDL_Color border_color, SDL_Color fill_color,
@@ -37,11 +67,4 @@ extern void ELE_ColorArea(
 
 extern int ELE_GetAreaCapacityByRadius(int radius);
 
-extern void ELE_AreaAttack(Area *first, Area *second);
-extern void ELE_AreaUnAttack(Area *first);
-
-extern void ELE_AreaConquer(Area *area, Player *player);
-
-extern int ELE_GetAreaAppliedPotionType(Area *area);
-
 #endif /* _AREA_H */
\ No newline at end of file
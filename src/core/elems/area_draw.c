@@ -0,0 +1,112 @@
+#include <SDL2/SDL.h>
+#include <SDL2_gfxPrimitives.h>
+#include <stdlib.h>
+#include "area.h"
+#include "../video.h"
+#include "../log.h"
+
+/* Area polygon inset by border_size, drawn white on a transparent texture */
+SDL_Texture* ELE_RenderAreaMask(Area *area, SDL_Rect box, int border_size) {
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, box.w, box.h, 32,
+        SDL_PIXELFORMAT_ARGB8888);
+    if (surface == NULL) {
+        LogError("Unable to create area surface: %s");
+        return NULL;
+    }
+    SDL_FillRect(surface, NULL, SDL_MapRGBA(surface->format, 0, 0, 0, 0));
+    SDL_Renderer *soft = SDL_CreateSoftwareRenderer(surface);
+    if (soft == NULL) {
+        LogError("Unable to create area renderer: %s");
+        SDL_FreeSurface(surface);
+        return NULL;
+    }
+    Sint16 *vertices_x = malloc(sizeof(Sint16) * area->vertex_cnt);
+    Sint16 *vertices_y = malloc(sizeof(Sint16) * area->vertex_cnt);
+    double PI = acos(-1);
+    for (int i = 0; i < area->vertex_cnt; i++) {
+        vertices_x[i] = area->vertices[i].x;
+        vertices_y[i] = area->vertices[i].y;
+        if (border_size > 0) {
+            /* Exclude border size */
+            int dx = area->vertices[i].x - area->center.x;
+            int dy = area->vertices[i].y - area->center.y;
+            double theta;
+            if (dx != 0) {
+                theta = SDL_atan(1.0 * dy / dx);
+            } else {
+                theta = (dy > 0 ? PI / 2 : -PI / 2);
+            }
+            if (dx < 0) theta += PI;
+            vertices_x[i] -= border_size * SDL_cos(theta);
+            vertices_y[i] -= border_size * SDL_sin(theta);
+        }
+        vertices_x[i] -= box.x;
+        vertices_y[i] -= box.y;
+    }
+    filledPolygonRGBA(soft, vertices_x, vertices_y, area->vertex_cnt, 255, 255, 255, 255);
+    SDL_RenderPresent(soft);
+    SDL_DestroyRenderer(soft);
+    free(vertices_x);
+    free(vertices_y);
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(VDO_GetRenderer(), surface);
+    SDL_FreeSurface(surface);
+    if (texture == NULL) {
+        LogError("Unable to create area texture: %s");
+        return NULL;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    return texture;
+}
+
+AreaSprite* ELE_GetAreaSprite(Area *area) {
+    AreaSprite *sprite = area->sprite;
+    if (sprite != NULL &&
+        (sprite->vertices != area->vertices || sprite->vertex_cnt != area->vertex_cnt)) {
+        ELE_DestroyAreaSprite(area);
+        sprite = NULL;
+    }
+    if (sprite != NULL) return sprite;
+    sprite = malloc(sizeof(AreaSprite));
+    memset(sprite, 0, sizeof(AreaSprite));
+    sprite->vertices = area->vertices;
+    sprite->vertex_cnt = area->vertex_cnt;
+    int x1 = area->center.x, y1 = area->center.y, x2 = x1, y2 = y1;
+    for (int i = 0; i < area->vertex_cnt; i++) {
+        x1 = SDL_min(x1, area->vertices[i].x);
+        y1 = SDL_min(y1, area->vertices[i].y);
+        x2 = SDL_max(x2, area->vertices[i].x);
+        y2 = SDL_max(y2, area->vertices[i].y);
+    }
+    sprite->box = (SDL_Rect){x1, y1, x2 - x1 + 1, y2 - y1 + 1};
+    area->sprite = sprite;
+    return sprite;
+}
+
+void ELE_ColorArea(
+    Area *area,
+    SDL_Color border_color, SDL_Color fill_color,
+    int border_size
+) {
+    if (area->vertex_cnt == 0) return;
+    border_size = SDL_max(0, SDL_min(border_size, MAX_AREA_BORDER_SIZE));
+    AreaSprite *sprite = ELE_GetAreaSprite(area);
+    if (sprite->shape == NULL) sprite->shape = ELE_RenderAreaMask(area, sprite->box, 0);
+    if (sprite->inner[border_size] == NULL) {
+        sprite->inner[border_size] = ELE_RenderAreaMask(area, sprite->box, border_size);
+    }
+    SDL_Renderer *renderer = VDO_GetRenderer();
+    /* Border color */
+    SDL_Texture *shape = sprite->shape;
+    if (shape != NULL) {
+        SDL_SetTextureColorMod(shape, border_color.r, border_color.g, border_color.b);
+        SDL_SetTextureAlphaMod(shape, border_color.a);
+        SDL_RenderCopy(renderer, shape, NULL, &sprite->box);
+    }
+    /* Fill color */
+    SDL_Texture *inner = sprite->inner[border_size];
+    if (inner != NULL) {
+        SDL_SetTextureColorMod(inner, fill_color.r, fill_color.g, fill_color.b);
+        SDL_SetTextureAlphaMod(inner, fill_color.a);
+        SDL_RenderCopy(renderer, inner, NULL, &sprite->box);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,270 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "catalog.h"
+#include "map.h"
+#include "mapfile.h"
+#include "../log.h"
+
+const char MAP_CATALOG_MAGIC[4] = {'S', 'I', 'O', 'C'};
+
+MapCatalog* ELE_CreateMapCatalog() {
+    MapCatalog *new_catalog = malloc(sizeof(MapCatalog));
+    new_catalog->entries = malloc(sizeof(MapCatalogEntry));
+    new_catalog->entry_cnt = 0;
+    new_catalog->entry_size = 1;
+    return new_catalog;
+}
+
+void ELE_DestroyMapCatalog(MapCatalog *catalog) {
+    if (catalog == NULL) return;
+    free(catalog->entries);
+    free(catalog);
+}
+
+/* NULL if the file is missing or malformed */
+MapCatalog* ELE_LoadMapCatalog(const char *filename) {
+    SDL_RWops *file = SDL_RWFromFile(filename, "rb");
+    if (file == NULL) return NULL;
+    Sint64 size = SDL_RWsize(file);
+    Uint8 *data = (size >= (Sint64)sizeof(MapCatalogHeader) ? malloc(size) : NULL);
+    if (data == NULL || SDL_RWread(file, data, size, 1) != 1) {
+        LogInfo("Unable to read map catalog");
+        free(data);
+        SDL_RWclose(file);
+        return NULL;
+    }
+    SDL_RWclose(file);
+    const MapCatalogHeader *header = (const MapCatalogHeader*)data;
+    const Uint8 *entries = data + sizeof(MapCatalogHeader);
+    Sint64 entries_size = size - sizeof(MapCatalogHeader);
+    if (memcmp(header->magic, MAP_CATALOG_MAGIC, sizeof(MAP_CATALOG_MAGIC)) ||
+        header->version != MAP_CATALOG_VERSION ||
+        entries_size != (Sint64)sizeof(MapCatalogEntry) * header->entry_cnt ||
+        ELE_GetMapChecksum(entries, entries_size) != header->checksum) {
+        LogInfo("Map catalog is outdated or corrupt");
+        free(data);
+        return NULL;
+    }
+    MapCatalog *catalog = ELE_CreateMapCatalog();
+    catalog->entry_size = SDL_max(header->entry_cnt, 1);
+    catalog->entries = realloc(catalog->entries, sizeof(MapCatalogEntry) * catalog->entry_size);
+    catalog->entry_cnt = header->entry_cnt;
+    memcpy(catalog->entries, entries, entries_size);
+    free(data);
+    return catalog;
+}
+
+int ELE_SaveMapCatalog(MapCatalog *catalog, const char *filename) {
+    Sint64 entries_size = sizeof(MapCatalogEntry) * catalog->entry_cnt;
+    Sint64 size = sizeof(MapCatalogHeader) + entries_size;
+    Uint8 *data = malloc(size);
+    MapCatalogHeader *header = (MapCatalogHeader*)data;
+    memset(header, 0, sizeof(MapCatalogHeader));
+    memcpy(header->magic, MAP_CATALOG_MAGIC, sizeof(MAP_CATALOG_MAGIC));
+    header->version = MAP_CATALOG_VERSION;
+    header->entry_cnt = catalog->entry_cnt;
+    memcpy(data + sizeof(MapCatalogHeader), catalog->entries, entries_size);
+    header->checksum = ELE_GetMapChecksum(data + sizeof(MapCatalogHeader), entries_size);
+    int result = ELE_ReplaceFile(filename, data, size);
+    free(data);
+    return result;
+}
+
+/*
+ * Whole file of map id, the legacy name if there is no .bin one. NULL
+ * with *missing set if neither exists, NULL alone if it can't be read.
+ */
+Uint8* ELE_ReadCatalogMapFile(int id, Sint64 *size, int *missing) {
+    char filename[32];
+    sprintf(filename, "bin/data/map%d.bin", id);
+    SDL_RWops *file = SDL_RWFromFile(filename, "rb");
+    if (file == NULL) {
+        sprintf(filename, "bin/data/map%d", id);
+        file = SDL_RWFromFile(filename, "rb");
+    }
+    *missing = (file == NULL);
+    if (file == NULL) return NULL;
+    *size = SDL_RWsize(file);
+    Uint8 *data = (*size > 0 ? malloc(*size) : NULL);
+    if (data == NULL || SDL_RWread(file, data, *size, 1) != 1) {
+        LogInfo("Unable to read map file %s", filename);
+        free(data);
+        data = NULL;
+    }
+    SDL_RWclose(file);
+    return data;
+}
+
+/*
+ * Catalog of map files saved before there was one. Ids of deleted maps
+ * are skipped, the search ends after MAP_CATALOG_GAP missing in a row.
+ */
+MapCatalog* ELE_BuildMapCatalog() {
+    MapCatalog *catalog = ELE_CreateMapCatalog();
+    for (int id = 0, gap = 0; gap < MAP_CATALOG_GAP; id++) {
+        Sint64 size;
+        int missing;
+        Uint8 *data = ELE_ReadCatalogMapFile(id, &size, &missing);
+        gap = (missing ? gap + 1 : 0);
+        if (data == NULL) continue;
+        Map *map = ELE_ParseMap(data, size, 0, 0, NULL);
+        if (map != NULL) {
+            map->id = id;
+            ELE_CatalogMap(catalog, map, data, size);
+            ELE_DestroyMap(map);
+        }
+        free(data);
+    }
+    LogInfo("Map catalog built with %d maps", catalog->entry_cnt);
+    return catalog;
+}
+
+/*
+ * Compares the entry of id with its map file once the map is picked,
+ * the chooser itself never opens the files. A file replaced or removed
+ * behind the catalog gets its entry rebaked or dropped. 1 if the
+ * catalog changed and should be saved.
+ */
+int ELE_CheckMapCatalogEntry(MapCatalog *catalog, int id) {
+    MapCatalogEntry *entry = ELE_FindMapCatalogEntry(catalog, id);
+    if (entry == NULL) return 0;
+    Sint64 size = 0;
+    int missing;
+    Uint8 *data = ELE_ReadCatalogMapFile(id, &size, &missing);
+    if (data != NULL && size == entry->file_size && ELE_GetMapChecksum(data, size) == entry->checksum) {
+        free(data);
+        return 0;
+    }
+    Map *map = (data != NULL ? ELE_ParseMap(data, size, 0, 0, NULL) : NULL);
+    if (map != NULL) {
+        LogInfo("Map %d changed since it was catalogued", id);
+        map->id = id;
+        ELE_CatalogMap(catalog, map, data, size);
+        ELE_DestroyMap(map);
+    } else {
+        LogInfo("Map %d is gone, dropped from the catalog", id);
+        int i = entry - catalog->entries;
+        memmove(entry, entry + 1, sizeof(MapCatalogEntry) * (catalog->entry_cnt - i - 1));
+        --catalog->entry_cnt;
+    }
+    free(data);
+    return 1;
+}
+
+/* Index of the first entry with an id not less than id */
+int ELE_LowerMapCatalogEntry(MapCatalog *catalog, int id) {
+    int lo = 0, hi = catalog->entry_cnt;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (catalog->entries[mid].id < id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+MapCatalogEntry* ELE_FindMapCatalogEntry(MapCatalog *catalog, int id) {
+    int i = ELE_LowerMapCatalogEntry(catalog, id);
+    if (i < catalog->entry_cnt && catalog->entries[i].id == id) return &catalog->entries[i];
+    return NULL;
+}
+
+/* Adds or replaces the entry of map, whose file holds data */
+void ELE_CatalogMap(MapCatalog *catalog, Map *map, const Uint8 *data, Sint64 size) {
+    MapCatalogEntry *entry = ELE_FindMapCatalogEntry(catalog, map->id);
+    if (entry == NULL) {
+        if (catalog->entry_cnt == catalog->entry_size) {
+            catalog->entry_size *= 2;
+            catalog->entries = realloc(catalog->entries, sizeof(MapCatalogEntry) * catalog->entry_size);
+        }
+        int i = ELE_LowerMapCatalogEntry(catalog, map->id);
+        memmove(catalog->entries + i + 1, catalog->entries + i,
+            sizeof(MapCatalogEntry) * (catalog->entry_cnt - i));
+        ++catalog->entry_cnt;
+        entry = &catalog->entries[i];
+    }
+    memset(entry, 0, sizeof(MapCatalogEntry));
+    entry->id = map->id;
+    entry->area_cnt = map->area_cnt;
+    entry->checksum = ELE_GetMapChecksum(data, size);
+    entry->file_size = size;
+    int min_x = INT_MAX, min_y = INT_MAX, max_x = INT_MIN, max_y = INT_MIN;
+    for (int i = 0; i < map->area_cnt; i++) {
+        Area *area = map->areas[i];
+        for (int v = 0; v < area->vertex_cnt; v++) {
+            min_x = SDL_min(min_x, area->vertices[v].x);
+            min_y = SDL_min(min_y, area->vertices[v].y);
+            max_x = SDL_max(max_x, area->vertices[v].x);
+            max_y = SDL_max(max_y, area->vertices[v].y);
+        }
+    }
+    if (min_x <= max_x) entry->box = (SDL_Rect){min_x, min_y, max_x - min_x + 1, max_y - min_y + 1};
+    ELE_RenderMapThumbnail(map, entry->thumbnail);
+}
+
+/* ELE_CatalogMap on the catalog in filename, which is created if missing */
+int ELE_UpdateMapCatalog(const char *filename, Map *map, const Uint8 *data, Sint64 size) {
+    MapCatalog *catalog = ELE_LoadMapCatalog(filename);
+    if (catalog == NULL) catalog = ELE_BuildMapCatalog();
+    ELE_CatalogMap(catalog, map, data, size);
+    int result = ELE_SaveMapCatalog(catalog, filename);
+    ELE_DestroyMapCatalog(catalog);
+    return result;
+}
+
+/* Id for a new map, one past the largest catalogued */
+int ELE_GetNextMapId(MapCatalog *catalog) {
+    if (catalog == NULL || catalog->entry_cnt == 0) return 0;
+    return catalog->entries[catalog->entry_cnt - 1].id + 1;
+}
+
+/* Scanline fill of every area, the play field scaled to MAP_THUMB_W x MAP_THUMB_H */
+void ELE_RenderMapThumbnail(Map *map, Uint8 *thumbnail) {
+    memset(thumbnail, 0, MAP_THUMB_BYTES);
+    double sx = 1.0 * MAP_THUMB_W / map->w, sy = 1.0 * MAP_THUMB_H / map->h;
+    double *xs = NULL;
+    int xs_size = 0;
+    for (int i = 0; i < map->area_cnt; i++) {
+        Area *area = map->areas[i];
+        int n = area->vertex_cnt;
+        if (n < 3) continue;
+        if (n > xs_size) {
+            xs_size = n;
+            xs = realloc(xs, sizeof(double) * xs_size);
+        }
+        int min_y = INT_MAX, max_y = INT_MIN;
+        for (int v = 0; v < n; v++) {
+            min_y = SDL_min(min_y, area->vertices[v].y);
+            max_y = SDL_max(max_y, area->vertices[v].y);
+        }
+        int first_row = SDL_max(0, (int)floor(min_y * sy));
+        int last_row = SDL_min(MAP_THUMB_H - 1, (int)ceil(max_y * sy));
+        for (int py = first_row; py <= last_row; py++) {
+            double y = (py + 0.5) / sy;
+            int cnt = 0;
+            for (int v = 0; v < n; v++) {
+                SDL_Point a = area->vertices[v], b = area->vertices[(v + 1) % n];
+                if ((a.y <= y) == (b.y <= y)) continue;
+                double x = a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y);
+                int k = cnt++;
+                for (; k > 0 && xs[k - 1] > x; k--) xs[k] = xs[k - 1];
+                xs[k] = x;
+            }
+            for (int k = 0; k + 1 < cnt; k += 2) {
+                int x0 = SDL_max(0, (int)ceil(xs[k] * sx - 0.5));
+                int x1 = SDL_min(MAP_THUMB_W - 1, (int)floor(xs[k + 1] * sx - 0.5));
+                for (int px = x0; px <= x1; px++) {
+                    thumbnail[(py * MAP_THUMB_W + px) >> 3] |= 0x80 >> (px & 7);
+                }
+            }
+        }
+    }
+    free(xs);
+}
+
+int ELE_GetThumbnailPixel(const Uint8 *thumbnail, int x, int y) {
+    if (x < 0 || y < 0 || x >= MAP_THUMB_W || y >= MAP_THUMB_H) return 0;
+    return (thumbnail[(y * MAP_THUMB_W + x) >> 3] >> (7 - (x & 7))) & 1;
+}
\ No newline at end of file
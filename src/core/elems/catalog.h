@@ -0,0 +1,74 @@
+#ifndef _CATALOG_H
+#define _CATALOG_H
+
+#include <SDL2/SDL.h>
+#include "map.h"
+
+/*
+ * Index of the saved maps so the chooser never opens a map file before
+ * one is picked. Kept in MAP_CATALOG_FILE by ELE_SaveMap; entries are
+ * sorted by id and each carries a one bit per pixel thumbnail of the
+ * map's play field, set inside an area.
+ */
+
+#define MAP_CATALOG_FILE "bin/data/catalog.bin"
+
+enum ELE_MapCatalogConstants {
+    MAP_CATALOG_VERSION = 1,
+    MAP_THUMB_W = 128,
+    MAP_THUMB_H = 96,
+    MAP_THUMB_BYTES = MAP_THUMB_W * MAP_THUMB_H / 8,
+    /* Missing ids in a row before ELE_BuildMapCatalog stops looking */
+    MAP_CATALOG_GAP = 64
+};
+
+struct MapCatalogHeader {
+    char magic[4];
+    Uint32 version;
+    Uint32 entry_cnt;
+    /* ELE_GetMapChecksum of the entries */
+    Uint32 checksum;
+};
+typedef struct MapCatalogHeader MapCatalogHeader;
+
+struct MapCatalogEntry {
+    Sint32 id;
+    Sint32 area_cnt;
+    /* Of every vertex */
+    SDL_Rect box;
+    /*
+     * ELE_GetMapChecksum and size of the whole map file, compared with
+     * it by ELE_CheckMapCatalogEntry. Each map has a file of its own,
+     * so there is no offset to keep.
+     */
+    Uint32 checksum;
+    Uint32 reserved;
+    Sint64 file_size;
+    Uint8 thumbnail[MAP_THUMB_BYTES];
+};
+typedef struct MapCatalogEntry MapCatalogEntry;
+
+struct MapCatalog {
+    MapCatalogEntry *entries;
+    int entry_cnt;
+    int entry_size;
+};
+typedef struct MapCatalog MapCatalog;
+
+extern MapCatalog* ELE_CreateMapCatalog(void);
+extern void ELE_DestroyMapCatalog(MapCatalog *catalog);
+
+extern MapCatalog* ELE_LoadMapCatalog(const char *filename);
+extern int ELE_SaveMapCatalog(MapCatalog *catalog, const char *filename);
+extern MapCatalog* ELE_BuildMapCatalog(void);
+extern int ELE_CheckMapCatalogEntry(MapCatalog *catalog, int id);
+
+extern MapCatalogEntry* ELE_FindMapCatalogEntry(MapCatalog *catalog, int id);
+extern void ELE_CatalogMap(MapCatalog *catalog, Map *map, const Uint8 *data, Sint64 size);
+extern int ELE_UpdateMapCatalog(const char *filename, Map *map, const Uint8 *data, Sint64 size);
+extern int ELE_GetNextMapId(MapCatalog *catalog);
+
+extern void ELE_RenderMapThumbnail(Map *map, Uint8 *thumbnail);
+extern int ELE_GetThumbnailPixel(const Uint8 *thumbnail, int x, int y);
+
+#endif /* _CATALOG_H */
\ No newline at end of file
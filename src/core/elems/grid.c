@@ -0,0 +1,76 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include "grid.h"
+
+Grid* ELE_CreateGrid(int cell_size) {
+    Grid *new_grid = malloc(sizeof(Grid));
+    new_grid->cell_size = cell_size;
+    new_grid->cols = new_grid->rows = 0;
+    new_grid->cell_start = NULL;
+    new_grid->cell_alloc = 0;
+    new_grid->items = NULL;
+    new_grid->item_x = new_grid->item_y = NULL;
+    new_grid->item_cnt = 0;
+    new_grid->item_size = 0;
+    return new_grid;
+}
+
+void ELE_DestroyGrid(Grid *grid) {
+    if (grid == NULL) return;
+    free(grid->cell_start);
+    free(grid->items);
+    free(grid->item_x);
+    free(grid->item_y);
+    free(grid);
+}
+
+void ELE_GetGridCell(Grid *grid, int x, int y, int *cx, int *cy) {
+    /* Clamping never moves two points further apart in cells, so points
+     * outside the field still meet their neighbours in the edge cells */
+    *cx = SDL_max(0, SDL_min(grid->cols - 1, (x < 0 ? -1 : x / grid->cell_size)));
+    *cy = SDL_max(0, SDL_min(grid->rows - 1, (y < 0 ? -1 : y / grid->cell_size)));
+}
+
+int ELE_GetGridCellIndex(Grid *grid, int x, int y) {
+    int cx, cy;
+    ELE_GetGridCell(grid, x, y, &cx, &cy);
+    return cy * grid->cols + cx;
+}
+
+/* Counting sort of items 0..cnt-1 by cell */
+void ELE_BuildGrid(Grid *grid, int w, int h, const int *xs, const int *ys, int cnt) {
+    grid->cols = SDL_max(w, 0) / grid->cell_size + 1;
+    grid->rows = SDL_max(h, 0) / grid->cell_size + 1;
+    int cell_cnt = grid->cols * grid->rows;
+    if (cell_cnt + 1 > grid->cell_alloc) {
+        grid->cell_alloc = cell_cnt + 1;
+        grid->cell_start = realloc(grid->cell_start, sizeof(int) * grid->cell_alloc);
+    }
+    if (cnt > grid->item_size) {
+        grid->item_size = cnt;
+        grid->items = realloc(grid->items, sizeof(int) * cnt);
+        grid->item_x = realloc(grid->item_x, sizeof(int) * cnt);
+        grid->item_y = realloc(grid->item_y, sizeof(int) * cnt);
+    }
+    grid->item_cnt = cnt;
+    int *start = grid->cell_start;
+    memset(start, 0, sizeof(int) * (cell_cnt + 1));
+    for (int i = 0; i < cnt; i++) {
+        ++start[ELE_GetGridCellIndex(grid, xs[i], ys[i])];
+    }
+    int sum = 0;
+    for (int c = 0; c < cell_cnt; c++) {
+        int item_cnt = start[c];
+        start[c] = sum;
+        sum += item_cnt;
+    }
+    /* Fill each cell, leaving start[c] at the end of cell c */
+    for (int i = 0; i < cnt; i++) {
+        int pos = start[ELE_GetGridCellIndex(grid, xs[i], ys[i])]++;
+        grid->items[pos] = i;
+        grid->item_x[pos] = xs[i];
+        grid->item_y[pos] = ys[i];
+    }
+    for (int c = cell_cnt; c > 0; c--) start[c] = start[c - 1];
+    start[0] = 0;
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef _GRID_H
+#define _GRID_H
+
+/*
+ * Uniform grid over the play field, rebuilt every tick. Items are plain
+ * indices sorted by cell, so the cells of one grid row are contiguous:
+ * cell c holds items [cell_start[c], cell_start[c + 1]), ascending.
+ */
+struct Grid {
+    int cell_size;
+    int cols, rows;
+    int *cell_start;
+    int cell_alloc;
+
+    int *items;
+    /* Coordinates of items, in the same order */
+    int *item_x, *item_y;
+    int item_cnt;
+    int item_size;
+};
+typedef struct Grid Grid;
+
+extern Grid* ELE_CreateGrid(int cell_size);
+extern void ELE_DestroyGrid(Grid *grid);
+
+extern void ELE_BuildGrid(Grid *grid, int w, int h, const int *xs, const int *ys, int cnt);
+
+extern void ELE_GetGridCell(Grid *grid, int x, int y, int *cx, int *cy);
+
+#endif /* _GRID_H */
\ No newline at end of file
@@ -1,35 +1,69 @@
 #include <SDL2/SDL.h>
 #include <stdlib.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "map.h"
 #include "player.h"
 #include "area.h"
 #include "potion.h"
-#include "../video.h"
+#include "grid.h"
+#include "mapfile.h"
+#include "catalog.h"
+#include "../kernels.h"
 #include "../log.h"
 
+_Static_assert(MAP_MAX_PLAYER_CNT <= 32, "Map::commanded has a bit per player");
+
 enum ELE_MapConstants {
-    MAX_PLAYER_CNT = 15,
-    MAX_AREA_CNT = 31,
-    TROOP_RADIUS = 6
+    TROOP_RADIUS = 6,
+    ARRIVE_DIST = 40,
+    DEFAULT_MAP_W = 1024,
+    DEFAULT_MAP_H = 768,
+    DEFAULT_TROOP_CNT = 30,
+    DEFAULT_TROOP_RATE = 60, /* Frame */
+    INITIAL_POTION_SIZE = 4,
+    /* Smallest cell of Map::area_grid, which aims at about an area a cell */
+    MIN_AREA_CELL_SIZE = 32
 };
 
 Map* ELE_CreateMap(
     int id, Player **players, int player_cnt,
     Area **areas, int area_cnt
 ) {
-    if (player_cnt > MAX_PLAYER_CNT) {
+    if (player_cnt > MAP_MAX_PLAYER_CNT) {
         LogInfo("Players too much");
         return NULL;
     }
-    if (area_cnt > MAX_AREA_CNT) {
-        LogInfo("Areas too much");
-        return NULL;
-    }
     Map *new_map = malloc(sizeof(Map));
     new_map->id = id;
     new_map->player_cnt = player_cnt;
     new_map->area_cnt = area_cnt;
-    new_map->troops_head = NULL;
+    new_map->troops = ELE_CreateTroopStore();
+    new_map->players = NULL;
+    new_map->areas = NULL;
+    new_map->area_index = (IdIndex){NULL, 0};
+    new_map->player_index = (IdIndex){NULL, 0};
+    new_map->area_grid = NULL;
+    new_map->area_origin = (SDL_Point){0, 0};
+    new_map->state = NULL;
+    new_map->state_size = 0;
+    new_map->human = NULL;
+    new_map->commanded = 0;
+    new_map->frame = 0;
+    new_map->next_troop_id = 0;
+    for (int i = 0; i < MAP_RNG_CNT; i++) RNG_Seed(&new_map->rng[i], 0, i);
+    new_map->w = DEFAULT_MAP_W;
+    new_map->h = DEFAULT_MAP_H;
+    new_map->collision_mode = COLLISION_GRID;
+    new_map->troop_grid = ELE_CreateGrid(2 * TROOP_RADIUS);
+    new_map->view = NULL;
+    new_map->view_size = 0;
+    new_map->arena = NULL;
+    memset(&new_map->counters, 0, sizeof(MapCounters));
     if (player_cnt) {
         new_map->players = malloc(sizeof(Player*) * player_cnt);
         memcpy(new_map->players, players, sizeof(Player*) * player_cnt);
@@ -38,206 +72,596 @@ Map* ELE_CreateMap(
         new_map->areas = malloc(sizeof(Area*) * area_cnt);
         memcpy(new_map->areas, areas, sizeof(Area*) * area_cnt);
     }
+    ELE_ResetMapState(new_map);
     return new_map;
 }
 
-void ELE_DestroyMap(Map *map) {
-    if (map == NULL) return;
-    for (int i = 0; i < map->area_cnt; i++) ELE_DestroyArea(map->areas[i]);
-    Troop *head;
-    for (head = map->troops_head; head != NULL; head = head->next) {
-        if (head->prev != NULL) {
-            ELE_DestroyTroop(head->prev);
-        }
-        if (head->next == NULL) {
-            ELE_DestroyTroop(head);
-            break;
-        }
+/*
+ * Map with the areas of map and nothing else, for running a match on.
+ * Vertices are shared so map must outlive the copy.
+ */
+Map* ELE_CloneMapGeometry(Map *map) {
+    Map *new_map = ELE_CreateMap(map->id, NULL, 0, NULL, 0);
+    new_map->w = map->w;
+    new_map->h = map->h;
+    new_map->collision_mode = map->collision_mode;
+    new_map->area_cnt = map->area_cnt;
+    new_map->areas = malloc(sizeof(Area*) * SDL_max(map->area_cnt, 1));
+    for (int i = 0; i < map->area_cnt; i++) {
+        new_map->areas[i] = ELE_CloneArea(map->areas[i]);
+    }
+    ELE_ResetMapState(new_map);
+    for (int i = 0; i < map->area_cnt; i++) {
+        new_map->area_states[i].troop_cnt = map->area_states[i].troop_cnt;
+    }
+    return new_map;
+}
+
+void* ELE_AllocMapBlock(Map *map, Sint64 size) {
+    return (map->arena ? ARN_Alloc(map->arena, size) : malloc(size));
+}
+
+void ELE_FreeMapBlock(Map *map, void *block) {
+    if (map->arena == NULL) free(block);
+}
+
+Sint64 ELE_GetMapStateSize(int area_cnt, int player_cnt, int potion_size) {
+    return sizeof(AreaState) * (Sint64)area_cnt + sizeof(PlayerState) * (Sint64)player_cnt +
+        sizeof(Potion) * (Sint64)potion_size;
+}
+
+/* Points area_states, player_states and potions into state */
+void ELE_BindMapState(Map *map) {
+    map->area_states = (AreaState*)map->state;
+    map->player_states = (PlayerState*)(map->area_states + map->area_cnt);
+    map->potions = (Potion*)(map->player_states + map->player_cnt);
+}
+
+void ELE_BuildIdIndex(IdIndex *index, int cnt) {
+    free(index->entries);
+    index->size = 4;
+    while (index->size < 2 * cnt) index->size *= 2;
+    index->entries = malloc(sizeof(IdIndexEntry) * index->size);
+    for (int i = 0; i < index->size; i++) index->entries[i] = (IdIndexEntry){0, -1};
+}
+
+/* Entry of id, or the empty one it would go in */
+IdIndexEntry* ELE_FindIdIndexEntry(const IdIndex *index, int id) {
+    int mask = index->size - 1;
+    for (int i = ELE_HashId(id) & mask; ; i = (i + 1) & mask) {
+        IdIndexEntry *entry = &index->entries[i];
+        if (entry->index < 0 || entry->id == id) return entry;
+    }
+}
+
+/* The first of equal ids is kept, as a scan would find it */
+void ELE_AddToIdIndex(IdIndex *index, int id, int i) {
+    IdIndexEntry *entry = ELE_FindIdIndexEntry(index, id);
+    if (entry->index < 0) *entry = (IdIndexEntry){id, i};
+}
+
+int ELE_LookUpIdIndex(const IdIndex *index, int id) {
+    if (index->size == 0) return -1;
+    return ELE_FindIdIndexEntry(index, id)->index;
+}
+
+/* Cells of about an area each, over the box of the centers */
+void ELE_BuildAreaGrid(Map *map) {
+    int cnt = map->area_cnt;
+    int *xs = malloc(sizeof(int) * SDL_max(cnt, 1));
+    int *ys = malloc(sizeof(int) * SDL_max(cnt, 1));
+    SDL_Point min = {0, 0}, max = {0, 0};
+    for (int i = 0; i < cnt; i++) {
+        SDL_Point center = map->areas[i]->center;
+        min.x = (i ? SDL_min(min.x, center.x) : center.x);
+        min.y = (i ? SDL_min(min.y, center.y) : center.y);
+        max.x = (i ? SDL_max(max.x, center.x) : center.x);
+        max.y = (i ? SDL_max(max.y, center.y) : center.y);
+    }
+    for (int i = 0; i < cnt; i++) {
+        xs[i] = map->areas[i]->center.x - min.x;
+        ys[i] = map->areas[i]->center.y - min.y;
+    }
+    int w = max.x - min.x, h = max.y - min.y;
+    int cell_size = (int)SDL_sqrt((double)w * h / SDL_max(cnt, 1));
+    ELE_DestroyGrid(map->area_grid);
+    map->area_grid = ELE_CreateGrid(SDL_max(cell_size, MIN_AREA_CELL_SIZE));
+    ELE_BuildGrid(map->area_grid, w, h, xs, ys, cnt);
+    map->area_origin = min;
+    free(xs);
+    free(ys);
+}
+
+void ELE_IndexMap(Map *map) {
+    ELE_BuildIdIndex(&map->area_index, map->area_cnt);
+    for (int i = 0; i < map->area_cnt; i++) ELE_AddToIdIndex(&map->area_index, map->areas[i]->id, i);
+    ELE_BuildIdIndex(&map->player_index, map->player_cnt);
+    for (int i = 0; i < map->player_cnt; i++) {
+        if (map->players[i] != NULL) ELE_AddToIdIndex(&map->player_index, map->players[i]->id, i);
+    }
+    ELE_BuildAreaGrid(map);
+}
+
+/* Fresh state for the areas and players map has now, with no potions, and their indexes */
+void ELE_ResetMapState(Map *map) {
+    ELE_IndexMap(map);
+    ELE_FreeMapBlock(map, map->state);
+    map->potion_cnt = 0;
+    map->potion_size = INITIAL_POTION_SIZE;
+    map->state_size = ELE_GetMapStateSize(map->area_cnt, map->player_cnt, map->potion_size);
+    map->state = ELE_AllocMapBlock(map, map->state_size);
+    ELE_BindMapState(map);
+    for (int i = 0; i < map->area_cnt; i++) {
+        AreaState *state = &map->area_states[i];
+        state->conqueror = -1;
+        state->troop_cnt = DEFAULT_TROOP_CNT;
+        state->troop_rate = DEFAULT_TROOP_RATE;
+        state->troop_inc_delay = 0;
+        state->attack = -1;
+        state->attack_delay = 0;
+        state->attack_cnt = 0;
     }
     for (int i = 0; i < map->player_cnt; i++) {
-        map->players[i]->area_cnt = 0;
-        map->players[i]->troop_cnt = 0;
-        map->players[i]->attack_delay = 0;
-        map->players[i]->applied_potion = NULL;
+        PlayerState *state = &map->player_states[i];
+        state->area_cnt = 0;
+        state->troop_cnt = 0;
+        state->troop_rate = DEFAULT_TROOP_RATE;
+        state->attack_delay = 0;
+        state->potion = ELE_MakeEmptyPotion();
     }
+}
+
+void ELE_GrowMapPotions(Map *map) {
+    Uint8 *old_state = map->state;
+    Sint64 old_size = map->state_size;
+    map->potion_size *= 2;
+    map->state_size = ELE_GetMapStateSize(map->area_cnt, map->player_cnt, map->potion_size);
+    map->state = ELE_AllocMapBlock(map, map->state_size);
+    memcpy(map->state, old_state, old_size);
+    ELE_BindMapState(map);
+    ELE_FreeMapBlock(map, old_state);
+}
+
+/*
+ * Copy of the match on map for looking ahead, allocated from arena
+ * and gone with its next ARN_Reset. Areas and players are shared, and
+ * so is grid, which is only scratch for ELE_HandleCollisions and may
+ * be map's own when the clone is stepped on the same thread.
+ */
+Map* ELE_CloneMatch(Map *map, ARN_Arena *arena, Grid *grid) {
+    Map *new_map = ARN_Alloc(arena, sizeof(Map));
+    if (new_map == NULL) return NULL;
+    *new_map = *map;
+    new_map->state = ARN_Alloc(arena, map->state_size);
+    if (new_map->state == NULL) return NULL;
+    memcpy(new_map->state, map->state, map->state_size);
+    ELE_BindMapState(new_map);
+    new_map->troops = ELE_CloneTroopStore(map->troops, arena);
+    if (new_map->troops == NULL) return NULL;
+    new_map->troop_grid = (grid ? grid : map->troop_grid);
+    new_map->view = NULL;
+    new_map->view_size = 0;
+    new_map->arena = arena;
+    return new_map;
+}
+
+/* Clones go with their arena and are left alone */
+void ELE_DestroyMap(Map *map) {
+    if (map == NULL || map->arena != NULL) return;
+    for (int i = 0; i < map->area_cnt; i++) ELE_DestroyArea(map->areas[i]);
+    ELE_DestroyTroopStore(map->troops);
+    free(map->state);
+    ELE_DestroyGrid(map->troop_grid);
+#ifndef _WIN32
+    /* After the areas, which only borrow their vertices from it */
+    if (map->view != NULL) munmap(map->view, map->view_size);
+#endif
     free(map->areas);
     free(map->players);
+    free(map->area_index.entries);
+    free(map->player_index.entries);
+    ELE_DestroyGrid(map->area_grid);
     free(map);
 }
 
-Area* ELE_GetAreaById(Map *map, int id) {
-    if (map == NULL) return NULL;
+/* -1 if no area has id */
+int ELE_GetAreaIndexById(Map *map, int id) {
+    return ELE_LookUpIdIndex(&map->area_index, id);
+}
+
+int ELE_GetPlayerIndexById(Map *map, int id) {
+    return ELE_LookUpIdIndex(&map->player_index, id);
+}
+
+/* Scans only if area shares its id with an earlier one, as in a broken file */
+int ELE_GetAreaIndex(Map *map, Area *area) {
+    if (area == NULL) return -1;
+    int index = ELE_LookUpIdIndex(&map->area_index, area->id);
+    if (index >= 0 && map->areas[index] == area) return index;
     for (int i = 0; i < map->area_cnt; i++) {
-        if (map->areas[i]->id == id) {
-            return map->areas[i];
+        if (map->areas[i] == area) return i;
+    }
+    return -1;
+}
+
+/*
+ * Lowest index of the areas whose center is closer than dist to (x, y)
+ * going along the axes, -1 if none is.
+ */
+int ELE_GetAreaAt(Map *map, int x, int y, int dist) {
+    Grid *grid = map->area_grid;
+    if (grid == NULL) return -1;
+    x -= map->area_origin.x;
+    y -= map->area_origin.y;
+    int x0, y0, x1, y1;
+    ELE_GetGridCell(grid, x - dist, y - dist, &x0, &y0);
+    ELE_GetGridCell(grid, x + dist, y + dist, &x1, &y1);
+    int found = -1;
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            int cell = cy * grid->cols + cx;
+            /* Ascending in a cell, so past found there is nothing lower */
+            for (int i = grid->cell_start[cell]; i < grid->cell_start[cell + 1]; i++) {
+                if (found >= 0 && grid->items[i] > found) break;
+                if (abs(x - grid->item_x[i]) + abs(y - grid->item_y[i]) < dist) found = grid->items[i];
+            }
+        }
+    }
+    return found;
+}
+
+/*
+ * Indexes of the up to max areas whose centers are nearest to (x, y)
+ * into areas, nearest first and the lower index first among equally
+ * near ones. Returns how many. Searches rings of cells outwards until
+ * the rings left are further than the furthest area kept.
+ */
+int ELE_GetNearestAreas(Map *map, int x, int y, int *areas, int max) {
+    Grid *grid = map->area_grid;
+    if (grid == NULL || max <= 0) return 0;
+    x -= map->area_origin.x;
+    y -= map->area_origin.y;
+    Sint64 dists[max];
+    int cnt = 0;
+    int cx, cy;
+    ELE_GetGridCell(grid, x, y, &cx, &cy);
+    int ring_cnt = SDL_max(SDL_max(cx, grid->cols - 1 - cx), SDL_max(cy, grid->rows - 1 - cy)) + 1;
+    for (int r = 0; r < ring_cnt; r++) {
+        /* Areas of ring r are at least r - 1 cells away */
+        Sint64 reach = (Sint64)SDL_max(r - 1, 0) * grid->cell_size;
+        if (cnt == max && dists[cnt - 1] < reach * reach) break;
+        for (int dy = -r; dy <= r; dy++) {
+            if (cy + dy < 0 || cy + dy >= grid->rows) continue;
+            /* Whole top and bottom rows of the ring, the two ends of the others */
+            int step = (dy == -r || dy == r ? 1 : 2 * r);
+            for (int dx = -r; dx <= r; dx += step) {
+                if (cx + dx < 0 || cx + dx >= grid->cols) continue;
+                int cell = (cy + dy) * grid->cols + cx + dx;
+                for (int i = grid->cell_start[cell]; i < grid->cell_start[cell + 1]; i++) {
+                    Sint64 ix = grid->item_x[i] - x, iy = grid->item_y[i] - y;
+                    Sint64 dist = ix * ix + iy * iy;
+                    int area = grid->items[i];
+                    if (cnt == max && (dist > dists[cnt - 1] ||
+                        (dist == dists[cnt - 1] && area > areas[cnt - 1]))) continue;
+                    int at = (cnt < max ? cnt++ : cnt - 1);
+                    for (; at > 0 && (dists[at - 1] > dist || (dists[at - 1] == dist && areas[at - 1] > area)); at--) {
+                        dists[at] = dists[at - 1];
+                        areas[at] = areas[at - 1];
+                    }
+                    dists[at] = dist;
+                    areas[at] = area;
+                }
+            }
         }
     }
-    return NULL;
+    return cnt;
 }
 
-int ELE_SaveMap(Map *map, int lastmap, Potion **potions_onmap, int potion_cnt) {
+/* Maps other than lastmap are added to MAP_CATALOG_FILE too */
+int ELE_SaveMap(Map *map, int lastmap) {
     if (map == NULL) return 0;
     char filename[24];
     if (lastmap)
         sprintf(filename, "bin/data/lastmap.bin");
     else
         sprintf(filename, "bin/data/map%d.bin", map->id);
-    SDL_RWops *map_file = SDL_RWFromFile(filename, "w+b");
-    if (map_file == NULL && !lastmap) {
-        sprintf(filename, "bin/data/map%d", map->id);
-        map_file = SDL_RWFromFile(filename, "w+b");
-    }
-    if (map_file != NULL) {
-        SDL_RWwrite(map_file, &map->id, sizeof(int), 1);
-        if (lastmap) {
-            SDL_RWwrite(map_file, &map->player_cnt, sizeof(int), 1);
-            for (int i = 0; i < map->player_cnt; i++) {
-                Player *player = map->players[i];
-                SDL_RWwrite(map_file, &player->id, sizeof(int), 1);
-                SDL_RWwrite(map_file, &player->area_cnt, sizeof(int), 1);
-                SDL_RWwrite(map_file, &player->troop_cnt, sizeof(int), 1);
-                SDL_RWwrite(map_file, &player->troop_rate, sizeof(int), 1);
-                SDL_RWwrite(map_file, &player->attack_delay, sizeof(int), 1);
-                Potion *pt = player->applied_potion;
-                int haspt = (pt != NULL);
-                SDL_RWwrite(map_file, &haspt, sizeof(int), 1);
-                if (haspt) SDL_RWwrite(map_file, pt, sizeof(Potion), 1);
-            }
-            SDL_RWwrite(map_file, &potion_cnt, sizeof(int), 1);
-            for (int i = 0; i < potion_cnt; i++) {
-                if (potions_onmap[i] != NULL)
-                    SDL_RWwrite(map_file, potions_onmap[i], sizeof(Potion), 1);
-                else
-                    SDL_RWwrite(map_file, &(Potion){0}, sizeof(Potion), 1);
-            }
-        }
-        SDL_RWwrite(map_file, &map->area_cnt, sizeof(int), 1);
-        for (int i = 0; i < map->area_cnt; i++) {
-            Area *area = map->areas[i];
-            SDL_RWwrite(map_file, &area->id, sizeof(int), 1);
-            int conq_id = (area->conqueror ? area->conqueror->id : -1);
-            SDL_RWwrite(map_file, &conq_id, sizeof(int), 1);
-            SDL_RWwrite(map_file, &area->capacity, sizeof(int), 1);
-            SDL_RWwrite(map_file, &area->troop_cnt, sizeof(int), 1);
-            SDL_RWwrite(map_file, &area->troop_rate, sizeof(int), 1);
-            SDL_RWwrite(map_file, &area->troop_inc_delay, sizeof(int), 1);
-            SDL_RWwrite(map_file, &area->center, sizeof(SDL_Point), 1);
-            SDL_RWwrite(map_file, &area->radius, sizeof(int), 1);
-            SDL_RWwrite(map_file, &area->vertex_cnt, sizeof(int), 1);
-            for (int i = 0; i < area->vertex_cnt; i++) {
-                SDL_RWwrite(map_file, &area->vertices[i], sizeof(SDL_Point), 1);
-            }
-        }
-        if (lastmap) {
-            for (int i = 0; i < map->area_cnt; i++) {
-                int att_id = (map->areas[i]->attack ? map->areas[i]->attack->id : -1);
-                SDL_RWwrite(map_file, &att_id, sizeof(int), 1);
-                SDL_RWwrite(map_file, &map->areas[i]->attack_delay, sizeof(int), 1);
-                SDL_RWwrite(map_file, &map->areas[i]->attack_cnt, sizeof(int), 1);
-            }
-            int troop_cnt = ELE_GetMapTroopCnt(map);
-            SDL_RWwrite(map_file, &troop_cnt, sizeof(int), 1);
-            for (Troop *troop = map->troops_head; troop != NULL; troop = troop->next) {
-                SDL_RWwrite(map_file, &troop->id, sizeof(int), 1);
-                SDL_RWwrite(map_file, &troop->player->id, sizeof(int), 1);
-                SDL_RWwrite(map_file, &troop->x, sizeof(double), 1);
-                SDL_RWwrite(map_file, &troop->y, sizeof(double), 1);
-                SDL_RWwrite(map_file, &troop->src->id, sizeof(int), 1);
-                SDL_RWwrite(map_file, &troop->dst->id, sizeof(int), 1);
-            }
-        }
-        SDL_RWclose(map_file);
-    } else {
-        LogError("Unable to r/w maps: %s");
-        return -1;
-    }
+    Sint64 size;
+    Uint8 *data = ELE_SerializeMap(map, (lastmap ? MAP_FILE_MATCH : 0) | MAP_FILE_PACKED, &size);
+    if (data == NULL) return -1;
+    int result = ELE_WriteMapFile(filename, data, size);
+    if (result == 0 && !lastmap) result = ELE_UpdateMapCatalog(MAP_CATALOG_FILE, map, data, size);
+    free(data);
+    return result;
+}
+
+/* Serializes first so the file is written with a single call, see ELE_MapFileFlags */
+int ELE_SaveMapFile(Map *map, const char *filename, Uint32 flags) {
+    Sint64 size;
+    Uint8 *data = ELE_SerializeMap(map, flags, &size);
+    if (data == NULL) return -1;
+    int result = ELE_WriteMapFile(filename, data, size);
+    free(data);
+    return result;
+}
+
+/* Safe off the main thread like ELE_ReplaceFile, it touches no game state */
+int ELE_WriteMapFile(const char *filename, const Uint8 *data, Sint64 size) {
+    if (ELE_ReplaceFile(filename, data, size) != 0) return -1;
     LogInfo("Map save successful: %s", filename);
     return 0;
 }
 
+Map* ELE_LoadMap(int id, int lastmap, PlayerRegistry *registry) {
+    char filename[24];
+    if (lastmap)
+        sprintf(filename, "bin/data/lastmap.bin");
+    else
+        sprintf(filename, "bin/data/map%d.bin", id);
+    SDL_RWops *file = SDL_RWFromFile(filename, "rb");
+    if (file == NULL && !lastmap) {
+        sprintf(filename, "bin/data/map%d", id);
+        file = SDL_RWFromFile(filename, "rb");
+    }
+    if (file == NULL) {
+        LogInfo("Unable to read map files");
+        return NULL;
+    }
+    return ELE_ReadMap(file, lastmap, registry);
+}
+
+Map* ELE_LoadMapFile(const char *filename, int lastmap, PlayerRegistry *registry) {
+    SDL_RWops *file = SDL_RWFromFile(filename, "rb");
+    if (file == NULL) {
+        LogInfo("Unable to read map file %s", filename);
+        return NULL;
+    }
+    return ELE_ReadMap(file, lastmap, registry);
+}
+
+/* Reads a map file of any version and closes file */
+Map* ELE_ReadMap(SDL_RWops *file, int lastmap, PlayerRegistry *registry) {
+    Sint64 size = SDL_RWsize(file);
+    Uint8 *data = (size > 0 ? malloc(size) : NULL);
+    if (data == NULL || SDL_RWread(file, data, size, 1) != 1) {
+        LogInfo("Unable to read map file");
+        free(data);
+        SDL_RWclose(file);
+        return NULL;
+    }
+    SDL_RWclose(file);
+    Map *map = ELE_ParseMap(data, size, lastmap, 0, registry);
+    free(data);
+    if (map != NULL) LogInfo("Map file read successful");
+    return map;
+}
+
+/*
+ * Like ELE_LoadMapFile but the file is mapped read-only and kept until
+ * ELE_DestroyMap. Vertices of files saved without MAP_FILE_PACKED are
+ * not copied, the areas point into the mapping. Everything else,
+ * including match state, is allocated as usual.
+ */
+Map* ELE_MapMapFile(const char *filename, int lastmap, PlayerRegistry *registry) {
+#ifdef _WIN32
+    return ELE_LoadMapFile(filename, lastmap, registry);
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        LogInfo("Unable to read map file %s", filename);
+        return NULL;
+    }
+    struct stat st;
+    void *view = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        view = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (view == MAP_FAILED) {
+        LogInfo("Unable to map map file %s", filename);
+        return NULL;
+    }
+    Map *map = ELE_ParseMap(view, st.st_size, lastmap, 1, registry);
+    if (map == NULL) {
+        munmap(view, st.st_size);
+        return NULL;
+    }
+    map->view = view;
+    map->view_size = st.st_size;
+    LogInfo("Map file mapped: %s", filename);
+    return map;
+#endif
+}
+
+void ELE_AreaAttack(Map *map, int first, int second) {
+    AreaState *state = &map->area_states[first];
+    if (ELE_GetAreaAppliedPotionType(map, second) == AREA_SHIELD &&
+        state->conqueror != map->area_states[second].conqueror) return;
+    state->attack = second;
+    state->attack_cnt = state->troop_cnt;
+}
+
+void ELE_AreaUnAttack(Map *map, int area) {
+    map->area_states[area].attack = -1;
+    map->area_states[area].attack_cnt = 0;
+}
+
+void ELE_AreaConquer(Map *map, int area, int player) {
+    AreaState *state = &map->area_states[area];
+    if (state->conqueror >= 0) {
+        map->player_states[state->conqueror].area_cnt--;
+    }
+    map->player_states[player].area_cnt++;
+    state->conqueror = player;
+    ++map->counters.conquests;
+}
+
+/* Type of the potion the conqueror has applied, -1 for none */
+int ELE_GetAreaAppliedPotionType(Map *map, int area) {
+    int conqueror = map->area_states[area].conqueror;
+    if (conqueror < 0) return -1;
+    return map->player_states[conqueror].potion.type;
+}
+
+void ELE_AddPotionToMap(Map *map, Potion potion) {
+    if (map->potion_cnt == map->potion_size) ELE_GrowMapPotions(map);
+    map->potions[map->potion_cnt++] = potion;
+    ++map->counters.potions_spawned;
+}
+
 int ELE_GetMapAreaCntSum(Map *map) {
     int sum = 0;
     for (int i = 0; i < map->player_cnt; i++) {
-        sum += map->players[i]->area_cnt;
+        sum += map->player_states[i].area_cnt;
     }
     return sum;
 }
 
 int ELE_GetMapTroopCnt(Map *map) {
-    int troop_cnt = 0;
-    if (map == NULL) return troop_cnt;
-    for (Troop *troop = map->troops_head; troop != NULL; troop = troop->next) {
-        ++troop_cnt;
+    if (map == NULL) return 0;
+    return map->troops->cnt;
+}
+
+int ELE_AddTroopToMap(
+    Map *map, int id, int owner, Fixed x, Fixed y,
+    int src, int dst
+) {
+    ++map->player_states[owner].troop_cnt;
+    ++map->counters.troops_spawned;
+    return ELE_AddTroop(
+        map->troops, id, owner, x, y,
+        src, map->areas[src]->center,
+        dst, map->areas[dst]->center
+    );
+}
+
+void ELE_RemoveMarkedTroopsFromMap(Map *map) {
+    TroopStore *troops = map->troops;
+    for (int i = 0; i < troops->cnt; i++) {
+        if (troops->removed[i]) {
+            --map->player_states[troops->owner[i]].troop_cnt;
+            ++map->counters.troops_removed;
+        }
     }
-    return troop_cnt;
+    ELE_RemoveMarkedTroops(troops);
 }
 
-void ELE_AddTroopToMap(Map *map, Troop *troop) {
-    if (troop == NULL) return;
-    troop->next = troop->prev = NULL;
-    if (map->troops_head == NULL) {
-        map->troops_head = troop;
-    } else {
-        troop->next = map->troops_head;
-        map->troops_head->prev = troop;
-        map->troops_head = troop;
-    }
-}
-
-Troop* ELE_RemoveTroopFromMap(Map *map, Troop *troop) {
-    if (troop == NULL) return NULL;
-    if (troop->prev != NULL)
-        troop->prev->next = troop->next;
-    if (troop->next != NULL)
-        troop->next->prev = troop->prev;
-    if (troop == map->troops_head)
-        map->troops_head = troop->next;
-    Troop *ret = troop->next;
-    ELE_DestroyTroop(troop);
-    return ret;
-}
-
-int ELE_Collide(Troop *first, Troop *second) {
-    if (first == NULL || second == NULL) return 0;
-    if (first->player == second->player) return 0;
-    int x1 = first->x, y1 = first->y;
-    int x2 = second->x, y2 = second->y;
+int ELE_Collide(Map *map, int first, int second) {
+    TroopStore *troops = map->troops;
+    ++map->counters.pair_tests;
+    if (troops->owner[first] == troops->owner[second]) return 0;
+    int x1 = troops->xi[first], y1 = troops->yi[first];
+    int x2 = troops->xi[second], y2 = troops->yi[second];
     return (abs(x1 - x2) + abs(y1 - y2) < 2 * TROOP_RADIUS);
 }
 
-void ELE_HandleCollisions(Map *map) {
-    int w, h;
-    VDO_GetWindowSize(&w, &h);
-    for (Troop *troop = map->troops_head; troop != NULL;) {
-        if (troop->x < 0 || troop->y < 0 || troop->x > w || troop->y > h) {
-            troop = ELE_RemoveTroopFromMap(map, troop);
-        } else if (abs(troop->x - troop->dx) + abs(troop->y - troop->dy) < 40) {
-            Area *src = troop->src, *dst = troop->dst;
-            if (dst->conqueror == troop->player) {
-                ++dst->troop_cnt;
-            } else if (dst->troop_cnt == 0) {
-                ++dst->troop_cnt;
-                ELE_AreaConquer(dst, troop->player);
-            } else {
-                --dst->troop_cnt;
+void ELE_TroopArrive(Map *map, int i) {
+    TroopStore *troops = map->troops;
+    AreaState *dst = &map->area_states[troops->dst[i]];
+    int player = troops->owner[i];
+    ++map->counters.arrivals;
+    if (dst->conqueror == player) {
+        ++dst->troop_cnt;
+    } else if (dst->troop_cnt == 0) {
+        ++dst->troop_cnt;
+        ELE_AreaConquer(map, troops->dst[i], player);
+    } else {
+        --dst->troop_cnt;
+    }
+    dst->troop_inc_delay = 10;
+}
+
+/* Scalar reference for KRN_TroopStatus */
+int ELE_GetTroopStatus(Map *map, int i) {
+    TroopStore *troops = map->troops;
+    Fixed x = troops->x[i], y = troops->y[i];
+    if (x < 0 || y < 0 || x > ELE_IntToFixed(map->w) || y > ELE_IntToFixed(map->h)) return TROOP_OUTSIDE;
+    if (abs(troops->xi[i] - troops->dx[i]) + abs(troops->yi[i] - troops->dy[i]) < ARRIVE_DIST)
+        return TROOP_ARRIVED;
+    return TROOP_ALIVE;
+}
+
+/*
+ * Returns 1 if the troop at index i stays on the field and should look
+ * for collisions, otherwise marks it removed.
+ */
+int ELE_HandleTroop(Map *map, int i, int status) {
+    TroopStore *troops = map->troops;
+    if (status == TROOP_OUTSIDE) {
+        troops->removed[i] = 1;
+        return 0;
+    }
+    if (status == TROOP_ARRIVED) {
+        ELE_TroopArrive(map, i);
+        troops->removed[i] = 1;
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Troops are handled oldest first. A troop colliding with any live troop
+ * after it is removed together with all of them.
+ */
+void ELE_HandleCollisionsBrute(Map *map) {
+    TroopStore *troops = map->troops;
+    for (int i = 0; i < troops->cnt; i++) {
+        if (troops->removed[i] || !ELE_HandleTroop(map, i, ELE_GetTroopStatus(map, i))) continue;
+        int found = 0;
+        for (int j = i + 1; j < troops->cnt; j++) {
+            if (!troops->removed[j] && ELE_Collide(map, i, j)) {
+                ++map->counters.collisions;
+                troops->removed[j] = 1;
+                found = 1;
+            }
+        }
+        if (found) troops->removed[i] = 1;
+    }
+    ELE_RemoveMarkedTroopsFromMap(map);
+}
+
+/*
+ * Same rules and visiting order as ELE_HandleCollisionsBrute. The grid
+ * narrows the later troops down to three runs of cells per troop, which
+ * the distance kernel scans.
+ */
+void ELE_HandleCollisionsGrid(Map *map) {
+    TroopStore *troops = map->troops;
+    Grid *grid = map->troop_grid;
+    ELE_BuildGrid(grid, map->w, map->h, troops->xi, troops->yi, troops->cnt);
+    KRN_TroopStatus(troops->x, troops->y, troops->xi, troops->yi, troops->dx, troops->dy,
+        troops->cnt, map->w, map->h, ARRIVE_DIST, troops->status);
+    for (int i = 0; i < troops->cnt; i++) {
+        if (troops->removed[i] || !ELE_HandleTroop(map, i, troops->status[i])) continue;
+        int found = 0;
+        int cx, cy;
+        ELE_GetGridCell(grid, troops->xi[i], troops->yi[i], &cx, &cy);
+        for (int y = SDL_max(cy - 1, 0); y <= SDL_min(cy + 1, grid->rows - 1); y++) {
+            int from = grid->cell_start[y * grid->cols + SDL_max(cx - 1, 0)];
+            int to = grid->cell_start[y * grid->cols + SDL_min(cx + 1, grid->cols - 1) + 1];
+            int near_cnt = KRN_FindNear(grid->item_x + from, grid->item_y + from, to - from,
+                troops->xi[i], troops->yi[i], 2 * TROOP_RADIUS, troops->near);
+            for (int k = from; k < to; k++) {
+                int j = grid->items[k];
+                map->counters.pair_tests += (j > i && !troops->removed[j]);
             }
-            dst->troop_inc_delay = 10;
-            troop = ELE_RemoveTroopFromMap(map, troop);
-        } else {
-            int found = 0;
-            for (Troop *troop2 = troop->next; troop2 != NULL;) {
-                if (ELE_Collide(troop, troop2)) {
-                    troop2 = ELE_RemoveTroopFromMap(map, troop2);
+            for (int k = 0; k < near_cnt; k++) {
+                int j = grid->items[from + troops->near[k]];
+                if (j > i && !troops->removed[j] && troops->owner[j] != troops->owner[i]) {
+                    ++map->counters.collisions;
+                    troops->removed[j] = 1;
                     found = 1;
-                } else {
-                    troop2 = troop2->next;
                 }
             }
-            if (found) {
-                troop = ELE_RemoveTroopFromMap(map, troop);
-            } else {
-                troop = troop->next;
-            }
         }
+        if (found) troops->removed[i] = 1;
+    }
+    ELE_RemoveMarkedTroopsFromMap(map);
+}
+
+void ELE_HandleCollisions(Map *map) {
+    if (map->collision_mode == COLLISION_BRUTE) {
+        ELE_HandleCollisionsBrute(map);
+    } else {
+        ELE_HandleCollisionsGrid(map);
     }
 }
\ No newline at end of file
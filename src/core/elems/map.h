@@ -2,9 +2,77 @@
 #define _MAP_H
 
 #include "player.h"
+#include "registry.h"
 #include "area.h"
 #include "troop.h"
+#include "potion.h"
+#include "grid.h"
+#include "../arena.h"
+#include "../rng.h"
 
+enum ELE_CollisionModes {
+    COLLISION_GRID,
+    /* Every pair of troops, kept to cross-check the grid */
+    COLLISION_BRUTE
+};
+
+enum ELE_MapLimits {
+    /* Each player has a bit of Map::commanded */
+    MAP_MAX_PLAYER_CNT = 15
+};
+
+/* One random stream per subsystem so they don't shift each other */
+enum ELE_MapRandomStreams {
+    MAP_RNG_START,
+    MAP_RNG_POTION,
+    MAP_RNG_AI,
+    MAP_RNG_CNT
+};
+
+/*
+ * Work done by the simulation since the counters were last cleared,
+ * see TLM_RecordTick. Not part of the match: files and hashes leave
+ * them out.
+ */
+struct MapCounters {
+    Uint32 troops_spawned;
+    /* Arrived, collided or out of the field */
+    Uint32 troops_removed;
+    /*
+     * Troop pairs checked for a collision, and pairs that collided. A
+     * pair is a troop and a live troop after it, each counted once
+     * whichever way the collisions are found.
+     */
+    Uint64 pair_tests;
+    Uint32 collisions;
+    Uint32 arrivals;
+    Uint32 conquests;
+    Uint32 potions_spawned;
+    Uint32 potions_picked;
+};
+typedef struct MapCounters MapCounters;
+
+struct IdIndexEntry {
+    int id;
+    /* -1 for an empty entry */
+    int index;
+};
+typedef struct IdIndexEntry IdIndexEntry;
+
+/* Open addressing table from ids to indexes, at most half full */
+struct IdIndex {
+    IdIndexEntry *entries;
+    int size;
+};
+typedef struct IdIndex IdIndex;
+
+/*
+ * Areas and players are shared with every clone of a map, anything a
+ * match changes is in state and troops. The state block holds
+ * area_states, player_states and potions, each indexed like the arrays
+ * they belong to, and refers to areas and players by index only, so
+ * ELE_CloneMatch copies it as it is.
+ */
 struct Map {
     int id;
 
@@ -14,7 +82,46 @@ struct Map {
     Area **areas;
     int area_cnt;
 
-    Troop *troops_head;
+    /* Of the ids of areas and players, built by ELE_ResetMapState */
+    IdIndex area_index;
+    IdIndex player_index;
+    /* Centers of the areas less area_origin, also built by ELE_ResetMapState */
+    Grid *area_grid;
+    SDL_Point area_origin;
+
+    Uint8 *state;
+    Sint64 state_size;
+    AreaState *area_states;
+    PlayerState *player_states;
+    /* Empty slots have type POTION_NONE */
+    Potion *potions;
+    int potion_cnt;
+    int potion_size;
+
+    TroopStore *troops;
+
+    /* Player driven by commands rather than the AI, NULL if none */
+    Player *human;
+    /* Bit i set if players[i] is driven by commands too, see AI_Pool */
+    Uint32 commanded;
+    int frame;
+    int next_troop_id;
+    /* Seeded by SIM_SeedMatch */
+    RNG rng[MAP_RNG_CNT];
+    /* Troops leaving this box are removed */
+    int w, h;
+
+    int collision_mode;
+    Grid *troop_grid;
+
+    /* File mapping the areas' vertices point into, see ELE_MapMapFile */
+    void *view;
+    Sint64 view_size;
+
+    /* Everything of a clone is allocated from it, NULL for other maps */
+    ARN_Arena *arena;
+
+    MapCounters counters;
 };
 typedef struct Map Map;
 
@@ -22,19 +129,44 @@ extern Map* ELE_CreateMap(
     int id, Player **players, int player_cnt,
     Area **areas, int area_cnt
 );
+extern Map* ELE_CloneMapGeometry(Map *map);
+extern Map* ELE_CloneMatch(Map *map, ARN_Arena *arena, Grid *grid);
 extern void ELE_DestroyMap(Map *map);
 
-extern Area* ELE_GetAreaById(Map *map, int id);
+extern void ELE_ResetMapState(Map *map);
+
+extern int ELE_GetAreaIndexById(Map *map, int id);
+extern int ELE_GetPlayerIndexById(Map *map, int id);
+extern int ELE_GetAreaIndex(Map *map, Area *area);
+extern int ELE_GetAreaAt(Map *map, int x, int y, int dist);
+extern int ELE_GetNearestAreas(Map *map, int x, int y, int *areas, int max);
 
-extern int ELE_SaveMap(Map *map, int lastmap, Potion **potions_onmap, int potion_cnt);
+extern int ELE_SaveMap(Map *map, int lastmap);
+extern int ELE_SaveMapFile(Map *map, const char *filename, Uint32 flags);
+extern int ELE_WriteMapFile(const char *filename, const Uint8 *data, Sint64 size);
+extern Map* ELE_LoadMap(int id, int lastmap, PlayerRegistry *registry);
+extern Map* ELE_LoadMapFile(const char *filename, int lastmap, PlayerRegistry *registry);
+extern Map* ELE_ReadMap(SDL_RWops *file, int lastmap, PlayerRegistry *registry);
+extern Map* ELE_MapMapFile(const char *filename, int lastmap, PlayerRegistry *registry);
+
+extern void ELE_AreaAttack(Map *map, int first, int second);
+extern void ELE_AreaUnAttack(Map *map, int area);
+extern void ELE_AreaConquer(Map *map, int area, int player);
+extern int ELE_GetAreaAppliedPotionType(Map *map, int area);
+
+extern void ELE_AddPotionToMap(Map *map, Potion potion);
 
 extern int ELE_GetMapAreaCntSum(Map *map);
 
 extern int ELE_GetMapTroopCnt(Map *map);
 
-extern void ELE_AddTroopToMap(Map *map, Troop *troop);
-extern Troop* ELE_RemoveTroopFromMap(Map *map, Troop *troop);
+extern int ELE_AddTroopToMap(
+    Map *map, int id, int owner, Fixed x, Fixed y,
+    int src, int dst
+);
+extern void ELE_RemoveMarkedTroopsFromMap(Map *map);
 
+extern int ELE_Collide(Map *map, int first, int second);
 extern void ELE_HandleCollisions(Map *map);
 
 #endif /* _MAP_H */
\ No newline at end of file
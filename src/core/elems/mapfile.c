@@ -0,0 +1,643 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mapfile.h"
+#include "map.h"
+#include "player.h"
+#include "registry.h"
+#include "area.h"
+#include "potion.h"
+#include "troop.h"
+#include "../log.h"
+
+const char MAP_FILE_MAGIC[4] = {'S', 'I', 'O', 'M'};
+
+/* Eight bytes per step, any tail is taken byte by byte */
+Uint64 ELE_HashBytes(Uint64 hash, const void *data, Sint64 size) {
+    const Uint8 *bytes = data;
+    Sint64 i = 0;
+    for (; i + 8 <= size; i += 8) {
+        Uint64 word;
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * 0x100000001B3ull;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+Uint32 ELE_GetMapChecksum(const Uint8 *data, Sint64 size) {
+    Uint64 hash = ELE_HashBytes(0xCBF29CE484222325ull, data, size);
+    return (Uint32)(hash ^ (hash >> 32));
+}
+
+/*
+ * Writes a temporary file next to filename and renames it over, so a
+ * crash mid-write leaves the previous file intact.
+ */
+int ELE_ReplaceFile(const char *filename, const Uint8 *data, Sint64 size) {
+    char temp_name[256];
+    if (snprintf(temp_name, sizeof(temp_name), "%s.tmp", filename) >= (int)sizeof(temp_name)) {
+        LogInfo("File name too long: %s", filename);
+        return -1;
+    }
+    SDL_RWops *file = SDL_RWFromFile(temp_name, "w+b");
+    if (file == NULL) {
+        LogError("Unable to create %s: %s", temp_name);
+        return -1;
+    }
+    size_t written = SDL_RWwrite(file, data, size, 1);
+    if (SDL_RWclose(file) != 0) written = 0;
+    if (written != 1) {
+        LogError("Unable to write %s: %s", temp_name);
+        remove(temp_name);
+        return -1;
+    }
+#ifdef _WIN32
+    /* rename doesn't replace there, the old file is gone for a moment */
+    remove(filename);
+#endif
+    if (rename(temp_name, filename) != 0) {
+        LogInfo("Unable to replace %s", filename);
+        remove(temp_name);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Everything a tick can change, straight from the live map so it is
+ * cheap enough to take every tick. Equal matches hash equal on any
+ * build with the same struct layouts.
+ */
+Uint32 ELE_HashMatchState(Map *map) {
+    Uint64 hash = 0xCBF29CE484222325ull;
+    Sint32 head[2] = {map->frame, map->next_troop_id};
+    hash = ELE_HashBytes(hash, head, sizeof(head));
+    hash = ELE_HashBytes(hash, map->rng, sizeof(map->rng));
+    /* Empty potions have id -1 and no frames left */
+    for (int i = 0; i < map->player_cnt; i++) {
+        PlayerState *player = &map->player_states[i];
+        Sint32 record[4] = {
+            player->troop_rate, player->attack_delay,
+            player->potion.id, player->potion.frames_applied
+        };
+        hash = ELE_HashBytes(hash, record, sizeof(record));
+    }
+    for (int i = 0; i < map->area_cnt; i++) {
+        AreaState *area = &map->area_states[i];
+        Sint32 record[6] = {
+            (area->conqueror >= 0 ? map->players[area->conqueror]->id : -1), area->troop_cnt,
+            area->troop_inc_delay, (area->attack >= 0 ? map->areas[area->attack]->id : -1),
+            area->attack_delay, area->attack_cnt
+        };
+        hash = ELE_HashBytes(hash, record, sizeof(record));
+    }
+    for (int i = 0; i < map->potion_cnt; i++) {
+        Sint32 record[2] = {map->potions[i].id, map->potions[i].frames_onmap};
+        hash = ELE_HashBytes(hash, record, sizeof(record));
+    }
+    TroopStore *troops = map->troops;
+    hash = ELE_HashBytes(hash, troops->id, sizeof(int) * troops->cnt);
+    hash = ELE_HashBytes(hash, troops->x, sizeof(Fixed) * troops->cnt);
+    hash = ELE_HashBytes(hash, troops->y, sizeof(Fixed) * troops->cnt);
+    hash = ELE_HashBytes(hash, troops->owner, sizeof(int) * troops->cnt);
+    hash = ELE_HashBytes(hash, troops->dst, sizeof(int) * troops->cnt);
+    return (Uint32)(hash ^ (hash >> 32));
+}
+
+Sint64 ELE_AlignMapFile(Sint64 offset) {
+    return (offset + MAP_FILE_ALIGN - 1) / MAP_FILE_ALIGN * MAP_FILE_ALIGN;
+}
+
+void ELE_WritePotionRecord(MapFilePotion *record, const Potion *potion) {
+    if (potion->type == POTION_NONE) {
+        memset(record, 0, sizeof(MapFilePotion));
+        return;
+    }
+    record->id = potion->id;
+    record->type = potion->type;
+    record->frames_onmap = potion->frames_onmap;
+    record->frames_applied = potion->frames_applied;
+    record->center = potion->center;
+}
+
+Potion ELE_ReadPotionRecord(const MapFilePotion *record) {
+    return ELE_MakePotion(record->id, record->type, record->frames_onmap,
+        record->frames_applied, record->center);
+}
+
+/* Troops of unknown owners or areas are dropped */
+void ELE_ReadTroopRecord(Map *map, int id, int owner_id, Fixed x, Fixed y, int src, int dst) {
+    int owner = ELE_GetPlayerIndexById(map, owner_id);
+    if (owner < 0 || src < 0 || src >= map->area_cnt || dst < 0 || dst >= map->area_cnt) return;
+    ELE_AddTroopToMap(map, id, owner, x, y, src, dst);
+    if (id >= map->next_troop_id) map->next_troop_id = id + 1;
+}
+
+Uint32 ELE_ZigZag(Sint32 v) {
+    return ((Uint32)v << 1) ^ (Uint32)(v >> 31);
+}
+
+Sint32 ELE_UnZigZag(Uint32 v) {
+    return (Sint32)(v >> 1) ^ -(Sint32)(v & 1);
+}
+
+/* Every vertex of map packed into out, or only counted if out is NULL */
+Sint64 ELE_PackVertices(Map *map, Uint8 *out) {
+    Sint64 size = 0;
+    for (int i = 0; i < map->area_cnt; i++) {
+        Area *area = map->areas[i];
+        SDL_Point prev = area->center;
+        for (int v = 0; v < area->vertex_cnt; v++) {
+            Uint32 zx = ELE_ZigZag(area->vertices[v].x - prev.x);
+            Uint32 zy = ELE_ZigZag(area->vertices[v].y - prev.y);
+            prev = area->vertices[v];
+            if (zx < 15 && zy < 16) {
+                if (out) out[size] = (zx << 4) | zy;
+                ++size;
+                continue;
+            }
+            if (out) out[size] = MAP_PACKED_ESCAPE;
+            ++size;
+            Uint32 parts[2] = {zx, zy};
+            for (int k = 0; k < 2; k++) {
+                Uint32 u = parts[k];
+                do {
+                    if (out) out[size] = (u & 0x7F) | (u > 0x7F ? 0x80 : 0);
+                    ++size;
+                    u >>= 7;
+                } while (u);
+            }
+        }
+    }
+    return size;
+}
+
+/* Decodes vertex_cnt vertices from *data, -1 if that runs past end */
+int ELE_UnpackVertices(
+    const Uint8 **data, const Uint8 *end, SDL_Point start,
+    SDL_Point *vertices, int vertex_cnt
+) {
+    const Uint8 *p = *data;
+    int x = start.x, y = start.y;
+    for (int v = 0; v < vertex_cnt; v++) {
+        if (p >= end) return -1;
+        Uint8 b = *p++;
+        if (b != MAP_PACKED_ESCAPE) {
+            x += ELE_UnZigZag(b >> 4);
+            y += ELE_UnZigZag(b & 15);
+        } else {
+            Uint32 parts[2];
+            for (int k = 0; k < 2; k++) {
+                Uint32 u = 0;
+                int shift = 0;
+                do {
+                    if (p >= end || shift > 28) return -1;
+                    u |= (Uint32)(*p & 0x7F) << shift;
+                    shift += 7;
+                } while (*p++ & 0x80);
+                parts[k] = u;
+            }
+            x += ELE_UnZigZag(parts[0]);
+            y += ELE_UnZigZag(parts[1]);
+        }
+        vertices[v].x = x;
+        vertices[v].y = y;
+    }
+    *data = p;
+    return 0;
+}
+
+/* Whole file in one malloc'd buffer, flags are ELE_MapFileFlags */
+Uint8* ELE_SerializeMap(Map *map, Uint32 flags, Sint64 *size) {
+    int lastmap = (flags & MAP_FILE_MATCH) != 0;
+    int vertex_cnt = 0;
+    for (int i = 0; i < map->area_cnt; i++) vertex_cnt += map->areas[i]->vertex_cnt;
+    MapFileSection sections[6];
+    int section_cnt = 0;
+    sections[section_cnt++] = (MapFileSection){
+        MAP_SECTION_AREAS, map->area_cnt, 0, sizeof(MapFileArea) * map->area_cnt
+    };
+    if (flags & MAP_FILE_PACKED) {
+        Sint64 packed_size = ELE_PackVertices(map, NULL);
+        sections[section_cnt++] = (MapFileSection){
+            MAP_SECTION_PACKED_VERTICES, packed_size, 0, packed_size
+        };
+    } else {
+        sections[section_cnt++] = (MapFileSection){
+            MAP_SECTION_VERTICES, vertex_cnt, 0, sizeof(SDL_Point) * vertex_cnt
+        };
+    }
+    if (lastmap) {
+        sections[section_cnt++] = (MapFileSection){
+            MAP_SECTION_PLAYERS, map->player_cnt, 0, sizeof(MapFilePlayer) * map->player_cnt
+        };
+        sections[section_cnt++] = (MapFileSection){
+            MAP_SECTION_POTIONS, map->potion_cnt, 0, sizeof(MapFilePotion) * map->potion_cnt
+        };
+        sections[section_cnt++] = (MapFileSection){
+            MAP_SECTION_FIXED_TROOPS, map->troops->cnt, 0, sizeof(MapFileTroop) * map->troops->cnt
+        };
+        sections[section_cnt++] = (MapFileSection){
+            MAP_SECTION_MATCH_STATE, 1, 0, sizeof(MapFileMatchState)
+        };
+    }
+    Sint64 offset = ELE_AlignMapFile(sizeof(MapFileHeader) + sizeof(MapFileSection) * section_cnt);
+    for (int i = 0; i < section_cnt; i++) {
+        sections[i].offset = offset;
+        offset = ELE_AlignMapFile(offset + sections[i].size);
+    }
+    Uint8 *data = calloc(offset, 1);
+    if (data == NULL) {
+        LogInfo("Unable to allocate %lld bytes for map", (long long)offset);
+        return NULL;
+    }
+    *size = offset;
+    MapFileHeader *header = (MapFileHeader*)data;
+    memcpy(header->magic, MAP_FILE_MAGIC, sizeof(header->magic));
+    header->version = MAP_FILE_VERSION;
+    header->flags = flags & (MAP_FILE_MATCH | MAP_FILE_PACKED);
+    header->id = map->id;
+    header->frame = (lastmap ? map->frame : 0);
+    header->section_cnt = section_cnt;
+    memcpy(data + sizeof(MapFileHeader), sections, sizeof(MapFileSection) * section_cnt);
+    // Areas and vertices
+    MapFileArea *area_records = (MapFileArea*)(data + sections[0].offset);
+    SDL_Point *vertices = NULL;
+    if (flags & MAP_FILE_PACKED) {
+        ELE_PackVertices(map, data + sections[1].offset);
+    } else {
+        vertices = (SDL_Point*)(data + sections[1].offset);
+    }
+    int vertex_start = 0;
+    for (int i = 0; i < map->area_cnt; i++) {
+        Area *area = map->areas[i];
+        AreaState *state = &map->area_states[i];
+        MapFileArea *record = &area_records[i];
+        record->id = area->id;
+        record->conqueror = (lastmap && state->conqueror >= 0 ? map->players[state->conqueror]->id : -1);
+        record->capacity = area->capacity;
+        record->troop_cnt = state->troop_cnt;
+        record->troop_rate = state->troop_rate;
+        record->troop_inc_delay = state->troop_inc_delay;
+        record->center = area->center;
+        record->radius = area->radius;
+        record->vertex_cnt = area->vertex_cnt;
+        record->vertex_start = vertex_start;
+        record->attack = (lastmap ? state->attack : -1);
+        record->attack_delay = (lastmap ? state->attack_delay : 0);
+        record->attack_cnt = (lastmap ? state->attack_cnt : 0);
+        if (vertices) memcpy(vertices + vertex_start, area->vertices, sizeof(SDL_Point) * area->vertex_cnt);
+        vertex_start += area->vertex_cnt;
+    }
+    if (lastmap) {
+        // Players and potions
+        MapFilePlayer *player_records = (MapFilePlayer*)(data + sections[2].offset);
+        for (int i = 0; i < map->player_cnt; i++) {
+            PlayerState *state = &map->player_states[i];
+            MapFilePlayer *record = &player_records[i];
+            record->id = map->players[i]->id;
+            record->troop_rate = state->troop_rate;
+            record->attack_delay = state->attack_delay;
+            record->has_potion = (state->potion.type != POTION_NONE);
+            ELE_WritePotionRecord(&record->potion, &state->potion);
+        }
+        MapFilePotion *potion_records = (MapFilePotion*)(data + sections[3].offset);
+        for (int i = 0; i < map->potion_cnt; i++) {
+            ELE_WritePotionRecord(&potion_records[i], &map->potions[i]);
+        }
+        // Troops
+        TroopStore *troops = map->troops;
+        MapFileTroop *troop_records = (MapFileTroop*)(data + sections[4].offset);
+        for (int i = 0; i < troops->cnt; i++) {
+            MapFileTroop *record = &troop_records[i];
+            record->x = troops->x[i];
+            record->y = troops->y[i];
+            record->id = troops->id[i];
+            record->owner = map->players[troops->owner[i]]->id;
+            record->src = troops->src[i];
+            record->dst = troops->dst[i];
+        }
+        MapFileMatchState *state = (MapFileMatchState*)(data + sections[5].offset);
+        memcpy(state->rng, map->rng, sizeof(state->rng));
+        state->next_troop_id = map->next_troop_id;
+    }
+    header->checksum = ELE_GetMapChecksum(data + sizeof(MapFileHeader), offset - sizeof(MapFileHeader));
+    return data;
+}
+
+/* Section of type with records of record_size, NULL if missing or malformed */
+const MapFileSection* ELE_FindMapSection(
+    const Uint8 *data, Sint64 size, Uint32 type, Sint64 record_size
+) {
+    const MapFileHeader *header = (const MapFileHeader*)data;
+    const MapFileSection *sections = (const MapFileSection*)(data + sizeof(MapFileHeader));
+    for (Uint32 i = 0; i < header->section_cnt; i++) {
+        const MapFileSection *section = &sections[i];
+        if (section->type != type) continue;
+        if (section->offset % MAP_FILE_ALIGN != 0 || section->offset > (Uint64)size ||
+            section->size > (Uint64)size - section->offset ||
+            section->size != (Uint64)record_size * section->cnt) {
+            LogInfo("Map section %u is malformed", type);
+            return NULL;
+        }
+        return section;
+    }
+    return NULL;
+}
+
+/* With borrow raw vertices are pointed into, not copied, so data must outlive the map */
+Map* ELE_ParseMap(
+    const Uint8 *data, Sint64 size, int lastmap, int borrow,
+    PlayerRegistry *registry
+) {
+    if (size < (Sint64)sizeof(MAP_FILE_MAGIC) || memcmp(data, MAP_FILE_MAGIC, sizeof(MAP_FILE_MAGIC))) {
+        return ELE_ParseLegacyMap(data, size, lastmap, registry);
+    }
+    const MapFileHeader *header = (const MapFileHeader*)data;
+    if (size < (Sint64)sizeof(MapFileHeader) || header->version > MAP_FILE_VERSION ||
+        header->section_cnt > (size - sizeof(MapFileHeader)) / sizeof(MapFileSection)) {
+        LogInfo("Unsupported map file version or truncated header");
+        return NULL;
+    }
+    if (ELE_GetMapChecksum(data + sizeof(MapFileHeader), size - sizeof(MapFileHeader)) != header->checksum) {
+        LogInfo("Map file checksum mismatch");
+        return NULL;
+    }
+    const MapFileSection *area_section = ELE_FindMapSection(data, size, MAP_SECTION_AREAS, sizeof(MapFileArea));
+    const MapFileSection *vertex_section = ELE_FindMapSection(data, size, MAP_SECTION_VERTICES, sizeof(SDL_Point));
+    const MapFileSection *packed_section = ELE_FindMapSection(data, size, MAP_SECTION_PACKED_VERTICES, 1);
+    if (area_section == NULL || (vertex_section == NULL && packed_section == NULL)) {
+        LogInfo("Map file has no areas");
+        return NULL;
+    }
+    const MapFileArea *area_records = (const MapFileArea*)(data + area_section->offset);
+    const SDL_Point *vertices = NULL;
+    const Uint8 *packed = NULL, *packed_end = NULL;
+    if (vertex_section != NULL) {
+        vertices = (const SDL_Point*)(data + vertex_section->offset);
+    } else {
+        packed = data + packed_section->offset;
+        packed_end = packed + packed_section->size;
+    }
+    Map *map = ELE_CreateMap(header->id, NULL, 0, NULL, 0);
+    map->areas = malloc(sizeof(Area*) * SDL_max(area_section->cnt, 1));
+    Sint64 vertex_cnt = 0;
+    for (Uint32 i = 0; i < area_section->cnt; i++) {
+        const MapFileArea *record = &area_records[i];
+        if (record->vertex_cnt < 0 || record->vertex_start < 0 ||
+            (vertices && (Uint64)record->vertex_start + record->vertex_cnt > vertex_section->cnt) ||
+            (packed && record->vertex_start != vertex_cnt)) {
+            LogInfo("Area %d has vertices out of range", record->id);
+            ELE_DestroyMap(map);
+            return NULL;
+        }
+        vertex_cnt += record->vertex_cnt;
+        int copy = vertices && !borrow;
+        Area *area = ELE_CreateArea(record->id, record->capacity, record->center, record->radius,
+            (copy ? (SDL_Point*)(vertices + record->vertex_start) : NULL),
+            (copy ? record->vertex_cnt : 0));
+        if (area == NULL) {
+            ELE_DestroyMap(map);
+            return NULL;
+        }
+        map->areas[map->area_cnt++] = area;
+        if (vertices && borrow) {
+            area->vertices = (SDL_Point*)(vertices + record->vertex_start);
+            area->vertex_cnt = record->vertex_cnt;
+            area->shared_vertices = 1;
+        }
+        if (packed && record->vertex_cnt) {
+            area->vertices = malloc(sizeof(SDL_Point) * record->vertex_cnt);
+            area->vertex_cnt = record->vertex_cnt;
+            if (ELE_UnpackVertices(&packed, packed_end, record->center,
+                area->vertices, record->vertex_cnt) != 0) {
+                LogInfo("Area %d has truncated vertices", record->id);
+                ELE_DestroyMap(map);
+                return NULL;
+            }
+        }
+    }
+    int match = lastmap && (header->flags & MAP_FILE_MATCH);
+    const MapFileSection *player_section = NULL;
+    if (match) {
+        player_section = ELE_FindMapSection(data, size, MAP_SECTION_PLAYERS, sizeof(MapFilePlayer));
+        if (player_section == NULL) {
+            LogInfo("Map file has no match state");
+            ELE_DestroyMap(map);
+            return NULL;
+        }
+        const MapFilePlayer *player_records = (const MapFilePlayer*)(data + player_section->offset);
+        map->players = malloc(sizeof(Player*) * SDL_max(player_section->cnt, 1));
+        for (Uint32 i = 0; i < player_section->cnt; i++) {
+            Player *player = (registry ? ELE_FindPlayerById(registry, player_records[i].id) : NULL);
+            if (player == NULL) {
+                LogInfo("Player %d of the match is unknown", player_records[i].id);
+                ELE_DestroyMap(map);
+                return NULL;
+            }
+            map->players[map->player_cnt++] = player;
+        }
+    }
+    ELE_ResetMapState(map);
+    for (int i = 0; i < map->area_cnt; i++) {
+        map->area_states[i].troop_cnt = area_records[i].troop_cnt;
+        map->area_states[i].troop_rate = area_records[i].troop_rate;
+        map->area_states[i].troop_inc_delay = area_records[i].troop_inc_delay;
+    }
+    if (!match) return map;
+    // Match state
+    const MapFileSection *potion_section = ELE_FindMapSection(data, size, MAP_SECTION_POTIONS, sizeof(MapFilePotion));
+    const MapFileSection *troop_section = ELE_FindMapSection(data, size, MAP_SECTION_FIXED_TROOPS, sizeof(MapFileTroop));
+    const MapFileSection *double_troop_section = NULL;
+    if (troop_section == NULL) {
+        double_troop_section = ELE_FindMapSection(data, size, MAP_SECTION_TROOPS, sizeof(MapFileDoubleTroop));
+    }
+    if (potion_section == NULL || (troop_section == NULL && double_troop_section == NULL)) {
+        LogInfo("Map file has no match state");
+        ELE_DestroyMap(map);
+        return NULL;
+    }
+    map->frame = header->frame;
+    const MapFilePlayer *player_records = (const MapFilePlayer*)(data + player_section->offset);
+    for (int i = 0; i < map->player_cnt; i++) {
+        const MapFilePlayer *record = &player_records[i];
+        PlayerState *state = &map->player_states[i];
+        state->troop_rate = record->troop_rate;
+        state->attack_delay = record->attack_delay;
+        state->potion = (record->has_potion ? ELE_ReadPotionRecord(&record->potion) : ELE_MakeEmptyPotion());
+    }
+    const MapFilePotion *potion_records = (const MapFilePotion*)(data + potion_section->offset);
+    for (Uint32 i = 0; i < potion_section->cnt; i++) {
+        const MapFilePotion *record = &potion_records[i];
+        ELE_AddPotionToMap(map, (record->frames_onmap > 0 ? ELE_ReadPotionRecord(record) : ELE_MakeEmptyPotion()));
+    }
+    for (int i = 0; i < map->area_cnt; i++) {
+        const MapFileArea *record = &area_records[i];
+        int conqueror = ELE_GetPlayerIndexById(map, record->conqueror);
+        if (conqueror >= 0) ELE_AreaConquer(map, i, conqueror);
+        if (record->attack >= 0 && record->attack < map->area_cnt) {
+            map->area_states[i].attack = record->attack;
+        }
+        map->area_states[i].attack_delay = record->attack_delay;
+        map->area_states[i].attack_cnt = record->attack_cnt;
+    }
+    if (troop_section != NULL) {
+        const MapFileTroop *troop_records = (const MapFileTroop*)(data + troop_section->offset);
+        for (Uint32 i = 0; i < troop_section->cnt; i++) {
+            const MapFileTroop *record = &troop_records[i];
+            ELE_ReadTroopRecord(map, record->id, record->owner, record->x, record->y,
+                record->src, record->dst);
+        }
+    } else {
+        const MapFileDoubleTroop *troop_records = (const MapFileDoubleTroop*)(data + double_troop_section->offset);
+        for (Uint32 i = 0; i < double_troop_section->cnt; i++) {
+            const MapFileDoubleTroop *record = &troop_records[i];
+            ELE_ReadTroopRecord(map, record->id, record->owner, ELE_DoubleToFixed(record->x),
+                ELE_DoubleToFixed(record->y), record->src, record->dst);
+        }
+    }
+    const MapFileSection *state_section = ELE_FindMapSection(data, size, MAP_SECTION_MATCH_STATE,
+        sizeof(MapFileMatchState));
+    if (state_section != NULL && state_section->cnt == 1) {
+        const MapFileMatchState *state = (const MapFileMatchState*)(data + state_section->offset);
+        memcpy(map->rng, state->rng, sizeof(map->rng));
+        map->next_troop_id = SDL_max(map->next_troop_id, state->next_troop_id);
+    } else {
+        /* Older file, the match goes on with streams of its own */
+        for (int i = 0; i < MAP_RNG_CNT; i++) RNG_Seed(&map->rng[i], header->checksum, i);
+    }
+    return map;
+}
+
+/* Version 1, one field after the other with no header */
+Map* ELE_ParseLegacyMap(
+    const Uint8 *data, Sint64 size, int lastmap,
+    PlayerRegistry *registry
+) {
+    SDL_RWops *file = SDL_RWFromConstMem(data, size);
+    int mapid;
+    SDL_RWread(file, &mapid, sizeof(int), 1);
+    Map *map = ELE_CreateMap(mapid, NULL, 0, NULL, 0);
+    /* Player and potion state comes before the areas, kept until there is state to put it in */
+    PlayerState *player_states = NULL;
+    Potion *potions = NULL;
+    int potion_cnt = 0;
+    if (lastmap) {
+        SDL_RWread(file, &map->player_cnt, sizeof(int), 1);
+        map->players = malloc(sizeof(Player*) * map->player_cnt);
+        player_states = malloc(sizeof(PlayerState) * SDL_max(map->player_cnt, 1));
+        for (int i = 0; i < map->player_cnt; i++) {
+            int player_id;
+            SDL_RWread(file, &player_id, sizeof(int), 1);
+            map->players[i] = (registry ? ELE_FindPlayerById(registry, player_id) : NULL);
+            PlayerState *state = &player_states[i];
+            SDL_RWread(file, &state->area_cnt, sizeof(int), 1);
+            SDL_RWread(file, &state->troop_cnt, sizeof(int), 1);
+            SDL_RWread(file, &state->troop_rate, sizeof(int), 1);
+            SDL_RWread(file, &state->attack_delay, sizeof(int), 1);
+            state->potion = ELE_MakeEmptyPotion();
+            int haspt;
+            SDL_RWread(file, &haspt, sizeof(int), 1);
+            if (haspt) {
+                Potion pt;
+                SDL_RWread(file, &pt, sizeof(Potion), 1);
+                state->potion = ELE_MakePotion(
+                    pt.id, pt.type, pt.frames_onmap, pt.frames_applied, pt.center
+                );
+            }
+        }
+        SDL_RWread(file, &potion_cnt, sizeof(int), 1);
+        potions = malloc(sizeof(Potion) * SDL_max(potion_cnt, 1));
+        for (int i = 0; i < potion_cnt; i++) {
+            Potion pt;
+            SDL_RWread(file, &pt, sizeof(Potion), 1);
+            potions[i] = (pt.frames_onmap > 0 ? ELE_MakePotion(
+                pt.id, pt.type, pt.frames_onmap, pt.frames_applied, pt.center
+            ) : ELE_MakeEmptyPotion());
+        }
+    }
+    SDL_RWread(file, &map->area_cnt, sizeof(int), 1);
+    map->areas = malloc(sizeof(Area*) * map->area_cnt);
+    int *conq_ids = malloc(sizeof(int) * SDL_max(map->area_cnt, 1));
+    int *troop_cnts = malloc(sizeof(int) * SDL_max(map->area_cnt, 1));
+    for (int i = 0; i < map->area_cnt; i++) {
+        int area_id;
+        SDL_RWread(file, &area_id, sizeof(int), 1);
+        SDL_RWread(file, &conq_ids[i], sizeof(int), 1);
+        int area_cap, area_trate, area_tincdelay;
+        SDL_RWread(file, &area_cap, sizeof(int), 1);
+        SDL_RWread(file, &troop_cnts[i], sizeof(int), 1);
+        SDL_RWread(file, &area_trate, sizeof(int), 1);
+        SDL_RWread(file, &area_tincdelay, sizeof(int), 1);
+        SDL_Point area_center;
+        SDL_RWread(file, &area_center, sizeof(SDL_Point), 1);
+        int area_radius;
+        SDL_RWread(file, &area_radius, sizeof(int), 1);
+        Area *area = ELE_CreateArea(
+            area_id, ELE_GetAreaCapacityByRadius(area_radius),
+            area_center, area_radius, NULL, 0
+        );
+        int vertex_cnt;
+        SDL_RWread(file, &vertex_cnt, sizeof(int), 1);
+        area->vertex_cnt = vertex_cnt;
+        area->vertices = malloc(sizeof(SDL_Point) * vertex_cnt);
+        for (int i = 0; i < vertex_cnt; i++) {
+            SDL_RWread(file, &area->vertices[i], sizeof(SDL_Point), 1);
+        }
+        map->areas[i] = area;
+    }
+    ELE_ResetMapState(map);
+    for (int i = 0; i < map->area_cnt; i++) {
+        map->area_states[i].troop_cnt = troop_cnts[i];
+    }
+    if (lastmap) {
+        /* Area and troop counts are counted again below */
+        for (int i = 0; i < map->player_cnt; i++) {
+            map->player_states[i] = player_states[i];
+            map->player_states[i].area_cnt = 0;
+            map->player_states[i].troop_cnt = 0;
+        }
+        for (int i = 0; i < potion_cnt; i++) ELE_AddPotionToMap(map, potions[i]);
+        for (int i = 0; i < map->area_cnt; i++) {
+            int conqueror = ELE_GetPlayerIndexById(map, conq_ids[i]);
+            if (conqueror >= 0) ELE_AreaConquer(map, i, conqueror);
+            int att_id;
+            SDL_RWread(file, &att_id, sizeof(int), 1);
+            map->area_states[i].attack = ELE_GetAreaIndexById(map, att_id);
+            SDL_RWread(file, &map->area_states[i].attack_delay, sizeof(int), 1);
+            SDL_RWread(file, &map->area_states[i].attack_cnt, sizeof(int), 1);
+        }
+        int troop_cnt;
+        SDL_RWread(file, &troop_cnt, sizeof(int), 1);
+        for (int i = 0; i < troop_cnt; i++) {
+            int troop_id;
+            SDL_RWread(file, &troop_id, sizeof(int), 1);
+            int player_id;
+            SDL_RWread(file, &player_id, sizeof(int), 1);
+            double x, y;
+            SDL_RWread(file, &x, sizeof(double), 1);
+            SDL_RWread(file, &y, sizeof(double), 1);
+            int src_id, dst_id;
+            SDL_RWread(file, &src_id, sizeof(int), 1);
+            SDL_RWread(file, &dst_id, sizeof(int), 1);
+            ELE_AddTroopToMap(
+                map, troop_id, ELE_GetPlayerIndexById(map, player_id),
+                ELE_DoubleToFixed(x), ELE_DoubleToFixed(y),
+                ELE_GetAreaIndexById(map, src_id), ELE_GetAreaIndexById(map, dst_id)
+            );
+            if (troop_id >= map->next_troop_id) map->next_troop_id = troop_id + 1;
+        }
+        Uint32 checksum = ELE_GetMapChecksum(data, size);
+        for (int i = 0; i < MAP_RNG_CNT; i++) RNG_Seed(&map->rng[i], checksum, i);
+    }
+    free(conq_ids);
+    free(troop_cnts);
+    free(player_states);
+    free(potions);
+    SDL_RWclose(file);
+    return map;
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+#ifndef _MAPFILE_H
+#define _MAPFILE_H
+
+#include <SDL2/SDL.h>
+#include "map.h"
+
+/*
+ * Map file format v2: a header, a table of sections and the sections,
+ * each aligned to MAP_FILE_ALIGN. Integers are stored in native byte
+ * order like the v1 files, which have no header at all and start with
+ * the map id.
+ *
+ * Vertices are stored either raw or packed. Packed, each area starts
+ * from its center and every vertex is a delta from the previous one,
+ * zig-zag encoded. Deltas with both parts in [-7, 7] take one byte,
+ * x in the high nibble and y in the low one. Anything else is the
+ * escape byte MAP_PACKED_ESCAPE followed by two LEB128 varints.
+ */
+
+enum ELE_MapFileConstants {
+    MAP_FILE_VERSION = 2,
+    MAP_FILE_ALIGN = 8,
+    MAP_PACKED_ESCAPE = 0xF0
+};
+
+enum ELE_MapFileFlags {
+    /* Players, potions and troops of a match are stored too */
+    MAP_FILE_MATCH = 1,
+    /* MAP_SECTION_PACKED_VERTICES instead of MAP_SECTION_VERTICES */
+    MAP_FILE_PACKED = 2
+};
+
+enum ELE_MapSections {
+    MAP_SECTION_AREAS,
+    /* Every area's SDL_Points back to back, MapFileArea::vertex_start in */
+    MAP_SECTION_VERTICES,
+    MAP_SECTION_PLAYERS,
+    MAP_SECTION_POTIONS,
+    /* MapFileDoubleTroops, written by older builds only */
+    MAP_SECTION_TROOPS,
+    /* Bytes, with areas in order and vertex_start consecutive */
+    MAP_SECTION_PACKED_VERTICES,
+    /* One MapFileMatchState, missing in files of older builds */
+    MAP_SECTION_MATCH_STATE,
+    /* MapFileTroops, in place of MAP_SECTION_TROOPS */
+    MAP_SECTION_FIXED_TROOPS
+};
+
+struct MapFileHeader {
+    char magic[4];
+    Uint32 version;
+    Uint32 flags;
+    Sint32 id;
+    Sint32 frame;
+    Uint32 section_cnt;
+    /* ELE_GetMapChecksum of everything after the header */
+    Uint32 checksum;
+    Uint32 reserved;
+};
+typedef struct MapFileHeader MapFileHeader;
+
+struct MapFileSection {
+    Uint32 type;
+    Uint32 cnt;
+    Uint64 offset;
+    Uint64 size;
+};
+typedef struct MapFileSection MapFileSection;
+
+/* Areas are referred to by index and players by id, -1 for none */
+struct MapFileArea {
+    Sint32 id;
+    Sint32 conqueror;
+    Sint32 capacity;
+    Sint32 troop_cnt;
+    Sint32 troop_rate;
+    Sint32 troop_inc_delay;
+    SDL_Point center;
+    Sint32 radius;
+    Sint32 vertex_cnt;
+    Sint32 vertex_start;
+    Sint32 attack;
+    Sint32 attack_delay;
+    Sint32 attack_cnt;
+};
+typedef struct MapFileArea MapFileArea;
+
+/* Potions on the map with frames_onmap 0 are empty slots */
+struct MapFilePotion {
+    Sint32 id;
+    Sint32 type;
+    Sint32 frames_onmap;
+    Sint32 frames_applied;
+    SDL_Point center;
+};
+typedef struct MapFilePotion MapFilePotion;
+
+struct MapFilePlayer {
+    Sint32 id;
+    Sint32 troop_rate;
+    Sint32 attack_delay;
+    Sint32 has_potion;
+    MapFilePotion potion;
+};
+typedef struct MapFilePlayer MapFilePlayer;
+
+/* x and y are TroopStore Fixed */
+struct MapFileTroop {
+    Sint32 x, y;
+    Sint32 id;
+    Sint32 owner;
+    Sint32 src;
+    Sint32 dst;
+};
+typedef struct MapFileTroop MapFileTroop;
+
+/* Troops of older builds, converted with ELE_DoubleToFixed on load */
+struct MapFileDoubleTroop {
+    double x, y;
+    Sint32 id;
+    Sint32 owner;
+    Sint32 src;
+    Sint32 dst;
+};
+typedef struct MapFileDoubleTroop MapFileDoubleTroop;
+
+/* What a resumed match needs to play on exactly like the saved one */
+struct MapFileMatchState {
+    RNG rng[MAP_RNG_CNT];
+    Sint32 next_troop_id;
+    Sint32 reserved;
+};
+typedef struct MapFileMatchState MapFileMatchState;
+
+extern const char MAP_FILE_MAGIC[4];
+
+extern Uint64 ELE_HashBytes(Uint64 hash, const void *data, Sint64 size);
+extern Uint32 ELE_GetMapChecksum(const Uint8 *data, Sint64 size);
+extern int ELE_ReplaceFile(const char *filename, const Uint8 *data, Sint64 size);
+extern Uint32 ELE_HashMatchState(Map *map);
+
+extern Sint64 ELE_PackVertices(Map *map, Uint8 *out);
+extern int ELE_UnpackVertices(
+    const Uint8 **data, const Uint8 *end, SDL_Point start,
+    SDL_Point *vertices, int vertex_cnt
+);
+
+extern Uint8* ELE_SerializeMap(Map *map, Uint32 flags, Sint64 *size);
+extern Map* ELE_ParseMap(
+    const Uint8 *data, Sint64 size, int lastmap, int borrow,
+    PlayerRegistry *registry
+);
+extern Map* ELE_ParseLegacyMap(
+    const Uint8 *data, Sint64 size, int lastmap,
+    PlayerRegistry *registry
+);
+
+#endif /* _MAPFILE_H */
\ No newline at end of file
@@ -5,8 +5,7 @@
 #include "../log.h"
 
 enum ELE_PlayerConstants {
-    MAX_NAME_LEN = 15,
-    DEFAULT_TROOP_RATE = 60 /* Frame */
+    MAX_NAME_LEN = 15
 };
 
 Player* ELE_CreatePlayer(
@@ -18,14 +17,8 @@ Player* ELE_CreatePlayer(
     Player *new_player = malloc(sizeof(Player));
     new_player->id = id;
     strcpy(new_player->name, name);
-    new_player->score = 0;
-    new_player->troop_cnt = 0;
-    new_player->troop_rate = DEFAULT_TROOP_RATE;
-    new_player->area_cnt = 0;
     new_player->color = color;
     new_player->score = score;
-    new_player->attack_delay = 0;
-    new_player->applied_potion = NULL;
     return new_player;
 }
 
@@ -33,27 +26,45 @@ void ELE_DestroyPlayer(Player *player) {
     free(player);
 }
 
-int ELE_CmpPlayersByScore(const void *first, const void *second) {
-    Player *f = *(Player**)first;
-    Player *s = *(Player**)second;
-    if (f->score < s->score) return 1;
-    if (f->score > s->score) return -1;
-    return 0;
+/* Of a player or area id, for the tables indexed by them */
+Uint32 ELE_HashId(int id) {
+    Uint32 x = (Uint32)id;
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
 }
 
-void ELE_SortPlayersByScore(Player **players, int player_cnt) {
-    qsort(players, player_cnt, sizeof(Player*), ELE_CmpPlayersByScore);
+Player* ELE_GetPlayerById(Player **players, int player_cnt, int id) {
+    for (int i = 0; i < player_cnt; i++) {
+        if (players[i] != NULL && players[i]->id == id) {
+            return players[i];
+        }
+    }
+    return NULL;
 }
 
-int ELE_SavePlayers(Player *players, int player_cnt) {
+/* Players of the legacy file up to the first unnamed one into a new array, -1 if there is no file */
+int ELE_LoadPlayers(Player ***players) {
     const char *players_filename = "bin/data/players.bin";
-    SDL_RWops *players_file = SDL_RWFromFile(players_filename, "w+b");
-    if (players_file != NULL) {
-        SDL_RWwrite(players_file, players, sizeof(Player), player_cnt);
-        SDL_RWclose(players_file);
-    } else {
-        LogError("Unable to r/w players: %s");
-        return -1;
+    *players = NULL;
+    SDL_RWops *players_file = SDL_RWFromFile(players_filename, "rb");
+    if (players_file == NULL) return -1;
+    int record_cnt = SDL_max(SDL_RWsize(players_file), 0) / sizeof(PlayerRecord);
+    PlayerRecord *records = calloc(SDL_max(record_cnt, 1), sizeof(PlayerRecord));
+    SDL_RWread(players_file, records, sizeof(PlayerRecord), record_cnt);
+    SDL_RWclose(players_file);
+    *players = malloc(sizeof(Player*) * SDL_max(record_cnt, 1));
+    int player_cnt = 0;
+    for (; player_cnt < record_cnt; player_cnt++) {
+        PlayerRecord *record = &records[player_cnt];
+        if (record->name[0] == 0) break;
+        record->name[sizeof(record->name) - 1] = 0;
+        (*players)[player_cnt] = ELE_CreatePlayer(record->id, record->name, record->color, record->score);
+        if ((*players)[player_cnt] == NULL) break;
     }
-    return 0;
+    free(records);
+    return player_cnt;
 }
\ No newline at end of file
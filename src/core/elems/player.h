@@ -4,28 +4,49 @@
 #include <SDL2/SDL.h>
 #include "potion.h"
 
+/* Who plays, kept across matches */
 struct Player {
     int id;
     char name[32];
     int score;
+    SDL_Color color;
+};
+typedef struct Player Player;
 
+/* Match state of the player, in Map::player_states */
+struct PlayerState {
     int area_cnt;
     int troop_cnt;
     int troop_rate;
-    SDL_Color color;
-
     int attack_delay;
-
-    Potion *applied_potion;
+    /* Type POTION_NONE for none */
+    Potion potion;
 };
-typedef struct Player Player;
+typedef struct PlayerState PlayerState;
+
+/*
+ * A player in bin/data/players.bin, laid out as Player was when the
+ * file was a dump of it. The match state it had is left unused. Only
+ * read now, to move the players into the database, see playerdb.h.
+ */
+struct PlayerRecord {
+    int id;
+    char name[32];
+    int score;
+    int unused_state[3];
+    SDL_Color color;
+    int unused_delay;
+    void *unused_potion;
+};
+typedef struct PlayerRecord PlayerRecord;
 
 extern Player* ELE_CreatePlayer(
     int id, const char *name, SDL_Color color, int score);
 extern void ELE_DestroyPlayer(Player *player);
 
-extern void ELE_SortPlayersByScore(Player **players, int player_cnt);
+extern Uint32 ELE_HashId(int id);
+extern Player* ELE_GetPlayerById(Player **players, int player_cnt, int id);
 
-extern int ELE_SavePlayers(Player *players, int player_cnt);
+extern int ELE_LoadPlayers(Player ***players);
 
 #endif /* _PLAYER_H */
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include <SDL2/SDL.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "playerdb.h"
+#include "player.h"
+#include "registry.h"
+#include "map.h"
+#include "mapfile.h"
+#include "../log.h"
+
+const char PLAYER_DB_MAGIC[4] = {'S', 'I', 'O', 'P'};
+
+Uint32 ELE_GetPlayerRecordChecksum(const PlayerDBRecord *record) {
+    return ELE_GetMapChecksum((const Uint8*)record, offsetof(PlayerDBRecord, checksum));
+}
+
+void ELE_FillPlayerRecord(PlayerDBRecord *record, Player *player) {
+    memset(record, 0, sizeof(PlayerDBRecord));
+    record->id = player->id;
+    record->score = player->score;
+    record->color[0] = player->color.r;
+    record->color[1] = player->color.g;
+    record->color[2] = player->color.b;
+    record->color[3] = player->color.a;
+    SDL_strlcpy(record->name, player->name, sizeof(record->name));
+    record->checksum = ELE_GetPlayerRecordChecksum(record);
+}
+
+/* A player added or brought up to date by record, left to ELE_RankAllPlayers if it was there */
+void ELE_ApplyPlayerRecord(PlayerRegistry *registry, PlayerDBRecord *record) {
+    SDL_Color color = {record->color[0], record->color[1], record->color[2], record->color[3]};
+    Player *player = ELE_FindPlayerById(registry, record->id);
+    if (player != NULL) {
+        player->score = record->score;
+        player->color = color;
+        return;
+    }
+    record->name[sizeof(record->name) - 1] = 0;
+    player = ELE_CreatePlayer(record->id, record->name, color, record->score);
+    if (ELE_AddPlayer(registry, player) != 0) ELE_DestroyPlayer(player);
+}
+
+/*
+ * Records of filename into registry in one read, returns how many were
+ * whole and sets record_cnt to all of them. -1 if the file is missing
+ * or isn't a players database of this version.
+ */
+int ELE_LoadPlayerRecords(const char *filename, PlayerRegistry *registry, int *record_cnt) {
+    SDL_RWops *file = SDL_RWFromFile(filename, "rb");
+    if (file == NULL) return -1;
+    Sint64 size = SDL_RWsize(file);
+    Uint8 *data = (size >= (Sint64)sizeof(PlayerDBHeader) ? malloc(size) : NULL);
+    if (data == NULL || SDL_RWread(file, data, size, 1) != 1) {
+        LogInfo("Unable to read players database %s", filename);
+        free(data);
+        SDL_RWclose(file);
+        return -1;
+    }
+    SDL_RWclose(file);
+    const PlayerDBHeader *header = (const PlayerDBHeader*)data;
+    if (memcmp(header->magic, PLAYER_DB_MAGIC, sizeof(PLAYER_DB_MAGIC)) ||
+        header->version != PLAYER_DB_VERSION || header->record_size != sizeof(PlayerDBRecord)) {
+        LogInfo("Players database %s is outdated or corrupt", filename);
+        free(data);
+        return -1;
+    }
+    *record_cnt = (size - sizeof(PlayerDBHeader)) / sizeof(PlayerDBRecord);
+    PlayerDBRecord *records = (PlayerDBRecord*)(data + sizeof(PlayerDBHeader));
+    int valid_cnt = 0;
+    for (; valid_cnt < *record_cnt; valid_cnt++) {
+        PlayerDBRecord *record = &records[valid_cnt];
+        if (record->checksum != ELE_GetPlayerRecordChecksum(record)) break;
+        ELE_ApplyPlayerRecord(registry, record);
+    }
+    ELE_RankAllPlayers(registry);
+    if (valid_cnt < *record_cnt || size != (Sint64)(sizeof(PlayerDBHeader) + sizeof(PlayerDBRecord) * *record_cnt)) {
+        LogInfo("Players database %s has a torn end, %d records kept", filename, valid_cnt);
+        *record_cnt = -1;
+    }
+    free(data);
+    return valid_cnt;
+}
+
+/*
+ * Players of filename into registry, made from LEGACY_PLAYERS_FILE if
+ * it is missing. NULL if the file can't be written, registry still has
+ * the players read.
+ */
+PlayerDB* ELE_OpenPlayerDB(const char *filename, PlayerRegistry *registry) {
+    PlayerDB *db = malloc(sizeof(PlayerDB));
+    db->file = NULL;
+    db->filename = SDL_strdup(filename);
+    db->record_cnt = 0;
+    int record_cnt = 0;
+    int valid_cnt = ELE_LoadPlayerRecords(filename, registry, &record_cnt);
+    if (valid_cnt < 0) {
+        Player **players;
+        int player_cnt = ELE_LoadPlayers(&players);
+        for (int i = 0; i < player_cnt; i++) {
+            if (ELE_AddPlayer(registry, players[i]) != 0) ELE_DestroyPlayer(players[i]);
+        }
+        free(players);
+        if (player_cnt >= 0) LogInfo("Moving %d players from %s to %s", player_cnt, LEGACY_PLAYERS_FILE, filename);
+    }
+    if (valid_cnt < 0 || record_cnt < 0 || record_cnt > 2 * registry->player_cnt + PLAYER_DB_SLACK) {
+        if (ELE_CompactPlayerDB(db, registry) == 0) return db;
+    } else {
+        db->file = fopen(filename, "ab");
+        db->record_cnt = record_cnt;
+        if (db->file != NULL) return db;
+    }
+    LogInfo("Unable to open players database %s, players won't be saved", filename);
+    ELE_ClosePlayerDB(db, registry);
+    return NULL;
+}
+
+/* Compacted first if the records have run past the players */
+void ELE_ClosePlayerDB(PlayerDB *db, PlayerRegistry *registry) {
+    if (db == NULL) return;
+    if (db->file != NULL && db->record_cnt > 2 * registry->player_cnt + PLAYER_DB_SLACK) {
+        ELE_CompactPlayerDB(db, registry);
+    }
+    if (db->file != NULL) fclose(db->file);
+    SDL_free(db->filename);
+    free(db);
+}
+
+/* After player was added or its score changed, one record */
+int ELE_AppendPlayer(PlayerDB *db, Player *player) {
+    if (db == NULL || db->file == NULL) return -1;
+    PlayerDBRecord record;
+    ELE_FillPlayerRecord(&record, player);
+    if (fwrite(&record, sizeof(record), 1, db->file) != 1 || fflush(db->file) != 0) {
+        /* Part of the record may be in, later ones would be read misaligned */
+        LogInfo("Unable to save player %s, players won't be saved until a restart", player->name);
+        fclose(db->file);
+        db->file = NULL;
+        return -1;
+    }
+    db->record_cnt++;
+    return 0;
+}
+
+/*
+ * The file rewritten with a record for each player of registry,
+ * replacing it at once. If that fails, records are still appended to a
+ * file that was open, which ends on a whole record, but not to one
+ * with a torn tail or no header.
+ */
+int ELE_CompactPlayerDB(PlayerDB *db, PlayerRegistry *registry) {
+    int was_open = (db->file != NULL);
+    if (was_open) fclose(db->file);
+    db->file = NULL;
+    Sint64 size = sizeof(PlayerDBHeader) + sizeof(PlayerDBRecord) * (Sint64)registry->player_cnt;
+    Uint8 *data = malloc(size);
+    PlayerDBHeader *header = (PlayerDBHeader*)data;
+    memset(header, 0, sizeof(PlayerDBHeader));
+    memcpy(header->magic, PLAYER_DB_MAGIC, sizeof(PLAYER_DB_MAGIC));
+    header->version = PLAYER_DB_VERSION;
+    header->record_size = sizeof(PlayerDBRecord);
+    PlayerDBRecord *records = (PlayerDBRecord*)(data + sizeof(PlayerDBHeader));
+    for (int i = 0; i < registry->player_cnt; i++) ELE_FillPlayerRecord(&records[i], registry->players[i]);
+    int result = ELE_ReplaceFile(db->filename, data, size);
+    free(data);
+    if (result != 0 && !was_open) return -1;
+    db->file = fopen(db->filename, "ab");
+    if (result == 0) db->record_cnt = registry->player_cnt;
+    return (db->file != NULL ? result : -1);
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef _PLAYERDB_H
+#define _PLAYERDB_H
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include "player.h"
+#include "registry.h"
+
+/*
+ * Players on disk: a header, then fixed size records each holding a
+ * whole player. A changed player is appended again and the last record
+ * of an id wins, so a match result costs a record per player instead of
+ * rewriting every one. Loading reads the file in one go and applies the
+ * records in order; ones from a torn write at the end are dropped. The
+ * file is rewritten with one record per player when the records run
+ * well past the players, or a torn tail has to go.
+ *
+ * A missing file is made from LEGACY_PLAYERS_FILE, which is left as is.
+ * Integers are in native byte order like the map files.
+ */
+
+#define PLAYER_DB_FILE "bin/data/players.db"
+#define LEGACY_PLAYERS_FILE "bin/data/players.bin"
+
+enum ELE_PlayerDBConstants {
+    PLAYER_DB_VERSION = 1,
+    PLAYER_DB_NAME_LEN = 16,
+    /* Records past twice the players before the file is rewritten */
+    PLAYER_DB_SLACK = 1024
+};
+
+struct PlayerDBHeader {
+    char magic[4];
+    Uint32 version;
+    Uint32 record_size;
+    Uint32 reserved;
+};
+typedef struct PlayerDBHeader PlayerDBHeader;
+
+struct PlayerDBRecord {
+    Sint32 id;
+    Sint32 score;
+    Uint8 color[4];
+    char name[PLAYER_DB_NAME_LEN];
+    /* ELE_GetMapChecksum of the fields above */
+    Uint32 checksum;
+};
+typedef struct PlayerDBRecord PlayerDBRecord;
+
+struct PlayerDB {
+    FILE *file;
+    char *filename;
+    /* In the file, superseded ones included */
+    int record_cnt;
+};
+typedef struct PlayerDB PlayerDB;
+
+extern PlayerDB* ELE_OpenPlayerDB(const char *filename, PlayerRegistry *registry);
+extern void ELE_ClosePlayerDB(PlayerDB *db, PlayerRegistry *registry);
+
+extern int ELE_AppendPlayer(PlayerDB *db, Player *player);
+extern int ELE_CompactPlayerDB(PlayerDB *db, PlayerRegistry *registry);
+
+#endif /* _PLAYERDB_H */
\ No newline at end of file
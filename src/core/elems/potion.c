@@ -1,20 +1,19 @@
 #include <SDL2/SDL.h>
-#include <stdlib.h>
 #include "potion.h"
 
-Potion* ELE_CreatePotion(
+Potion ELE_MakePotion(
     int id, int type, int frames_onmap, int frames_applied,
     SDL_Point center
 ) {
-    Potion *new_potion = malloc(sizeof(Potion));
-    new_potion->id = id;
-    new_potion->type = type;
-    new_potion->frames_onmap = frames_onmap;
-    new_potion->frames_applied = frames_applied;
-    new_potion->center = center;
-    return new_potion;
+    Potion potion;
+    potion.id = id;
+    potion.type = type;
+    potion.frames_onmap = frames_onmap;
+    potion.frames_applied = frames_applied;
+    potion.center = center;
+    return potion;
 }
 
-void ELE_DestroyPotion(Potion *potion) {
-    free(potion);
+Potion ELE_MakeEmptyPotion() {
+    return ELE_MakePotion(-1, POTION_NONE, 0, 0, (SDL_Point){0, 0});
 }
\ No newline at end of file
@@ -4,12 +4,15 @@
 #include <SDL2/SDL.h>
 
 enum POTION_TYPES {
+    /* Empty slot on the map, or no potion applied */
+    POTION_NONE = -1,
     TROOP_SPEED_X2,
     TROOP_FREEZE_OTHERS,
     AREA_BEYOND_CAPACITY,
     AREA_SHIELD
 };
 
+/* Potions are plain values, copied along with the match state they are in */
 struct Potion {
     int id;
     int type;
@@ -20,10 +23,10 @@ struct Potion {
 };
 typedef struct Potion Potion;
 
-extern Potion* ELE_CreatePotion(
+extern Potion ELE_MakePotion(
     int id, int type, int frames_onmap, int frames_applied,
     SDL_Point center
 );
-extern void ELE_DestroyPotion(Potion *potion);
+extern Potion ELE_MakeEmptyPotion(void);
 
 #endif /* _POTION_H */
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include "registry.h"
+#include "player.h"
+#include "../log.h"
+
+PlayerRegistry* ELE_CreatePlayerRegistry() {
+    PlayerRegistry *new_registry = malloc(sizeof(PlayerRegistry));
+    new_registry->player_size = 16;
+    new_registry->players = malloc(sizeof(Player*) * new_registry->player_size);
+    new_registry->nodes = malloc(sizeof(PlayerRankNode) * new_registry->player_size);
+    new_registry->player_cnt = 0;
+    new_registry->index_size = 2 * new_registry->player_size;
+    new_registry->id_index = calloc(new_registry->index_size, sizeof(int));
+    new_registry->name_index = calloc(new_registry->index_size, sizeof(int));
+    new_registry->root = -1;
+    new_registry->next_id = 0;
+    return new_registry;
+}
+
+/* With its players */
+void ELE_DestroyPlayerRegistry(PlayerRegistry *registry) {
+    if (registry == NULL) return;
+    for (int i = 0; i < registry->player_cnt; i++) ELE_DestroyPlayer(registry->players[i]);
+    free(registry->players);
+    free(registry->nodes);
+    free(registry->id_index);
+    free(registry->name_index);
+    free(registry);
+}
+
+/* FNV-1a */
+Uint32 ELE_HashName(const char *name) {
+    Uint32 hash = 2166136261u;
+    for (; *name; name++) {
+        hash ^= (Uint8)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Bucket of id, or the empty one it would go in */
+int* ELE_FindIdBucket(PlayerRegistry *registry, int id) {
+    int mask = registry->index_size - 1;
+    for (int i = ELE_HashId(id) & mask; ; i = (i + 1) & mask) {
+        int *bucket = &registry->id_index[i];
+        if (*bucket == 0 || registry->players[*bucket - 1]->id == id) return bucket;
+    }
+}
+
+int* ELE_FindNameBucket(PlayerRegistry *registry, const char *name) {
+    int mask = registry->index_size - 1;
+    for (int i = ELE_HashName(name) & mask; ; i = (i + 1) & mask) {
+        int *bucket = &registry->name_index[i];
+        if (*bucket == 0 || !strcmp(registry->players[*bucket - 1]->name, name)) return bucket;
+    }
+}
+
+/* Kept at most half full */
+void ELE_RebuildIndexes(PlayerRegistry *registry, int index_size) {
+    free(registry->id_index);
+    free(registry->name_index);
+    registry->index_size = index_size;
+    registry->id_index = calloc(index_size, sizeof(int));
+    registry->name_index = calloc(index_size, sizeof(int));
+    for (int i = 0; i < registry->player_cnt; i++) {
+        *ELE_FindIdBucket(registry, registry->players[i]->id) = i + 1;
+        *ELE_FindNameBucket(registry, registry->players[i]->name) = i + 1;
+    }
+}
+
+// Ranking
+
+/* Whether (score_a, id_a) ranks above (score_b, id_b) */
+int ELE_RanksBefore(int score_a, int id_a, int score_b, int id_b) {
+    if (score_a != score_b) return score_a > score_b;
+    return id_a < id_b;
+}
+
+int ELE_NodeRanksBefore(PlayerRegistry *registry, int a, int b) {
+    return ELE_RanksBefore(registry->nodes[a].score, registry->nodes[a].id,
+        registry->nodes[b].score, registry->nodes[b].id);
+}
+
+int ELE_GetRankSize(PlayerRegistry *registry, int node) {
+    return (node < 0 ? 0 : registry->nodes[node].size);
+}
+
+void ELE_UpdateRankSize(PlayerRegistry *registry, int node) {
+    PlayerRankNode *n = &registry->nodes[node];
+    n->size = 1 + ELE_GetRankSize(registry, n->left) + ELE_GetRankSize(registry, n->right);
+}
+
+/* Nodes of tree ranking before node into left, the rest into right */
+void ELE_SplitRanks(PlayerRegistry *registry, int tree, int node, int *left, int *right) {
+    if (tree < 0) {
+        *left = *right = -1;
+        return;
+    }
+    PlayerRankNode *t = &registry->nodes[tree];
+    if (ELE_NodeRanksBefore(registry, tree, node)) {
+        ELE_SplitRanks(registry, t->right, node, &t->right, right);
+        *left = tree;
+    } else {
+        ELE_SplitRanks(registry, t->left, node, left, &t->left);
+        *right = tree;
+    }
+    ELE_UpdateRankSize(registry, tree);
+}
+
+/* Every node of left ranks before those of right */
+int ELE_MergeRanks(PlayerRegistry *registry, int left, int right) {
+    if (left < 0) return right;
+    if (right < 0) return left;
+    if (registry->nodes[left].priority > registry->nodes[right].priority) {
+        registry->nodes[left].right = ELE_MergeRanks(registry, registry->nodes[left].right, right);
+        ELE_UpdateRankSize(registry, left);
+        return left;
+    }
+    registry->nodes[right].left = ELE_MergeRanks(registry, left, registry->nodes[right].left);
+    ELE_UpdateRankSize(registry, right);
+    return right;
+}
+
+void ELE_InsertRank(PlayerRegistry *registry, int node) {
+    PlayerRankNode *n = &registry->nodes[node];
+    n->left = n->right = -1;
+    n->size = 1;
+    n->score = registry->players[node]->score;
+    n->id = registry->players[node]->id;
+    int left, right;
+    ELE_SplitRanks(registry, registry->root, node, &left, &right);
+    registry->root = ELE_MergeRanks(registry, ELE_MergeRanks(registry, left, node), right);
+}
+
+/* Tree without node, by the score node is ranked with */
+int ELE_EraseRank(PlayerRegistry *registry, int tree, int node) {
+    PlayerRankNode *t = &registry->nodes[tree];
+    if (tree == node) return ELE_MergeRanks(registry, t->left, t->right);
+    if (ELE_NodeRanksBefore(registry, node, tree)) t->left = ELE_EraseRank(registry, t->left, node);
+    else t->right = ELE_EraseRank(registry, t->right, node);
+    ELE_UpdateRankSize(registry, tree);
+    return tree;
+}
+
+/* Slot of player, -1 if it is not this registry's */
+int ELE_GetPlayerSlot(PlayerRegistry *registry, Player *player) {
+    if (player == NULL) return -1;
+    int slot = *ELE_FindIdBucket(registry, player->id) - 1;
+    if (slot < 0 || registry->players[slot] != player) return -1;
+    return slot;
+}
+
+// Players
+
+/* Takes player over, -1 if its id or name is taken */
+int ELE_AddPlayer(PlayerRegistry *registry, Player *player) {
+    if (player == NULL) return -1;
+    if (*ELE_FindIdBucket(registry, player->id) || *ELE_FindNameBucket(registry, player->name)) {
+        LogInfo("Player %d %s is already registered", player->id, player->name);
+        return -1;
+    }
+    if (registry->player_cnt == registry->player_size) {
+        registry->player_size *= 2;
+        registry->players = realloc(registry->players, sizeof(Player*) * registry->player_size);
+        registry->nodes = realloc(registry->nodes, sizeof(PlayerRankNode) * registry->player_size);
+    }
+    int slot = registry->player_cnt++;
+    registry->players[slot] = player;
+    registry->nodes[slot].priority = ELE_HashId(slot ^ 0x5bd1e995);
+    if (2 * registry->player_cnt > registry->index_size) {
+        ELE_RebuildIndexes(registry, 2 * registry->index_size);
+    } else {
+        *ELE_FindIdBucket(registry, player->id) = slot + 1;
+        *ELE_FindNameBucket(registry, player->name) = slot + 1;
+    }
+    ELE_InsertRank(registry, slot);
+    registry->next_id = SDL_max(registry->next_id, player->id + 1);
+    return 0;
+}
+
+Player* ELE_FindPlayerById(PlayerRegistry *registry, int id) {
+    int slot = *ELE_FindIdBucket(registry, id) - 1;
+    return (slot < 0 ? NULL : registry->players[slot]);
+}
+
+Player* ELE_FindPlayerByName(PlayerRegistry *registry, const char *name) {
+    int slot = *ELE_FindNameBucket(registry, name) - 1;
+    return (slot < 0 ? NULL : registry->players[slot]);
+}
+
+/* Above every id registered */
+int ELE_GetNextPlayerId(PlayerRegistry *registry) {
+    return registry->next_id;
+}
+
+/* After the score of player changed */
+void ELE_RankPlayer(PlayerRegistry *registry, Player *player) {
+    int slot = ELE_GetPlayerSlot(registry, player);
+    if (slot < 0 || registry->nodes[slot].score == player->score) return;
+    registry->root = ELE_EraseRank(registry, registry->root, slot);
+    ELE_InsertRank(registry, slot);
+}
+
+struct PlayerRankKey {
+    int score, id, slot;
+};
+typedef struct PlayerRankKey PlayerRankKey;
+
+int ELE_CmpRankKeys(const void *first, const void *second) {
+    const PlayerRankKey *f = first, *s = second;
+    return ELE_RanksBefore(s->score, s->id, f->score, f->id) - ELE_RanksBefore(f->score, f->id, s->score, s->id);
+}
+
+int ELE_SumRankSizes(PlayerRegistry *registry, int tree) {
+    if (tree < 0) return 0;
+    PlayerRankNode *t = &registry->nodes[tree];
+    t->size = 1 + ELE_SumRankSizes(registry, t->left) + ELE_SumRankSizes(registry, t->right);
+    return t->size;
+}
+
+/*
+ * Every player ranked again at once, by one sort and building the treap
+ * from the sorted players on a stack. For when many scores changed, as
+ * while loading.
+ */
+void ELE_RankAllPlayers(PlayerRegistry *registry) {
+    int player_cnt = registry->player_cnt;
+    PlayerRankKey *keys = malloc(sizeof(PlayerRankKey) * SDL_max(player_cnt, 1));
+    for (int i = 0; i < player_cnt; i++) {
+        keys[i] = (PlayerRankKey){registry->players[i]->score, registry->players[i]->id, i};
+    }
+    qsort(keys, player_cnt, sizeof(PlayerRankKey), ELE_CmpRankKeys);
+    /* Right spine of the treap built so far */
+    int *spine = malloc(sizeof(int) * SDL_max(player_cnt, 1));
+    int spine_cnt = 0;
+    for (int i = 0; i < player_cnt; i++) {
+        int slot = keys[i].slot;
+        PlayerRankNode *n = &registry->nodes[slot];
+        n->score = keys[i].score;
+        n->id = keys[i].id;
+        n->left = n->right = -1;
+        while (spine_cnt > 0 && registry->nodes[spine[spine_cnt - 1]].priority < n->priority) {
+            n->left = spine[--spine_cnt];
+        }
+        if (spine_cnt > 0) registry->nodes[spine[spine_cnt - 1]].right = slot;
+        spine[spine_cnt++] = slot;
+    }
+    registry->root = (spine_cnt > 0 ? spine[0] : -1);
+    ELE_SumRankSizes(registry, registry->root);
+    free(spine);
+    free(keys);
+}
+
+/* 0 for the top player, -1 if player is not registered */
+int ELE_GetPlayerRank(PlayerRegistry *registry, Player *player) {
+    int slot = ELE_GetPlayerSlot(registry, player);
+    if (slot < 0) return -1;
+    int rank = 0;
+    int tree = registry->root;
+    while (tree != slot) {
+        PlayerRankNode *t = &registry->nodes[tree];
+        if (ELE_NodeRanksBefore(registry, slot, tree)) {
+            tree = t->left;
+        } else {
+            rank += ELE_GetRankSize(registry, t->left) + 1;
+            tree = t->right;
+        }
+    }
+    return rank + ELE_GetRankSize(registry, registry->nodes[slot].left);
+}
+
+/* Players of tree ranked in [first, last) into players, offset being the rank of its first */
+void ELE_CollectRanks(PlayerRegistry *registry, int tree, int offset, int first, int last, Player **players) {
+    if (tree < 0 || offset >= last || offset + registry->nodes[tree].size <= first) return;
+    PlayerRankNode *t = &registry->nodes[tree];
+    ELE_CollectRanks(registry, t->left, offset, first, last, players);
+    int rank = offset + ELE_GetRankSize(registry, t->left);
+    if (first <= rank && rank < last) players[rank - first] = registry->players[tree];
+    ELE_CollectRanks(registry, t->right, rank + 1, first, last, players);
+}
+
+/* Up to cnt players from rank first on, returns how many */
+int ELE_GetPlayersByRank(PlayerRegistry *registry, int first, int cnt, Player **players) {
+    first = SDL_max(first, 0);
+    int last = SDL_min(first + SDL_max(cnt, 0), registry->player_cnt);
+    if (first >= last) return 0;
+    ELE_CollectRanks(registry, registry->root, 0, first, last, players);
+    return last - first;
+}
\ No newline at end of file
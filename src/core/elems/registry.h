@@ -0,0 +1,55 @@
+#ifndef _REGISTRY_H
+#define _REGISTRY_H
+
+#include <SDL2/SDL.h>
+#include "player.h"
+
+/*
+ * Every known player, with no cap on how many. Players are found by id
+ * or name through open addressing indexes, and ranked by a treap on
+ * (score descending, id) whose nodes count their subtree, so the rank
+ * of a player and the players at any rank take O(log n). A player whose
+ * score changed is ranked again with ELE_RankPlayer.
+ */
+
+struct PlayerRankNode {
+    int left, right;
+    /* Players in the subtree, this one included */
+    int size;
+    Uint32 priority;
+    /* Score and id the player is ranked with, the score until ELE_RankPlayer */
+    int score;
+    int id;
+};
+typedef struct PlayerRankNode PlayerRankNode;
+
+struct PlayerRegistry {
+    /* In the order they were added, nodes[i] ranks players[i] */
+    Player **players;
+    PlayerRankNode *nodes;
+    int player_cnt;
+    int player_size;
+    /* Slot + 1 of the player in each bucket, 0 for empty */
+    int *id_index;
+    int *name_index;
+    int index_size;
+    /* -1 while there are no players */
+    int root;
+    int next_id;
+};
+typedef struct PlayerRegistry PlayerRegistry;
+
+extern PlayerRegistry* ELE_CreatePlayerRegistry(void);
+extern void ELE_DestroyPlayerRegistry(PlayerRegistry *registry);
+
+extern int ELE_AddPlayer(PlayerRegistry *registry, Player *player);
+extern Player* ELE_FindPlayerById(PlayerRegistry *registry, int id);
+extern Player* ELE_FindPlayerByName(PlayerRegistry *registry, const char *name);
+extern int ELE_GetNextPlayerId(PlayerRegistry *registry);
+
+extern void ELE_RankPlayer(PlayerRegistry *registry, Player *player);
+extern void ELE_RankAllPlayers(PlayerRegistry *registry);
+extern int ELE_GetPlayerRank(PlayerRegistry *registry, Player *player);
+extern int ELE_GetPlayersByRank(PlayerRegistry *registry, int first, int cnt, Player **players);
+
+#endif /* _REGISTRY_H */
\ No newline at end of file
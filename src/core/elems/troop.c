@@ -1,32 +1,201 @@
 #include <SDL2/SDL.h>
-#include <SDL2/SDL2_gfxPrimitives.h>
 #include <stdlib.h>
-#include "../video.h"
 #include "troop.h"
 #include "../log.h"
 
-Troop* ELE_CreateTroop(
-    int id, Player *player, double x, double y,
-    Area *src, Area *dst, Troop *next, Troop *prev
+enum ELE_TroopConstants {
+    INITIAL_TROOP_SIZE = 64
+};
+
+TroopStore* ELE_CreateTroopStore() {
+    return calloc(1, sizeof(TroopStore));
+}
+
+void* ELE_AllocTroopBlock(TroopStore *store, Sint64 size) {
+    return (store->arena ? ARN_Alloc(store->arena, size) : malloc(size));
+}
+
+void ELE_FreeTroopBlock(TroopStore *store, void *block) {
+    if (store->arena == NULL) free(block);
+}
+
+void ELE_DestroyTroopStore(TroopStore *store) {
+    if (store == NULL || store->arena != NULL) return;
+    free(store->data);
+    free(store);
+}
+
+/* Points the arrays into data, laid out for size troops */
+void ELE_BindTroopStore(TroopStore *store) {
+    int *ints = (int*)store->data;
+    int size = store->size;
+    store->id = ints;
+    store->x = ints + size;
+    store->y = ints + 2 * size;
+    store->prev_x = ints + 3 * size;
+    store->prev_y = ints + 4 * size;
+    store->xi = ints + 5 * size;
+    store->yi = ints + 6 * size;
+    store->vx = ints + 7 * size;
+    store->vy = ints + 8 * size;
+    store->dx = ints + 9 * size;
+    store->dy = ints + 10 * size;
+    store->owner = ints + 11 * size;
+    store->src = ints + 12 * size;
+    store->dst = ints + 13 * size;
+    store->near = ints + 14 * size;
+    store->removed = (Uint8*)(ints + 15 * size);
+    store->status = store->removed + size;
+}
+
+Sint64 ELE_GetTroopDataSize(int size) {
+    return (15 * sizeof(int) + 2 * sizeof(Uint8)) * (Sint64)size;
+}
+
+/* The first cnt troops of src into dst, near and status are scratch and left out */
+void ELE_CopyTroops(TroopStore *dst, const TroopStore *src, int cnt) {
+    memcpy(dst->id, src->id, sizeof(int) * cnt);
+    memcpy(dst->x, src->x, sizeof(Fixed) * cnt);
+    memcpy(dst->y, src->y, sizeof(Fixed) * cnt);
+    memcpy(dst->prev_x, src->prev_x, sizeof(Fixed) * cnt);
+    memcpy(dst->prev_y, src->prev_y, sizeof(Fixed) * cnt);
+    memcpy(dst->xi, src->xi, sizeof(int) * cnt);
+    memcpy(dst->yi, src->yi, sizeof(int) * cnt);
+    memcpy(dst->vx, src->vx, sizeof(Fixed) * cnt);
+    memcpy(dst->vy, src->vy, sizeof(Fixed) * cnt);
+    memcpy(dst->dx, src->dx, sizeof(int) * cnt);
+    memcpy(dst->dy, src->dy, sizeof(int) * cnt);
+    memcpy(dst->owner, src->owner, sizeof(int) * cnt);
+    memcpy(dst->src, src->src, sizeof(int) * cnt);
+    memcpy(dst->dst, src->dst, sizeof(int) * cnt);
+    memcpy(dst->removed, src->removed, sizeof(Uint8) * cnt);
+}
+
+void ELE_GrowTroopStore(TroopStore *store) {
+    TroopStore old = *store;
+    store->size = (store->size ? store->size * 2 : INITIAL_TROOP_SIZE);
+    store->data = ELE_AllocTroopBlock(store, ELE_GetTroopDataSize(store->size));
+    ELE_BindTroopStore(store);
+    if (old.data != NULL) {
+        ELE_CopyTroops(store, &old, store->cnt);
+        ELE_FreeTroopBlock(store, old.data);
+    }
+}
+
+/*
+ * Copy of store allocated from arena, which the copy also grows into.
+ * When most of store is unused only the live troops are copied, into
+ * arrays of just about their count.
+ * It goes with the arena, ELE_DestroyTroopStore leaves it alone.
+ */
+TroopStore* ELE_CloneTroopStore(TroopStore *store, ARN_Arena *arena) {
+    TroopStore *new_store = ARN_Alloc(arena, sizeof(TroopStore));
+    if (new_store == NULL) return NULL;
+    *new_store = *store;
+    new_store->arena = arena;
+    if (store->data != NULL) {
+        int size = (store->cnt / INITIAL_TROOP_SIZE + 1) * INITIAL_TROOP_SIZE;
+        new_store->size = SDL_min(size, store->size);
+        new_store->data = ARN_Alloc(arena, ELE_GetTroopDataSize(new_store->size));
+        if (new_store->data == NULL) return NULL;
+        ELE_BindTroopStore(new_store);
+        if (new_store->size == store->size) {
+            memcpy(new_store->data, store->data, ELE_GetTroopDataSize(store->size));
+        } else {
+            ELE_CopyTroops(new_store, store, store->cnt);
+        }
+    }
+    return new_store;
+}
+
+/* Index of the new troop */
+int ELE_AddTroop(
+    TroopStore *store, int id, int owner, Fixed x, Fixed y,
+    int src, SDL_Point src_center, int dst, SDL_Point dst_center
 ) {
-    Troop *new_troop = malloc(sizeof(Troop));
-    new_troop->id = id;
-    new_troop->player = player;
-    ++player->troop_cnt;
-    new_troop->x = x;
-    new_troop->y = y;
-    new_troop->src = src;
-    new_troop->dst = dst;
-    new_troop->sx = src->center.x;
-    new_troop->sy = src->center.y;
-    new_troop->dx = dst->center.x;
-    new_troop->dy = dst->center.y;
-    new_troop->next = next;
-    new_troop->prev = prev;
-    return new_troop;
-}
-
-void ELE_DestroyTroop(Troop *troop) {
-    --troop->player->troop_cnt;
-    free(troop);
+    if (store->cnt == store->size) ELE_GrowTroopStore(store);
+    int i = store->cnt++;
+    store->id[i] = id;
+    store->x[i] = x;
+    store->y[i] = y;
+    store->prev_x[i] = x;
+    store->prev_y[i] = y;
+    store->xi[i] = ELE_FixedToInt(x);
+    store->yi[i] = ELE_FixedToInt(y);
+    ELE_GetDirection(src_center, dst_center, &store->vx[i], &store->vy[i]);
+    store->dx[i] = dst_center.x;
+    store->dy[i] = dst_center.y;
+    store->owner[i] = owner;
+    store->src[i] = src;
+    store->dst[i] = dst;
+    store->removed[i] = 0;
+    return i;
+}
+
+/* Drops every troop with removed[i] set, keeping the rest in order */
+void ELE_RemoveMarkedTroops(TroopStore *store) {
+    int n = 0;
+    for (int i = 0; i < store->cnt; i++) {
+        if (store->removed[i]) continue;
+        if (n != i) {
+            store->id[n] = store->id[i];
+            store->x[n] = store->x[i];
+            store->y[n] = store->y[i];
+            store->prev_x[n] = store->prev_x[i];
+            store->prev_y[n] = store->prev_y[i];
+            store->xi[n] = store->xi[i];
+            store->yi[n] = store->yi[i];
+            store->vx[n] = store->vx[i];
+            store->vy[n] = store->vy[i];
+            store->dx[n] = store->dx[i];
+            store->dy[n] = store->dy[i];
+            store->owner[n] = store->owner[i];
+            store->src[n] = store->src[i];
+            store->dst[n] = store->dst[i];
+            store->removed[n] = 0;
+        }
+        ++n;
+    }
+    store->cnt = n;
+}
+
+/* For drawing troops between the last two ticks */
+void ELE_SaveTroopPositions(TroopStore *store) {
+    memcpy(store->prev_x, store->x, sizeof(Fixed) * store->cnt);
+    memcpy(store->prev_y, store->y, sizeof(Fixed) * store->cnt);
+}
+
+/* Nearest Fixed, for positions stored as doubles by older builds */
+Fixed ELE_DoubleToFixed(double v) {
+    return (Fixed)SDL_floor(v * FIXED_ONE + 0.5);
+}
+
+/* Integer square root, rounded down */
+Uint64 ELE_Sqrt(Uint64 v) {
+    Uint64 root = 0, bit = (Uint64)1 << 62;
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/* Unit vector from one point towards another, (0, -1) if they are the same */
+void ELE_GetDirection(SDL_Point from, SDL_Point to, Fixed *ux, Fixed *uy) {
+    Sint64 dx = to.x - from.x, dy = to.y - from.y;
+    if (dx == 0 && dy == 0) {
+        *ux = 0;
+        *uy = -FIXED_ONE;
+        return;
+    }
+    /* Length with 8 fraction bits, so the quotient has 16 */
+    Sint64 len = ELE_Sqrt((Uint64)(dx * dx + dy * dy) << 16);
+    *ux = dx * (1 << 24) / len;
+    *uy = dy * (1 << 24) / len;
 }
\ No newline at end of file
@@ -2,25 +2,69 @@
 #define _TROOP_H
 
 #include <SDL2/SDL.h>
-#include "player.h"
-#include "area.h"
-
-struct Troop {
-    int id;
-    Player *player;
-    double x, y;
-    int sx, sy;
-    int dx, dy;
-    Area *src, *dst;
-    struct Troop *next;
-    struct Troop *prev;
+#include "../arena.h"
+
+/*
+ * Troop positions and velocities are 16.16 fixed point, so moving and
+ * colliding them is integer math that comes out the same on any build.
+ * Coordinates have to stay within +-32767 pixels.
+ */
+typedef Sint32 Fixed;
+
+enum ELE_FixedConstants {
+    FIXED_SHIFT = 16,
+    FIXED_ONE = 1 << FIXED_SHIFT
+};
+
+#define ELE_IntToFixed(v) ((Fixed)(v) * FIXED_ONE)
+#define ELE_FixedToInt(v) ((v) >> FIXED_SHIFT)
+
+/*
+ * Live troops as parallel arrays indexed 0..cnt-1, oldest first.
+ * Removing troops shifts the ones after them down, so an index only
+ * holds until the next ELE_RemoveMarkedTroops; across ticks a troop is
+ * known by its id. The arrays share one block, laid out for size
+ * troops, so a store takes one allocation however it grows.
+ */
+struct TroopStore {
+    int cnt;
+    int size;
+
+    int *id;
+    Fixed *x, *y;
+    /* x and y before the last tick, see ELE_SaveTroopPositions */
+    Fixed *prev_x, *prev_y;
+    /* Whole pixels of x and y, what every distance test uses */
+    int *xi, *yi;
+    /* Unit vector towards dst, fixed at spawn */
+    Fixed *vx, *vy;
+    int *dx, *dy;
+    int *owner; /* Index into Map::players */
+    int *src, *dst; /* Indices into Map::areas */
+    Uint8 *removed;
+
+    /* Scratch for the collision pass */
+    Uint8 *status;
+    int *near;
+
+    Uint8 *data;
+    /* Where clones allocate from, NULL for malloc */
+    ARN_Arena *arena;
 };
-typedef struct Troop Troop;
+typedef struct TroopStore TroopStore;
 
-extern Troop* ELE_CreateTroop(
-    int id, Player *player, double x, double y,
-    Area *src, Area *dst, Troop *next, Troop *prev
+extern TroopStore* ELE_CreateTroopStore(void);
+extern TroopStore* ELE_CloneTroopStore(TroopStore *store, ARN_Arena *arena);
+extern void ELE_DestroyTroopStore(TroopStore *store);
+
+extern int ELE_AddTroop(
+    TroopStore *store, int id, int owner, Fixed x, Fixed y,
+    int src, SDL_Point src_center, int dst, SDL_Point dst_center
 );
-extern void ELE_DestroyTroop(Troop *troop);
+extern void ELE_RemoveMarkedTroops(TroopStore *store);
+extern void ELE_SaveTroopPositions(TroopStore *store);
+
+extern Fixed ELE_DoubleToFixed(double v);
+extern void ELE_GetDirection(SDL_Point from, SDL_Point to, Fixed *ux, Fixed *uy);
 
 #endif /* _TROOP_H */
\ No newline at end of file
@@ -5,21 +5,63 @@
 #include <time.h>
 #include "game.h"
 #include "video.h"
+#include "text.h"
+#include "thumbs.h"
+#include "autosave.h"
+#include "journal.h"
+#include "replay.h"
+#include "telemetry.h"
+#include "sim.h"
+#include "ai.h"
+#include "prof.h"
+#include "kernels.h"
+#include "rng.h"
 #include "log.h"
 #include "elems/player.h"
+#include "elems/registry.h"
+#include "elems/playerdb.h"
 #include "elems/area.h"
 #include "elems/potion.h"
 #include "elems/map.h"
+#include "elems/mapfile.h"
+#include "elems/catalog.h"
 
 #define RGBAColor(color) color.r, color.g, color.b, color.a
 
 enum GME_GameConstants {
-    MAX_PLAYER_CNT = 11,
-    MAX_AREA_CNT = 31
+    PLAYER_COLOR_CNT = 11,
+    /* Clicks closer than this to an area's center go to it */
+    AREA_PICK_DIST = 25,
+    MAX_SPEED = 64,
+    MAPS_PER_PAGE = 9,
+    SCORES_PER_PAGE = 15,
+    REPLAY_SEEK_SECONDS = 10,
+    /* Ticks one frame may run at speed 1 before the game slows down instead */
+    MAX_CATCHUP_TICKS = 10
 };
 
+/* Everyone who has played, kept in g_PlayerDB as they change */
+PlayerRegistry *g_Registry = NULL;
+/* NULL if the players can't be saved */
+PlayerDB *g_PlayerDB = NULL;
+/* Saved maps, the chooser doesn't open map files until one is picked */
+MapCatalog *g_Catalog = NULL;
+/* A map was saved in the background since g_Catalog was read */
+int g_CatalogStale = 0;
+
+/* Built by GME_BuildRandMap, each area's id is its index */
+Area **g_Areas = NULL;
+int g_AreaCnt = 0;
+int g_AreaSize = 0;
+
+/* Chrome trace of the session, written on quit, NULL for none */
+const char *g_TraceFilename = NULL;
+/* Profiler overlay during matches, toggled with F3 */
+int g_ShowProfile = 0;
+
 int GME_Init() {
-    srand(time(NULL));
+    GME_SetSeed(time(NULL));
+    KRN_Init(KRN_BEST);
     Uint32 flags = SDL_INIT_VIDEO;
     if (SDL_Init(flags) != 0) {
         LogError("Unable to init sdl: %s");
@@ -36,22 +78,27 @@ int GME_Init() {
         LogInfo("IMG_Error: %s", IMG_GetError());
         return -1;
     }
+    /* Saves are written synchronously if this fails */
+    ASV_Init();
+#ifdef PRF_ENABLED
+    PRF_Init(g_TraceFilename);
+#endif
     return 0;
 }
 
 void GME_Quit() {
     LogInfo("Gracefully quitting game...");
-    Player **players = GME_GetPlayers();
-    Player player_arr[MAX_PLAYER_CNT] = {0};
-    for (int i = 0; i < MAX_PLAYER_CNT; i++) {
-        if (players[i] != NULL) {
-            player_arr[i] = *players[i];
-            ELE_DestroyPlayer(players[i]);
-        } else {
-            break;
-        }
-    }
-    ELE_SavePlayers(player_arr, GME_GetPlayerCnt());
+    ELE_ClosePlayerDB(g_PlayerDB, g_Registry);
+    g_PlayerDB = NULL;
+    ELE_DestroyPlayerRegistry(g_Registry);
+    g_Registry = NULL;
+    ELE_DestroyMapCatalog(g_Catalog);
+    free(g_Areas);
+    ASV_Quit();
+#ifdef PRF_ENABLED
+    PRF_Quit();
+#endif
+    TXT_Quit();
     VDO_Quit();
     IMG_Quit();
     TTF_Quit();
@@ -59,29 +106,25 @@ void GME_Quit() {
     LogInfo("Done.");
 }
 
+/* Id of the next map saved */
 int map_cnt = 0;
 
+/* Built from the map files the first time, when there is no catalog yet */
+void GME_LoadCatalog() {
+    ELE_DestroyMapCatalog(g_Catalog);
+    g_Catalog = ELE_LoadMapCatalog(MAP_CATALOG_FILE);
+    if (g_Catalog == NULL) {
+        g_Catalog = ELE_BuildMapCatalog();
+        ELE_SaveMapCatalog(g_Catalog, MAP_CATALOG_FILE);
+    }
+    map_cnt = ELE_GetNextMapId(g_Catalog);
+}
+
 int GME_Start() {
     if (GME_RetrievePlayers() != 0) {
         return -1;
     }
-    for (int i = 0; i < 9; i++) {
-        char buffer[25];
-        sprintf(buffer, "bin/data/map%d.bin", i);
-        SDL_RWops *file = SDL_RWFromFile(buffer, "rb");
-        if (file == NULL) {
-            sprintf(buffer, "bin/data/map%d", i);
-            file = SDL_RWFromFile(buffer, "rb");
-            if (file == NULL) break;
-            else {
-                ++map_cnt;
-                SDL_RWclose(file);
-            }
-        } else {
-            ++map_cnt;
-            SDL_RWclose(file);
-        }
-    }
+    GME_LoadCatalog();
     switch (GME_GetCurPlayer()) {
         case 1:
             return 0;
@@ -97,7 +140,7 @@ const SDL_Color g_BlackColor = (SDL_Color){0, 0, 0, 255};
 const SDL_Color g_LightBlackColor = (SDL_Color){50, 50, 50, 255};
 const SDL_Color g_WhiteColor = (SDL_Color){255, 255, 255, 255};
 const SDL_Color g_BlueColor = (SDL_Color){0, 120, 230, 255};
-const SDL_Color g_PlayerColors[MAX_PLAYER_CNT] = {
+const SDL_Color g_PlayerColors[PLAYER_COLOR_CNT] = {
     (SDL_Color){.r =  80, .g = 215, .b = 185, .a = 255},
     (SDL_Color){.r =  75, .g = 115, .b = 215, .a = 255},
     (SDL_Color){.r = 255, .g = 130, .b = 115, .a = 255},
@@ -117,19 +160,61 @@ const SDL_Color g_PotionColors[4] = {
     (SDL_Color){165, 0, 0, 255}
 };
 
-Player *g_Players[MAX_PLAYER_CNT];
-Area *g_Areas[MAX_AREA_CNT];
-
 Player *g_CurPlayer;
 
 Map *g_CurMap;
 
-Potion **g_Potions;
-int potion_cnt;
-int potion_size;
+/* Random maps and the seeds of matches played on them */
+RNG g_Rng;
+
+/* Simulation ticks per SIM_TICK_RATE tick of real time */
+int g_Speed = 1;
+
+/* Seconds between background saves of lastmap during a match, 0 for never */
+int g_AutosaveInterval = 0;
+
+/* Seed of the match on g_CurMap, 0 if it was resumed without a journal */
+Uint64 g_MatchSeed = 0;
+/* Journal of a resumed match, taken over by GME_RenderGame */
+JRN_Journal *g_Journal = NULL;
+
+/* Drives every player but the human in new matches, NULL leaves them to SIM_RunAI */
+const AI_Policy *g_AIPolicy = NULL;
+/* Microseconds per decision, 0 for no limit */
+Uint64 g_AIBudget = AI_DEFAULT_BUDGET_US;
 
 SDL_Texture *g_PotionTextures[4];
 
+void GME_SetSpeed(int speed) {
+    g_Speed = SDL_max(1, SDL_min(speed, MAX_SPEED));
+}
+
+void GME_SetAutosave(int seconds) {
+    g_AutosaveInterval = SDL_max(0, seconds);
+}
+
+void GME_SetAI(const char *name) {
+    g_AIPolicy = AI_GetPolicy(name);
+}
+
+void GME_SetAIBudget(int us) {
+    g_AIBudget = SDL_max(0, us);
+}
+
+/* Before GME_Init */
+void GME_SetTrace(const char *filename) {
+#ifdef PRF_ENABLED
+    g_TraceFilename = filename;
+#else
+    LogInfo("Not tracing %s, the profiler is not in this build", filename);
+#endif
+}
+
+void GME_SetSeed(Uint64 seed) {
+    LogInfo("Seed %llu", (unsigned long long)seed);
+    RNG_Seed(&g_Rng, seed, 0);
+}
+
 int GME_Scoreboard() {
     int quit = 0;
     int sdl_quit = 0;
@@ -137,21 +222,29 @@ int GME_Scoreboard() {
     VDO_GetWindowSize(&w, &h);
     SDL_Event e;
     SDL_Renderer *renderer = VDO_GetRenderer();
-    TTF_Font *font = TTF_OpenFont("bin/fonts/SourceCodePro.ttf", 24);
+    TXT_Font *font = TXT_GetFont("bin/fonts/SourceCodePro.ttf", 24);
     int table_width = 500, table_height = 600;
     SDL_Rect table = {w / 2 - table_width / 2, h / 2 - table_height / 2 - 30, table_width, table_height};
     int back_btn_sz = 70;
     SDL_Rect back_btn = {30, h - 25 - back_btn_sz, back_btn_sz, back_btn_sz};
     int entry_margin = 15, entry_height = 20, name_width = 350, score_width = 120;
-    int player_cnt = GME_GetPlayerCnt();
-    Player **players = malloc(sizeof(Player*) * player_cnt);
-    memcpy(players, g_Players, sizeof(Player*) * player_cnt);
-    ELE_SortPlayersByScore(players, player_cnt);
+    TXT_Font *font_small = TXT_GetFont("bin/fonts/SourceCodePro.ttf", 18);
+    /* Only the page shown is taken from the registry */
+    int page_cnt = SDL_max(1, (g_Registry->player_cnt + SCORES_PER_PAGE - 1) / SCORES_PER_PAGE);
+    int page = SDL_max(ELE_GetPlayerRank(g_Registry, g_CurPlayer), 0) / SCORES_PER_PAGE;
+    Player *players[SCORES_PER_PAGE];
     while (!quit) {
         while (SDL_PollEvent(&e) != 0) {
+            TXT_HandleRenderReset(&e);
             if (e.type == SDL_QUIT) {
                 quit = 1;
                 sdl_quit = 1;
+            } else if (e.type == SDL_MOUSEWHEEL) {
+                if (e.wheel.y < 0 && page + 1 < page_cnt) ++page;
+                if (e.wheel.y > 0 && page > 0) --page;
+            } else if (e.type == SDL_KEYDOWN) {
+                if (e.key.keysym.sym == SDLK_RIGHT && page + 1 < page_cnt) ++page;
+                if (e.key.keysym.sym == SDLK_LEFT && page > 0) --page;
             } else if (e.type == SDL_MOUSEBUTTONDOWN) {
                 int x, y;
                 SDL_GetMouseState(&x, &y);
@@ -165,9 +258,9 @@ int GME_Scoreboard() {
         boxRGBA(renderer, 0, 0, w, h, RGBAColor(g_BackgroundColor));
         roundedBoxRGBA(renderer, table.x, table.y, table.x + table.w, table.y + table.h, 10,
             RGBAColor(g_GreyColor));
-        GME_WriteTTF(renderer, font, "Player", g_WhiteColor, table.x + entry_margin + name_width / 2,
+        TXT_Write(renderer, font, "Player", g_WhiteColor, table.x + entry_margin + name_width / 2,
             table.y + entry_margin + entry_height / 2);
-        GME_WriteTTF(renderer, font, "Score", g_WhiteColor, table.x + table.w - entry_margin - score_width / 2,
+        TXT_Write(renderer, font, "Score", g_WhiteColor, table.x + table.w - entry_margin - score_width / 2,
             table.y + entry_margin + entry_height / 2);
         lineRGBA(renderer, table.x + entry_margin, table.y + 2 * entry_margin + entry_height,
             table.x + entry_margin + name_width - 4, table.y + 2 * entry_margin + entry_height,
@@ -176,17 +269,25 @@ int GME_Scoreboard() {
             table.y + 2 * entry_margin + entry_height,
             table.x + table.w - entry_margin - 2, table.y + 2 * entry_margin + entry_height,
             RGBAColor(g_WhiteColor));
+        int player_cnt = ELE_GetPlayersByRank(g_Registry, page * SCORES_PER_PAGE, SCORES_PER_PAGE, players);
         for (int i = 0; i < player_cnt; i++) {
             Player *player = players[i];
-            GME_WriteTTF(renderer, font, player->name, g_WhiteColor,
+            SDL_Color color = (player == g_CurPlayer ? g_BlueColor : g_WhiteColor);
+            char buffer[48];
+            sprintf(buffer, "%d. %s", page * SCORES_PER_PAGE + i + 1, player->name);
+            TXT_Write(renderer, font, buffer, color,
                 table.x + entry_margin + name_width / 2,
                 table.y + (i + 3) * entry_margin + (i + 1) * entry_height + entry_height / 2);
-            char buffer[10];
             sprintf(buffer, "%d", player->score);
-            GME_WriteTTF(renderer, font, buffer, g_WhiteColor,
+            TXT_Write(renderer, font, buffer, color,
                 table.x + table.w - entry_margin - score_width / 2,
                 table.y + (i + 3) * entry_margin + (i + 1) * entry_height + entry_height / 2);
         }
+        if (page_cnt > 1) {
+            char buffer[24];
+            sprintf(buffer, "%d / %d", page + 1, page_cnt);
+            TXT_Write(renderer, font_small, buffer, g_LightBlackColor, w / 2, table.y + table.h + 20);
+        }
         roundedBoxRGBA(renderer, back_btn.x, back_btn.y, back_btn.x + back_btn.w,
             back_btn.y + back_btn.h, 10, RGBAColor(g_GreyColor));
         filledTrigonRGBA(renderer, back_btn.x + 20, back_btn.y + back_btn.h / 2,
@@ -196,12 +297,10 @@ int GME_Scoreboard() {
         char buffer[50];
         sprintf(buffer, "Player: %s", g_CurPlayer->name);
         roundedRectangleRGBA(renderer, w - 370, h - 75, w - 20, h - 25, 10, RGBAColor(g_BlackColor));
-        GME_WriteTTF(renderer, font, buffer, g_BlackColor,
+        TXT_Write(renderer, font, buffer, g_BlackColor,
             w - 200, h - 50);
-        SDL_RenderPresent(renderer);
+        VDO_Present();
     }
-    TTF_CloseFont(font);
-    free(players);
     if (sdl_quit) return 1;
     return 0;
 }
@@ -216,72 +315,120 @@ int GME_ChooseMap() {
     int back_btn_sz = 70;
     SDL_Rect back_btn = {30, h - 25 - back_btn_sz, back_btn_sz, back_btn_sz};
     int btn_w = 150, btn_h = 180, btn_marg = 20;
-    SDL_Rect btn[9];
-    for (int i = 0; i < 9; i++) {
+    SDL_Rect btn[MAPS_PER_PAGE];
+    for (int i = 0; i < MAPS_PER_PAGE; i++) {
         int ti = i % 3, tj = i / 3;
         btn[i].x = w / 2 - (1 - ti) * (btn_w + btn_marg) - btn_w / 2;
         btn[i].y = h / 2 - (1 - tj) * (btn_h + btn_marg) - btn_h / 2 - 50;
         btn[i].w = btn_w; btn[i].h = btn_h;
     }
+    int page_btn_w = 50, page_btn_h = 100;
+    SDL_Rect prev_btn = {btn[0].x - btn_marg - page_btn_w, btn[3].y + (btn_h - page_btn_h) / 2,
+        page_btn_w, page_btn_h};
+    SDL_Rect next_btn = {btn[2].x + btn_w + btn_marg, prev_btn.y, page_btn_w, page_btn_h};
     SDL_Rect rnd = {back_btn.x + back_btn.w + 20, h - 95, btn_w + 100, 70};
     SDL_Rect tst = {rnd.x + rnd.w + 20, h - 95, btn_w + 60, 70};
-    TTF_Font *font = TTF_OpenFont("bin/fonts/SourceCodePro.ttf", 24);
+    TXT_Font *font = TXT_GetFont("bin/fonts/SourceCodePro.ttf", 24);
+    TXT_Font *font_small = TXT_GetFont("bin/fonts/SourceCodePro.ttf", 18);
+    if (g_CatalogStale) {
+        ASV_Flush();
+        GME_LoadCatalog();
+        g_CatalogStale = 0;
+    }
+    int entry_cnt = g_Catalog->entry_cnt;
+    int page_cnt = SDL_max(1, (entry_cnt + MAPS_PER_PAGE - 1) / MAPS_PER_PAGE);
+    int page = 0;
+    THB_Start(g_Catalog, g_WhiteColor, g_LightBlackColor);
     int mapid = -10;
     while (!quit) {
         while (SDL_PollEvent(&e) != 0) {
+            TXT_HandleRenderReset(&e);
             if (e.type == SDL_QUIT) {
                 quit = sdl_quit = 1;
+            } else if (e.type == SDL_RENDER_DEVICE_RESET) {
+                THB_DropTextures();
+            } else if (e.type == SDL_MOUSEWHEEL) {
+                if (e.wheel.y < 0 && page + 1 < page_cnt) ++page;
+                if (e.wheel.y > 0 && page > 0) --page;
+            } else if (e.type == SDL_KEYDOWN) {
+                if (e.key.keysym.sym == SDLK_RIGHT && page + 1 < page_cnt) ++page;
+                if (e.key.keysym.sym == SDLK_LEFT && page > 0) --page;
             } else if (e.type == SDL_MOUSEBUTTONDOWN) {
                 int x, y;
                 SDL_GetMouseState(&x, &y);
-                if (back_btn.x <= x && x <= back_btn.x + back_btn.w &&
-                    back_btn.y <= y && y <= back_btn.y + back_btn.h) {
+                SDL_Point mouse = {x, y};
+                if (SDL_PointInRect(&mouse, &back_btn)) {
                     quit = 1;
                     break;
                 }
-                if (rnd.x <= x && x <= rnd.x + rnd.w &&
-                    rnd.y <= y && y <= rnd.y + rnd.h) {
+                if (SDL_PointInRect(&mouse, &rnd)) {
                     mapid = -1;
                     quit = 1;
                 }
-                if (tst.x <= x && x <= tst.x + tst.w &&
-                    tst.y <= y && y <= tst.y + tst.h) {
-                    mapid = 100;
+                if (SDL_PointInRect(&mouse, &tst)) {
+                    mapid = -2;
                     quit = 1;
                 }
-                for (int i = 0; i < 9; i++) {
-                    if (i == map_cnt) break;
-                    if (btn[i].x <= x && x <= btn[i].x + btn[i].w &&
-                        btn[i].y <= y && y <= btn[i].y + btn[i].h) {
-                        mapid = i;
+                if (SDL_PointInRect(&mouse, &prev_btn) && page > 0) --page;
+                if (SDL_PointInRect(&mouse, &next_btn) && page + 1 < page_cnt) ++page;
+                for (int i = 0; i < MAPS_PER_PAGE; i++) {
+                    int index = page * MAPS_PER_PAGE + i;
+                    if (index >= entry_cnt) break;
+                    if (SDL_PointInRect(&mouse, &btn[i])) {
+                        mapid = g_Catalog->entries[index].id;
                         quit = 1;
                         break;
                     }
                 }
             }
         }
+        THB_SetPage(page * MAPS_PER_PAGE);
         boxRGBA(renderer, 0, 0, w, h, RGBAColor(g_BackgroundColor));
-        for (int i = 0; i < 9; i++) {
+        for (int i = 0; i < MAPS_PER_PAGE; i++) {
+            int index = page * MAPS_PER_PAGE + i;
             roundedRectangleRGBA(renderer, btn[i].x, btn[i].y, btn[i].x + btn[i].w, btn[i].y + btn[i].h,
                 10, RGBAColor(g_GreyColor));
-            if (i < map_cnt) {
-                roundedBoxRGBA(renderer, btn[i].x, btn[i].y, btn[i].x + btn[i].w, btn[i].y + btn[i].h,
-                    10, RGBAColor(g_GreyColor));
-                char buffer[10];
-                sprintf(buffer, "Map %d", i);
-                GME_WriteTTF(renderer, font, buffer, g_WhiteColor, btn[i].x + btn[i].w / 2, btn[i].y + btn[i].h / 2);
+            if (index >= entry_cnt) continue;
+            roundedBoxRGBA(renderer, btn[i].x, btn[i].y, btn[i].x + btn[i].w, btn[i].y + btn[i].h,
+                10, RGBAColor(g_GreyColor));
+            SDL_Texture *thumb = THB_GetTexture(index);
+            if (thumb != NULL) {
+                int thumb_w = btn_w - 20, thumb_h = thumb_w * MAP_THUMB_H / MAP_THUMB_W;
+                SDL_Rect dst = {btn[i].x + 10, btn[i].y + 20, thumb_w, thumb_h};
+                SDL_RenderCopy(renderer, thumb, NULL, &dst);
             }
+            char buffer[16];
+            sprintf(buffer, "Map %d", g_Catalog->entries[index].id);
+            TXT_Write(renderer, font, buffer, g_WhiteColor, btn[i].x + btn[i].w / 2, btn[i].y + btn[i].h - 40);
+        }
+        if (page_cnt > 1) {
+            roundedBoxRGBA(renderer, prev_btn.x, prev_btn.y, prev_btn.x + prev_btn.w,
+                prev_btn.y + prev_btn.h, 10, RGBAColor((page > 0 ? g_GreyColor : g_BackgroundColor)));
+            filledTrigonRGBA(renderer, prev_btn.x + 12, prev_btn.y + prev_btn.h / 2,
+                prev_btn.x + prev_btn.w - 12, prev_btn.y + 30,
+                prev_btn.x + prev_btn.w - 12, prev_btn.y + prev_btn.h - 30,
+                RGBAColor(g_BackgroundColor));
+            roundedBoxRGBA(renderer, next_btn.x, next_btn.y, next_btn.x + next_btn.w,
+                next_btn.y + next_btn.h, 10, RGBAColor((page + 1 < page_cnt ? g_GreyColor : g_BackgroundColor)));
+            filledTrigonRGBA(renderer, next_btn.x + next_btn.w - 12, next_btn.y + next_btn.h / 2,
+                next_btn.x + 12, next_btn.y + 30,
+                next_btn.x + 12, next_btn.y + next_btn.h - 30,
+                RGBAColor(g_BackgroundColor));
+            char buffer[24];
+            sprintf(buffer, "%d / %d", page + 1, page_cnt);
+            TXT_Write(renderer, font_small, buffer, g_LightBlackColor, w / 2,
+                btn[MAPS_PER_PAGE - 1].y + btn_h + btn_marg);
         }
         roundedBoxRGBA(renderer, rnd.x, rnd.y, rnd.x + rnd.w, rnd.y + rnd.h, 10,
             RGBAColor(g_GreyColor));
-        GME_WriteTTF(renderer, font, "Generate Random", g_WhiteColor, rnd.x + rnd.w / 2, h - 60);
+        TXT_Write(renderer, font, "Generate Random", g_WhiteColor, rnd.x + rnd.w / 2, h - 60);
         roundedBoxRGBA(renderer, tst.x, tst.y, tst.x + tst.w, tst.y + tst.h, 10,
             RGBAColor(g_GreyColor));
-        GME_WriteTTF(renderer, font, "Test Arena", g_WhiteColor, tst.x + tst.w / 2, h - 60);
+        TXT_Write(renderer, font, "Test Arena", g_WhiteColor, tst.x + tst.w / 2, h - 60);
         char buffer[50];
         sprintf(buffer, "Player: %s", g_CurPlayer->name);
         roundedRectangleRGBA(renderer, w - 370, h - 75, w - 20, h - 25, 10, RGBAColor(g_BlackColor));
-        GME_WriteTTF(renderer, font, buffer, g_BlackColor,
+        TXT_Write(renderer, font, buffer, g_BlackColor,
             w - 200, h - 50);
         roundedBoxRGBA(renderer, back_btn.x, back_btn.y, back_btn.x + back_btn.w,
             back_btn.y + back_btn.h, 10, RGBAColor(g_GreyColor));
@@ -289,18 +436,20 @@ int GME_ChooseMap() {
             back_btn.x + back_btn.w - 20, back_btn.y + 15,
             back_btn.x + back_btn.w - 20, back_btn.y + back_btn.h - 15,
             RGBAColor(g_BackgroundColor));
-        SDL_RenderPresent(renderer);
+        VDO_Present();
     }
-    TTF_CloseFont(font);
+    THB_Quit();
     if (sdl_quit) return 1;
     if (mapid == -1) {
         if (GME_MapStart(0) == 1) sdl_quit = 1;
         GME_MapQuit(GME_GetCurMap());
-    } else if (mapid == 100) {
+    } else if (mapid == -2) {
         if (GME_GenerateTestArena() < 0) return -1;
         if (GME_MapStart(GME_GetCurMap()) == 1) sdl_quit = 1;
         GME_MapQuit(GME_GetCurMap());
     } else if (mapid >= 0) {
+        ASV_Flush();
+        if (ELE_CheckMapCatalogEntry(g_Catalog, mapid)) ELE_SaveMapCatalog(g_Catalog, MAP_CATALOG_FILE);
         if (GME_RetrieveMap(mapid) < 0) return -1;
         if (GME_MapStart(GME_GetCurMap()) == 1) sdl_quit = 1;
         GME_MapQuit(GME_GetCurMap());
@@ -315,8 +464,8 @@ int GME_Menu() {
     VDO_GetWindowSize(&w, &h);
     SDL_Event e;
     SDL_Renderer *renderer = VDO_GetRenderer();
-    TTF_Font *font = TTF_OpenFont("bin/fonts/Aaargh.ttf", 32);
-    TTF_Font *font_small = TTF_OpenFont("bin/fonts/SourceCodePro.ttf", 24);
+    TXT_Font *font = TXT_GetFont("bin/fonts/Aaargh.ttf", 32);
+    TXT_Font *font_small = TXT_GetFont("bin/fonts/SourceCodePro.ttf", 24);
     int button_width = 400, button_height = 80, button_margin = 30;
     SDL_Rect new_game_btn = {w / 2 - button_width / 2, h / 2 - 3 * button_height / 2 - button_margin,
         button_width, button_height};
@@ -327,6 +476,7 @@ int GME_Menu() {
     while (!quit) {
         int next = -1;
         while (SDL_PollEvent(&e) != 0) {
+            TXT_HandleRenderReset(&e);
             if (e.type == SDL_QUIT) {
                 quit = 1;
             } else if (e.type == SDL_MOUSEBUTTONDOWN) {
@@ -364,27 +514,25 @@ int GME_Menu() {
         roundedBoxRGBA(renderer, new_game_btn.x, new_game_btn.y,
             new_game_btn.x + new_game_btn.w, new_game_btn.y + new_game_btn.h,
             10, RGBAColor(g_GreyColor));
-        GME_WriteTTF(renderer, font, "New Game", g_WhiteColor, new_game_btn.x + new_game_btn.w / 2,
+        TXT_Write(renderer, font, "New Game", g_WhiteColor, new_game_btn.x + new_game_btn.w / 2,
             new_game_btn.y + new_game_btn.h / 2);
         roundedBoxRGBA(renderer, cont_game_btn.x, cont_game_btn.y,
             cont_game_btn.x + cont_game_btn.w, cont_game_btn.y + cont_game_btn.h,
             10, RGBAColor(g_GreyColor));
-        GME_WriteTTF(renderer, font, "Continue Last Game", g_WhiteColor, cont_game_btn.x + cont_game_btn.w / 2,
+        TXT_Write(renderer, font, "Continue Last Game", g_WhiteColor, cont_game_btn.x + cont_game_btn.w / 2,
             cont_game_btn.y + cont_game_btn.h / 2);
         roundedBoxRGBA(renderer, scoreboard_btn.x, scoreboard_btn.y,
             scoreboard_btn.x + scoreboard_btn.w, scoreboard_btn.y + scoreboard_btn.h,
             10, RGBAColor(g_GreyColor));
-        GME_WriteTTF(renderer, font, "Scoreboard", g_WhiteColor, scoreboard_btn.x + scoreboard_btn.w / 2,
+        TXT_Write(renderer, font, "Scoreboard", g_WhiteColor, scoreboard_btn.x + scoreboard_btn.w / 2,
             scoreboard_btn.y + scoreboard_btn.h / 2);
         char buffer[50];
         sprintf(buffer, "Player: %s", g_CurPlayer->name);
         roundedRectangleRGBA(renderer, w - 370, h - 75, w - 20, h - 25, 10, RGBAColor(g_BlackColor));
-        GME_WriteTTF(renderer, font_small, buffer, g_BlackColor,
+        TXT_Write(renderer, font_small, buffer, g_BlackColor,
             w - 200, h - 50);
-        SDL_RenderPresent(renderer);
+        VDO_Present();
     }
-    TTF_CloseFont(font);
-    TTF_CloseFont(font_small);
     return 0;
 }
 
@@ -393,7 +541,7 @@ Map* GME_GetCurMap() {
 }
 
 Player** GME_GetPlayers() {
-    return g_Players;
+    return g_Registry->players;
 }
 
 Area** GME_GetAreas() {
@@ -401,43 +549,11 @@ Area** GME_GetAreas() {
 }
 
 int GME_GetPlayerCnt() {
-    int player_cnt = MAX_PLAYER_CNT;
-    for (int i = 0; i < MAX_PLAYER_CNT; i++) {
-        if (g_Players[i] == NULL) {
-            player_cnt = i;
-            break;
-        }
-    }
-    return player_cnt;
+    return g_Registry->player_cnt;
 }
 
 int GME_GetAreaCnt() {
-    int area_cnt = MAX_AREA_CNT;
-    for (int i = 0; i < MAX_AREA_CNT; i++) {
-        if (g_Areas[i] == NULL) {
-            area_cnt = i;
-            break;
-        }
-    }
-    return area_cnt;
-}
-
-int GME_WriteTTF(SDL_Renderer *renderer, TTF_Font *font, const char *s, SDL_Color color,
-        int x, int y) {
-    SDL_Surface *text = TTF_RenderText_Solid(font, s, color);
-    SDL_Texture *text_texture = SDL_CreateTextureFromSurface(renderer, text);
-    SDL_Rect obox = {x - text->w / 2, y - text->h / 2, text->w, text->h};
-    SDL_Rect ibox = {0, 0, text->w, text->h};
-    if (text == NULL || text_texture == NULL) {
-        SDL_FreeSurface(text);
-        SDL_DestroyTexture(text_texture);
-        LogInfo("TTF_Error: %s", TTF_GetError());
-        return -1;
-    }
-    SDL_RenderCopy(renderer, text_texture, &ibox, &obox);
-    SDL_FreeSurface(text);
-    SDL_DestroyTexture(text_texture);
-    return 0;
+    return g_AreaCnt;
 }
 
 int GME_GetCurPlayer() {
@@ -456,10 +572,11 @@ int GME_GetCurPlayer() {
         LogInfo("IMG_Error: %s", IMG_GetError());
         return -1;
     }
-    TTF_Font *font = TTF_OpenFont("bin/fonts/SourceCodePro.ttf", 24);
+    TXT_Font *font = TXT_GetFont("bin/fonts/SourceCodePro.ttf", 24);
     SDL_Texture *icon_texture = SDL_CreateTextureFromSurface(renderer, icon);
     while (!quit) {
         while (SDL_PollEvent(&e) != 0) {
+            TXT_HandleRenderReset(&e);
             if (e.type == SDL_KEYDOWN) {
                 if (e.key.keysym.sym == SDLK_BACKSPACE && name_ptr > 1) {
                     name[--name_ptr] = 0;
@@ -474,7 +591,6 @@ int GME_GetCurPlayer() {
                 SDL_StopTextInput();
                 SDL_DestroyTexture(icon_texture);
                 SDL_FreeSurface(icon);
-                TTF_CloseFont(font);
                 return 1;
             }
         }
@@ -486,121 +602,32 @@ int GME_GetCurPlayer() {
         SDL_RenderCopy(renderer, icon_texture, &icon_src, &icon_box);
         roundedBoxRGBA(renderer, w / 2 - 250, h / 2 - 20, w / 2 + 250, h / 2 + 20, 5,
             RGBAColor(g_GreyColor));
-        GME_WriteTTF(renderer, font, name, g_WhiteColor, w / 2 - 5, h / 2);
-        SDL_RenderPresent(renderer);
+        TXT_Write(renderer, font, name, g_WhiteColor, w / 2 - 5, h / 2);
+        VDO_Present();
     }
     SDL_StopTextInput();
     SDL_DestroyTexture(icon_texture);
     SDL_FreeSurface(icon);
-    TTF_CloseFont(font);
-    int player_cnt = MAX_PLAYER_CNT;
-    for (int i = 0; i < MAX_PLAYER_CNT; i++) {
-        if (g_Players[i] != NULL && !strcmp(g_Players[i]->name, name + 1)) {
-            g_CurPlayer = g_Players[i];
-            break;
-        }
-        if (g_Players[i] == NULL) {
-            player_cnt = i;
-            break;
-        }
-    }
+    g_CurPlayer = ELE_FindPlayerByName(g_Registry, name + 1);
     if (g_CurPlayer == NULL) {
-        if (player_cnt >= MAX_PLAYER_CNT) {
-            LogInfo("Maximum number of players reached");
-            return 1;
+        int id = ELE_GetNextPlayerId(g_Registry);
+        g_CurPlayer = ELE_CreatePlayer(id, name + 1, g_PlayerColors[id % PLAYER_COLOR_CNT], 0);
+        if (ELE_AddPlayer(g_Registry, g_CurPlayer) != 0) {
+            ELE_DestroyPlayer(g_CurPlayer);
+            g_CurPlayer = NULL;
+            return -1;
         }
-        g_CurPlayer = ELE_CreatePlayer(player_cnt, name + 1, g_PlayerColors[player_cnt], 0);
-        g_Players[player_cnt] = g_CurPlayer;
+        ELE_AppendPlayer(g_PlayerDB, g_CurPlayer);
     }
     LogInfo("Player id %d", g_CurPlayer->id);
     return 0;
 }
 
 Player* GME_GetPlayerById(int id) {
-    int player_cnt = GME_GetPlayerCnt();
-    for (int i = 0; i < player_cnt; i++) {
-        if (g_Players[i]->id == id) {
-            return g_Players[i];
-        }
-    }
-    return NULL;
-}
-
-Area* GME_GetAreaById(int id) {
-    int area_cnt = GME_GetAreaCnt();
-    for (int i = 0; i < area_cnt; i++) {
-        if (g_Areas[i]->id == id) {
-            return g_Areas[i];
-        }
-    }
-    return NULL;
+    return ELE_FindPlayerById(g_Registry, id);
 }
 
-int GME_MapStart(Map *map) {
-    LogInfo("Starting map...");
-    if (map == NULL) {
-        GME_BuildRandMap();
-        Player *players[5];
-        players[0] = g_Players[0];
-        players[1] = g_Players[1];
-        players[2] = g_Players[2];
-        players[3] = g_Players[3];
-        players[4] = g_CurPlayer;
-        int area_cnt = MAX_AREA_CNT;
-        for (int i = 0; i < MAX_AREA_CNT; i++) {
-            if (g_Areas[i] == NULL) {
-                area_cnt = i;
-                break;
-            }
-        }
-        g_CurMap = ELE_CreateMap(map_cnt, players, 5, g_Areas, area_cnt);
-        for (int i = 0; i < g_CurMap->player_cnt; i++) {
-            int start_area = rand() % g_CurMap->area_cnt;
-            for (int i = 0; i < 20; i++) {
-                if (g_CurMap->areas[start_area]->conqueror == NULL) break;
-                start_area = rand() % g_CurMap->area_cnt;
-            }
-            if (g_CurMap->areas[start_area]->conqueror != NULL) return -1;
-            ELE_AreaConquer(g_CurMap->areas[start_area], g_CurMap->players[i]);
-        }
-        g_Potions = malloc(sizeof(Potion*));
-        potion_cnt = 0;
-        potion_size = 1;
-    } else {
-        g_CurMap = map;
-        if (map->players == NULL) {
-            map->player_cnt = 5;
-            map->players = malloc(sizeof(Player*) * map->player_cnt);
-            for (int i = 0; i < map->player_cnt - 1; i++) {
-                map->players[i] = g_Players[i];
-            }
-            map->players[map->player_cnt - 1] = g_CurPlayer;
-            for (int i = 0; i < map->area_cnt; i++) {
-                map->areas[i]->troop_cnt = 30;
-                map->areas[i]->troop_inc_delay = 0;
-                map->areas[i]->troop_rate = 60;
-            }
-            for (int i = 0; i < map->player_cnt; i++) {
-                map->players[i]->applied_potion = NULL;
-                map->players[i]->area_cnt = 0;
-                map->players[i]->attack_delay = 0;
-                map->players[i]->troop_cnt = 0;
-                map->players[i]->troop_rate = 60;
-                int start_area = rand() % map->area_cnt;
-                for (int i = 0; i < 20; i++) {
-                    if (map->areas[start_area]->conqueror == NULL) break;
-                    start_area = rand() % map->area_cnt;
-                }
-                if (map->areas[start_area]->conqueror != NULL) return -1;
-                ELE_AreaConquer(map->areas[start_area], map->players[i]);
-            }
-        }
-        if (g_Potions == NULL) {
-            g_Potions = malloc(sizeof(Potion*));
-            potion_cnt = 0;
-            potion_size = 1;
-        }
-    }
+void GME_LoadPotionTextures() {
     SDL_Surface *surf;
     SDL_Renderer *renderer = VDO_GetRenderer();
     surf = IMG_Load("bin/images/TroopSpeedX2.png");
@@ -615,186 +642,85 @@ int GME_MapStart(Map *map) {
     surf = IMG_Load("bin/images/AreaShield.png");
     g_PotionTextures[3] = SDL_CreateTextureFromSurface(renderer, surf);
     SDL_FreeSurface(surf);
-    LogInfo("Map id %d", g_CurMap->id);
-    return GME_RenderGame();
 }
 
-void GME_MapQuit(Map *map) {
-    if (g_Potions != NULL) {
-        for (int i = 0; i < potion_cnt; i++) {
-            if (g_Potions[i] != NULL) {
-                ELE_DestroyPotion(g_Potions[i]);
-            }
-        }
-    }
-    free(g_Potions);
-    g_Potions = NULL;
-    for (int i = 0; i < map->player_cnt; i++) {
-        if (map->players[i]->applied_potion != NULL) {
-            ELE_DestroyPotion(map->players[i]->applied_potion);
-        }
-    }
+void GME_FreePotionTextures() {
     for (int i = 0; i < 4; i++) {
         if (g_PotionTextures[i] == NULL) continue;
         SDL_DestroyTexture(g_PotionTextures[i]);
         g_PotionTextures[i] = NULL;
     }
-    potion_cnt = 0;
-    potion_size = 0;
-    ELE_DestroyMap(map);
 }
 
-int GME_RetrievePlayers() {
-    memset(g_Players, 0, sizeof(g_Players));
-    const char *players_filename = "bin/data/players.bin";
-    SDL_RWops *players_file = SDL_RWFromFile(players_filename, "rb");
-    Player players[MAX_PLAYER_CNT] = {0};
-    if (players_file == NULL) {
-        LogInfo("Unable to open players data, going with the defaults");
-        // Default Players
-        g_Players[0] = ELE_CreatePlayer(0, "ArshiA", g_PlayerColors[0], 0);
-        g_Players[1] = ELE_CreatePlayer(1, "AArshiAA", g_PlayerColors[1], 0);
-        g_Players[2] = ELE_CreatePlayer(2, "AAArshiAAA", g_PlayerColors[2], 0);
-        g_Players[3] = ELE_CreatePlayer(3, "IArshiAI", g_PlayerColors[3], 0);
+int GME_MapStart(Map *map) {
+    LogInfo("Starting map...");
+    Player *players[5];
+    for (int i = 0; i < 4; i++) {
+        players[i] = g_Registry->players[i];
+    }
+    players[4] = g_CurPlayer;
+    if (map == NULL) {
+        GME_BuildRandMap();
+        g_CurMap = ELE_CreateMap(map_cnt, NULL, 0, g_Areas, GME_GetAreaCnt());
+        g_MatchSeed = RNG_Next(&g_Rng);
+        SIM_SeedMatch(g_CurMap, g_MatchSeed);
+        if (SIM_StartMatch(g_CurMap, players, 5) != 0) return -1;
     } else {
-        SDL_RWread(players_file, players, sizeof(Player), MAX_PLAYER_CNT);
-        SDL_RWclose(players_file);
-        for (int i = 0; i < MAX_PLAYER_CNT; i++) {
-            if (players[i].name[0] == 0) break;
-            g_Players[i] = ELE_CreatePlayer(
-                players[i].id, players[i].name, players[i].color,
-                players[i].score);
+        g_CurMap = map;
+        /* A resumed match goes on with the streams it was saved with */
+        if (map->players == NULL) {
+            g_MatchSeed = RNG_Next(&g_Rng);
+            SIM_SeedMatch(g_CurMap, g_MatchSeed);
+            if (SIM_StartMatch(map, players, 5) != 0) return -1;
         }
     }
-    LogInfo("Player Retrieve Done");
+    g_CurMap->human = g_CurPlayer;
+    VDO_GetWindowSize(&g_CurMap->w, &g_CurMap->h);
+    GME_LoadPotionTextures();
+    LogInfo("Map id %d", g_CurMap->id);
+    return GME_RenderGame();
+}
+
+void GME_MapQuit(Map *map) {
+    GME_FreePotionTextures();
+    ELE_DestroyMap(map);
+}
+
+int GME_RetrievePlayers() {
+    ELE_ClosePlayerDB(g_PlayerDB, g_Registry);
+    ELE_DestroyPlayerRegistry(g_Registry);
+    g_Registry = ELE_CreatePlayerRegistry();
+    g_PlayerDB = ELE_OpenPlayerDB(PLAYER_DB_FILE, g_Registry);
+    // Default Players, the first four are the opponents of every new match
+    const char *default_names[] = {"ArshiA", "AArshiAA", "AAArshiAAA", "IArshiAI"};
+    for (int i = 0; i < 4 && g_Registry->player_cnt < 4; i++) {
+        if (ELE_FindPlayerByName(g_Registry, default_names[i]) != NULL) continue;
+        int id = ELE_GetNextPlayerId(g_Registry);
+        Player *player = ELE_CreatePlayer(id, default_names[i], g_PlayerColors[id % PLAYER_COLOR_CNT], 0);
+        if (ELE_AddPlayer(g_Registry, player) == 0) ELE_AppendPlayer(g_PlayerDB, player);
+    }
+    LogInfo("Player Retrieve Done, %d players", g_Registry->player_cnt);
     return 0;
 }
 
 int GME_RetrieveMap(int id) {
-    char filename[24];
-    if (id == -1)
-        sprintf(filename, "bin/data/lastmap.bin");
-    else
-        sprintf(filename, "bin/data/map%d.bin", id);
-    SDL_RWops *file = SDL_RWFromFile(filename, "rb");
-    if (file == NULL && id != -1) {
-        sprintf(filename, "bin/data/map%d", id);
-        file = SDL_RWFromFile(filename, "rb");
+    /* lastmap may still be on its way to disk */
+    ASV_Flush();
+    Map *map = ELE_LoadMap(id, (id == -1), g_Registry);
+    if (map == NULL) return -1;
+    g_CurMap = map;
+    if (id == -1) {
+        /* Replay runs as the match did, see JRN_Resume */
+        map->human = g_CurPlayer;
+        VDO_GetWindowSize(&map->w, &map->h);
+        g_Journal = JRN_Resume(JOURNAL_FILE, "bin/data/lastmap.bin", map);
+        g_MatchSeed = (g_Journal ? g_Journal->seed : 0);
     }
-    if (file != NULL) {
-        int mapid;
-        SDL_RWread(file, &mapid, sizeof(int), 1);
-        Map *map = ELE_CreateMap(mapid, NULL, 0, NULL, 0);
-        if (id == -1) {
-            SDL_RWread(file, &map->player_cnt, sizeof(int), 1);
-            map->players = malloc(sizeof(Player*) * map->player_cnt);
-            for (int i = 0; i < map->player_cnt; i++) {
-                int player_id;
-                SDL_RWread(file, &player_id, sizeof(int), 1);
-                map->players[i] = GME_GetPlayerById(player_id);
-                SDL_RWread(file, &map->players[i]->area_cnt, sizeof(int), 1);
-                SDL_RWread(file, &map->players[i]->troop_cnt, sizeof(int), 1);
-                SDL_RWread(file, &map->players[i]->troop_rate, sizeof(int), 1);
-                SDL_RWread(file, &map->players[i]->attack_delay, sizeof(int), 1);
-                map->players[i]->area_cnt = 0;
-                map->players[i]->troop_cnt = 0;
-                int haspt;
-                SDL_RWread(file, &haspt, sizeof(int), 1);
-                if (haspt) {
-                    Potion pt;
-                    SDL_RWread(file, &pt, sizeof(Potion), 1);
-                    map->players[i]->applied_potion = ELE_CreatePotion(
-                        pt.id, pt.type, pt.frames_onmap, pt.frames_applied, pt.center
-                    );
-                }
-            }
-            SDL_RWread(file, &potion_cnt, sizeof(int), 1);
-            potion_size = potion_cnt + 1;
-            g_Potions = malloc(sizeof(Potion*) * potion_size);
-            for (int i = 0; i < potion_cnt; i++) {
-                Potion pt;
-                SDL_RWread(file, &pt, sizeof(Potion), 1);
-                if (pt.frames_onmap > 0) {
-                    g_Potions[i] = ELE_CreatePotion(
-                        pt.id, pt.type, pt.frames_onmap, pt.frames_applied, pt.center
-                    );
-                } else g_Potions[i] = NULL;
-            }
-        }
-        SDL_RWread(file, &map->area_cnt, sizeof(int), 1);
-        map->areas = malloc(sizeof(Area*) * map->area_cnt);
-        for (int i = 0; i < map->area_cnt; i++) {
-            int area_id;
-            SDL_RWread(file, &area_id, sizeof(int), 1);
-            int conq_id;
-            SDL_RWread(file, &conq_id, sizeof(int), 1);
-            int area_cap, area_tcnt, area_trate, area_tincdelay;
-            SDL_RWread(file, &area_cap, sizeof(int), 1);
-            SDL_RWread(file, &area_tcnt, sizeof(int), 1);
-            SDL_RWread(file, &area_trate, sizeof(int), 1);
-            SDL_RWread(file, &area_tincdelay, sizeof(int), 1);
-            SDL_Point area_center;
-            SDL_RWread(file, &area_center, sizeof(SDL_Point), 1);
-            int area_radius;
-            SDL_RWread(file, &area_radius, sizeof(int), 1);
-            Player *player = GME_GetPlayerById(conq_id);
-            Area *area = ELE_CreateArea(
-                area_id, (id == -1 ? player : NULL),
-                ELE_GetAreaCapacityByRadius(area_radius), area_tcnt,
-                area_trate, area_center, area_radius, NULL, 0
-            );
-            if (player) player->area_cnt++;
-            int vertex_cnt;
-            SDL_RWread(file, &vertex_cnt, sizeof(int), 1);
-            area->vertex_cnt = vertex_cnt;
-            area->vertices = malloc(sizeof(SDL_Point) * vertex_cnt);
-            for (int i = 0; i < vertex_cnt; i++) {
-                SDL_RWread(file, &area->vertices[i], sizeof(SDL_Point), 1);
-            }
-            map->areas[i] = area;
-        }
-        if (id == -1) {
-            for (int i = 0; i < map->area_cnt; i++) {
-                int att_id;
-                SDL_RWread(file, &att_id, sizeof(int), 1);
-                map->areas[i]->attack = ELE_GetAreaById(map, att_id);
-                SDL_RWread(file, &map->areas[i]->attack_delay, sizeof(int), 1);
-                SDL_RWread(file, &map->areas[i]->attack_cnt, sizeof(int), 1);
-            }
-            int troop_cnt;
-            SDL_RWread(file, &troop_cnt, sizeof(int), 1);
-            for (int i = 0; i < troop_cnt; i++) {
-                int troop_id;
-                SDL_RWread(file, &troop_id, sizeof(int), 1);
-                int player_id;
-                SDL_RWread(file, &player_id, sizeof(int), 1);
-                double x, y;
-                SDL_RWread(file, &x, sizeof(double), 1);
-                SDL_RWread(file, &y, sizeof(double), 1);
-                int src_id, dst_id;
-                SDL_RWread(file, &src_id, sizeof(int), 1);
-                SDL_RWread(file, &dst_id, sizeof(int), 1);
-                Player *player = GME_GetPlayerById(player_id);
-                Troop *troop = ELE_CreateTroop(
-                    troop_id, player, x, y,
-                    ELE_GetAreaById(map, src_id), ELE_GetAreaById(map, dst_id),
-                    NULL, NULL
-                );
-                ELE_AddTroopToMap(map, troop);
-            }
-        }
-        g_CurMap = map;
-        SDL_RWclose(file);
-    } else {
-        LogInfo("Unable to read map files");
-        return -1;
-    }
-    LogInfo("Map file read successful");
     return 0;
 }
 
 void GME_BuildRandMap() {
-    memset(g_Areas, 0, sizeof(g_Areas));
+    g_AreaCnt = 0;
     int w, h;
     VDO_GetWindowSize(&w, &h);
     int wsqcnt = 21;
@@ -808,12 +734,12 @@ void GME_BuildRandMap() {
     double PI = acos(-1);
     for (int i = 2; i < wsqcnt - 4; i += 3) {
         for (int j = 2; j < hsqcnt - 2; j += 3) {
-            if (rand() % 5 == 0) continue;
+            if (RNG_Below(&g_Rng, 5) == 0) continue;
             int wst = i * sqsize;
             int hst = j * sqsize;
             SDL_Point center;
-            center.x = rand() % sqsize + wst;
-            center.y = rand() % sqsize + hst;
+            center.x = RNG_Below(&g_Rng, sqsize) + wst;
+            center.y = RNG_Below(&g_Rng, sqsize) + hst;
             int vertex_cnt = 360;
             SDL_Point vertices[vertex_cnt];
             /* Generate vertices */
@@ -821,8 +747,8 @@ void GME_BuildRandMap() {
             double amps[wave_cnt];
             double phases[wave_cnt];
             for (int vi = 0; vi < wave_cnt; vi++) {
-                amps[vi] = rand() * 1.0 / RAND_MAX / pow(vi + 1, 1.5) * 2 * amp;
-                phases[vi] = rand() * 1.0 / RAND_MAX * 2 * PI;
+                amps[vi] = RNG_Double(&g_Rng) / pow(vi + 1, 1.5) * 2 * amp;
+                phases[vi] = RNG_Double(&g_Rng) * 2 * PI;
             }
             for (int vi = 0; vi < vertex_cnt; vi++) {
                 double alpha = 2 * PI * vi / vertex_cnt;
@@ -835,18 +761,20 @@ void GME_BuildRandMap() {
             }
             Area *area = ELE_CreateArea(
                 area_cnt,
-                NULL,
                 ELE_GetAreaCapacityByRadius(radius),
-                30,
-                30,
                 center,
                 radius,
                 vertices,
                 vertex_cnt
             );
+            if (area_cnt == g_AreaSize) {
+                g_AreaSize = SDL_max(2 * g_AreaSize, 32);
+                g_Areas = realloc(g_Areas, sizeof(Area*) * g_AreaSize);
+            }
             g_Areas[area_cnt++] = area;
         }
     }
+    g_AreaCnt = area_cnt;
     LogInfo("Random Area Generation Done");
 }
 
@@ -856,16 +784,16 @@ int GME_GenerateTestArena() {
         GME_BuildRandMap();
         area_cnt = GME_GetAreaCnt();
     } while (area_cnt < 12);
-    int opp_area = rand() % area_cnt;
+    int opp_area = RNG_Below(&g_Rng, area_cnt);
     Player *players[2];
-    players[0] = g_Players[3];
+    players[0] = g_Registry->players[3];
     players[1] = g_CurPlayer;
     g_CurMap = ELE_CreateMap(map_cnt, players, 2, g_Areas, area_cnt);
     for (int i = 0; i < g_CurMap->area_cnt; i++) {
         if (i == opp_area) {
-            ELE_AreaConquer(g_CurMap->areas[i], g_CurMap->players[0]);
+            ELE_AreaConquer(g_CurMap, i, 0);
         } else {
-            ELE_AreaConquer(g_CurMap->areas[i], g_CurMap->players[1]);
+            ELE_AreaConquer(g_CurMap, i, 1);
         }
     }
     return 0;
@@ -875,46 +803,114 @@ SDL_Color GME_ChangeAlpha(SDL_Color color, Uint8 alpha) {
     return (SDL_Color){color.r, color.g, color.b, alpha};
 }
 
-void GME_Move(double x, double y, double size, int sx, int sy, int dx, int dy, double *nx, double *ny) {
-    double PI = acos(-1), theta;
-    if (sx != dx) {
-        theta = atan(1.0 * (sy - dy) / (sx - dx));
-    } else {
-        theta = (sy < dy ? PI / 2 : -PI / 2);
-    }
-    if (sx > dx) theta += PI;
-    double sinus = sin(theta);
-    double cosinus = cos(theta);
-    *nx = x + size * cosinus, *ny = y + size * sinus;
+/* Player who conquered the area at index area, NULL for none */
+Player* GME_GetConqueror(Map *map, int area) {
+    if (area < 0 || map->area_states[area].conqueror < 0) return NULL;
+    return map->players[map->area_states[area].conqueror];
 }
 
-void GME_Move2(double x, double y, double size, double theta, double *nx, double *ny) {
-    double sinus = sin(theta);
-    double cosinus = cos(theta);
-    *nx = x + size * cosinus, *ny = y + size * sinus;
+/* Players, areas, potions and troops, drawn alpha of the way into the last tick */
+void GME_DrawMatch(Map *map, Area *selected, double alpha, TXT_Font *font) {
+    int w, h;
+    VDO_GetWindowSize(&w, &h);
+    SDL_Renderer *renderer = VDO_GetRenderer();
+    Area **areas = map->areas;
+    boxRGBA(renderer, 0, 0, w, h, RGBAColor(g_BackgroundColor));
+    // Render Player names
+    PRF_Begin(PRF_DRAW_PANEL);
+    for (int i = 0; i < map->player_cnt; i++) {
+        Player *player = map->players[i];
+        PlayerState *state = &map->player_states[i];
+        int x1 = w - 220, y1 = h - 90 - 80 * i;
+        int x2 = w - 20, y2 = h - 20 - 80 * i;
+        int in_game = (state->troop_cnt + state->area_cnt > 0);
+        if (in_game && state->potion.type != POTION_NONE) {
+            roundedBoxRGBA(renderer, x1 - 5, y1 - 5, x2 + 5, y2 + 5, 10,
+                RGBAColor(g_PotionColors[state->potion.type]));
+            roundedBoxRGBA(renderer, x1, y1, x2, y2, 10, RGBAColor(g_BackgroundColor));
+        }
+        roundedBoxRGBA(renderer, x1, y1, x2, y2, 10,
+            RGBAColor(GME_ChangeAlpha(g_GreyColor, (in_game ? 100 : 20))));
+        TXT_Write(renderer, font, player->name, GME_ChangeAlpha(g_LightBlackColor, (in_game ? 255 : 155)),
+            (x1 + x2) / 2, y1 + 20);
+        int width = x2 - x1 - 40;
+        width = 1.0 * width * state->area_cnt / ELE_GetMapAreaCntSum(map);
+        roundedBoxRGBA(renderer, x1 + 20, y2 - 25, x1 + 20 + width, y2 - 20, 2,
+            RGBAColor(player->color));
+    }
+    PRF_End(PRF_DRAW_PANEL);
+    // Render Areas
+    PRF_Begin(PRF_DRAW_AREAS);
+    for (int i = 0; i < map->area_cnt; i++) {
+        int area_shield = ELE_GetAreaAppliedPotionType(map, i) == AREA_SHIELD;
+        int beyond_cap = ELE_GetAreaAppliedPotionType(map, i) == AREA_BEYOND_CAPACITY;
+        Player *conqueror = GME_GetConqueror(map, i);
+        ELE_ColorArea(areas[i], (areas[i] == selected ? g_BlueColor :
+            (area_shield ? g_PotionColors[AREA_SHIELD] : 
+            (beyond_cap ? g_PotionColors[AREA_BEYOND_CAPACITY] : g_BackgroundColor))),
+            (conqueror ? conqueror->color : g_GreyColor),
+            (areas[i] == selected ? 5 :
+            (area_shield | beyond_cap ? 4 : 2)));
+        filledCircleRGBA(renderer, areas[i]->center.x, areas[i]->center.y, 16,
+            245, 245, 245, 255);
+    }
+    PRF_End(PRF_DRAW_AREAS);
+    PRF_Begin(PRF_DRAW_TEXT);
+    for (int i = 0; i < map->area_cnt; i++) {
+        TXT_WriteInt(renderer, font, map->area_states[i].troop_cnt, g_BlackColor,
+            areas[i]->center.x, areas[i]->center.y + 25);
+    }
+    PRF_End(PRF_DRAW_TEXT);
+    // Render Potion
+    PRF_Begin(PRF_DRAW_POTIONS);
+    for (int i = 0; i < map->potion_cnt; i++) {
+        if (map->potions[i].type != POTION_NONE) {
+            SDL_Texture *potion_texture = g_PotionTextures[map->potions[i].type];
+            SDL_Point center = map->potions[i].center;
+            int w, h;
+            SDL_QueryTexture(potion_texture, NULL, NULL, &w, &h);
+            SDL_Rect src = {0, 0, w, h};
+            SDL_Rect dst = {center.x - 30, center.y - 30, 60, 60};
+            SDL_RenderCopy(renderer, potion_texture, &src, &dst);
+        }
+    }
+    PRF_End(PRF_DRAW_POTIONS);
+    // Render Troops
+    PRF_Begin(PRF_DRAW_TROOPS);
+    TroopStore *troops = map->troops;
+    for (int i = 0; i < troops->cnt; i++) {
+        SDL_Color color = map->players[troops->owner[i]]->color;
+        double x = (troops->prev_x[i] + (troops->x[i] - troops->prev_x[i]) * alpha) / FIXED_ONE;
+        double y = (troops->prev_y[i] + (troops->y[i] - troops->prev_y[i]) * alpha) / FIXED_ONE;
+        filledCircleRGBA(renderer, x, y, 6, RGBAColor(g_BackgroundColor));
+        filledCircleRGBA(renderer, x, y, 5, RGBAColor(color));
+    }
+    PRF_End(PRF_DRAW_TROOPS);
 }
 
-int GME_PutRandomPotion() {
-    int type = rand() % 4;
-    SDL_Point center;
-    int area_cnt = g_CurMap->area_cnt;
-    SDL_assert(area_cnt > 0);
-    int from = rand() % area_cnt;
-    int to = rand() % area_cnt;
-    Area *src = g_CurMap->areas[from], *dst = g_CurMap->areas[to];
-    center.x = src->center.x; center.y = src->center.y;
-    int size = rand() % SDL_max(abs(src->center.x - dst->center.x) + 1, abs(src->center.y - dst->center.y) + 1);
-    double X, Y;
-    GME_Move(center.x, center.y, size, src->center.x, src->center.y,
-        dst->center.x, dst->center.y, &X, &Y);
-    center.x = X; center.y = Y;
-    g_Potions[potion_cnt] = ELE_CreatePotion(potion_cnt, type, 1500, 1500, center);
-    ++potion_cnt;
-    if (potion_cnt == potion_size) {
-        potion_size *= 2;
-        g_Potions = realloc(g_Potions, sizeof(Potion*) * potion_size);
+#ifdef PRF_ENABLED
+/* p50 and p99 of every phase over the last frames, in the top left corner */
+void GME_DrawProfile(TXT_Font *font) {
+    PRF_Begin(PRF_OVERLAY);
+    SDL_Renderer *renderer = VDO_GetRenderer();
+    PRF_PhaseStats stats[PRF_PHASE_CNT];
+    int frame_cnt = PRF_GetStats(stats);
+    int line_h = 20, x = 20, y = 20;
+    boxRGBA(renderer, x - 10, y - 10, x + 330, y + line_h * (PRF_PHASE_CNT + 1) + 10,
+        RGBAColor(GME_ChangeAlpha(g_WhiteColor, 220)));
+    char label[24], buffer[64];
+    /* Lines are as wide as each other, so writing them centered lines them up */
+    sprintf(label, "last %d frames", frame_cnt);
+    sprintf(buffer, "%-16s %5s %5s us", label, "p50", "p99");
+    TXT_Write(renderer, font, buffer, g_BlackColor, x + TXT_GetWidth(font, buffer) / 2, y + line_h / 2);
+    for (int i = 0; i < PRF_PHASE_CNT; i++) {
+        sprintf(buffer, "%-16.16s %5.0f %5.0f   ", stats[i].name, stats[i].p50, stats[i].p99);
+        TXT_Write(renderer, font, buffer, (i == PRF_FRAME ? g_BlueColor : g_LightBlackColor),
+            x + TXT_GetWidth(font, buffer) / 2, y + line_h * (i + 1) + line_h / 2);
     }
+    PRF_End(PRF_OVERLAY);
 }
+#endif
 
 int GME_RenderGame() {
     LogInfo("Start Render Game");
@@ -931,32 +927,59 @@ int GME_RenderGame() {
     Player *player = g_CurPlayer;
     Area **areas = map->areas;
     Area *selected = NULL;
-    TTF_Font *font = TTF_OpenFont("bin/fonts/SourceCodeProBold.ttf", 18);
-    TTF_Font *font_big = TTF_OpenFont("bin/fonts/SourceCodePro.ttf", 24);
-    int troop_cnt = 0;
-    int frame = 0;
+    TXT_Font *font = TXT_GetFont("bin/fonts/SourceCodeProBold.ttf", 18);
+    TXT_Font *font_big = TXT_GetFont("bin/fonts/SourceCodePro.ttf", 24);
     int sdl_quit = 0;
     Player *winner = NULL;
+    SIM_Command cmds[SIM_MAX_TICK_CMDS];
+    int cmd_cnt = 0;
+    /* Simulation time not run yet, in performance counter units */
+    Uint64 tick_time = SDL_GetPerformanceFrequency() / SIM_TICK_RATE;
+    Uint64 last_time = SDL_GetPerformanceCounter(), lag = 0;
+    /* Checkpoints every g_AutosaveInterval seconds with the commands in between journaled */
+    JRN_Journal *journal = g_Journal;
+    g_Journal = NULL;
+    /* A resumed journal has the players it was commanding set already */
+    if (journal == NULL) {
+        map->commanded = 0;
+        for (int i = 0; i < map->player_cnt && g_AIPolicy != NULL; i++) {
+            if (map->players[i] != map->human) map->commanded |= 1u << i;
+        }
+    }
+    AI_Pool *pool = NULL;
+    if (map->commanded != 0) {
+        int worker_cnt = SDL_max(1, SDL_GetCPUCount() - 1);
+        /* A resumed match keeps its policy players even when new ones don't get one */
+        pool = AI_CreatePool((g_AIPolicy ? g_AIPolicy : &AI_LookaheadPolicy), map, worker_cnt, g_AIBudget);
+    }
+    if (g_AutosaveInterval > 0) {
+        if (journal == NULL) journal = JRN_Create(JOURNAL_FILE, map, g_MatchSeed);
+        if (journal != NULL) JRN_Checkpoint(journal, map, "bin/data/lastmap.bin");
+    } else {
+        JRN_Close(journal, map);
+        journal = NULL;
+    }
+    Uint32 last_autosave = SDL_GetTicks();
+    RPL_Recorder *recorder = RPL_StartRecording(REPLAY_FILE, map, g_MatchSeed);
+    TLM_Telemetry *telemetry = TLM_Start(map, g_MatchSeed);
     while (!quit) {
         // Check Win
-        int players = 0;
-        for (int i = 0; i < map->player_cnt; i++) {
-            if (map->players[i]->troop_cnt + map->players[i]->area_cnt != 0) {
-                winner = map->players[i];
-                ++players;
-            }
-        }
-        if (players == 1) {
-            break;
-        } else {
-            winner = NULL;
-        }
-        ++frame;
-        if (selected != NULL && selected->conqueror != g_CurPlayer) selected = NULL;
+        winner = SIM_GetWinner(map);
+        if (winner != NULL) break;
+        if (selected != NULL && GME_GetConqueror(map, ELE_GetAreaIndex(map, selected)) != g_CurPlayer)
+            selected = NULL;
+        PRF_Begin(PRF_INPUT);
         while (SDL_PollEvent(&e) != 0) {
+            TXT_HandleRenderReset(&e);
             if (e.type == SDL_QUIT) {
                 quit = 1;
                 sdl_quit = 1;
+            } else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3) {
+                g_ShowProfile = !g_ShowProfile;
+            } else if (e.type == SDL_RENDER_DEVICE_RESET ||
+                (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)) {
+                /* Area sprites are rebuilt on next draw */
+                for (int i = 0; i < map->area_cnt; i++) ELE_DestroyAreaSprite(areas[i]);
             } else if (e.type == SDL_MOUSEBUTTONDOWN) {
                 int x, y;
                 SDL_GetMouseState(&x, &y);
@@ -967,161 +990,61 @@ int GME_RenderGame() {
                 }
                 if (save_btn.x <= x && x <= save_btn.x + save_btn.w &&
                     save_btn.y <= y && y <= save_btn.y + save_btn.h) {
+                    char filename[24];
                     map->id = map_cnt++;
-                    ELE_SaveMap(map, 0, NULL, 0);
+                    sprintf(filename, "bin/data/map%d.bin", map->id);
+                    if (ASV_Save(map, filename, MAP_FILE_PACKED, 1) == 0) g_CatalogStale = 1;
                 }
-                for (int i = 0; i < map->area_cnt; i++) {
-                    if (abs(x - areas[i]->center.x) + abs(y - areas[i]->center.y) < 25) {
-                        if (selected == NULL && areas[i]->conqueror == player) {
-                            selected = areas[i];
-                        } else if (selected == areas[i]) {
-                            selected = NULL;
-                        } else if (selected != NULL) {
-                            if (ELE_GetAreaAppliedPotionType(areas[i]) == AREA_SHIELD &&
-                                areas[i]->conqueror != selected->conqueror)
-                                break;
-                            ELE_AreaAttack(selected, areas[i]);
-                            selected = NULL;
-                        }
-                        break;
+                int i = ELE_GetAreaAt(map, x, y, AREA_PICK_DIST);
+                if (i < 0) continue;
+                if (selected == NULL && GME_GetConqueror(map, i) == player) {
+                    selected = areas[i];
+                } else if (selected == areas[i]) {
+                    selected = NULL;
+                } else if (selected != NULL) {
+                    if (ELE_GetAreaAppliedPotionType(map, i) == AREA_SHIELD &&
+                        GME_GetConqueror(map, i) != GME_GetConqueror(map, ELE_GetAreaIndex(map, selected)))
+                        continue;
+                    if (cmd_cnt < SIM_MAX_TICK_CMDS) {
+                        cmds[cmd_cnt++] = (SIM_Command){
+                            SIM_CMD_ATTACK, player->id, selected->id, areas[i]->id
+                        };
                     }
+                    selected = NULL;
                 }
             }
         }
-        boxRGBA(renderer, 0, 0, w, h, RGBAColor(g_BackgroundColor));
-        // Render Player names
-        int freeze_is_applied = 0;
-        for (int i = 0; i < map->player_cnt; i++) {
-            Player *player = map->players[i];
-            int x1 = w - 220, y1 = h - 90 - 80 * i;
-            int x2 = w - 20, y2 = h - 20 - 80 * i;
-            int in_game = (player->troop_cnt + player->area_cnt > 0);
-            if (in_game && player->applied_potion != NULL) {
-                roundedBoxRGBA(renderer, x1 - 5, y1 - 5, x2 + 5, y2 + 5, 10,
-                    RGBAColor(g_PotionColors[player->applied_potion->type]));
-                roundedBoxRGBA(renderer, x1, y1, x2, y2, 10, RGBAColor(g_BackgroundColor));
-            }
-            roundedBoxRGBA(renderer, x1, y1, x2, y2, 10,
-                RGBAColor(GME_ChangeAlpha(g_GreyColor, (in_game ? 100 : 20))));
-            GME_WriteTTF(renderer, font, player->name, GME_ChangeAlpha(g_LightBlackColor, (in_game ? 255 : 155)),
-                (x1 + x2) / 2, y1 + 20);
-            int width = x2 - x1 - 40;
-            width = 1.0 * width * player->area_cnt / ELE_GetMapAreaCntSum(map);
-            roundedBoxRGBA(renderer, x1 + 20, y2 - 25, x1 + 20 + width, y2 - 20, 2,
-                RGBAColor(player->color));
-            // Player applied potion
-            if (player->applied_potion != NULL) {
-                if (player->applied_potion->frames_applied <= 0) {
-                    ELE_DestroyPotion(player->applied_potion);
-                    player->applied_potion = NULL;
-                } else {
-                    --player->applied_potion->frames_applied;
-                }
-            }
-            if (player->applied_potion != NULL) {
-                freeze_is_applied |= (player->applied_potion->type == TROOP_FREEZE_OTHERS);
-            }
-        }
-        // Render Areas
-        for (int i = 0; i < map->area_cnt; i++) {
-            if (areas[i]->troop_inc_delay > 0) --areas[i]->troop_inc_delay;
-            if (frame % areas[i]->troop_rate == 0 /* && areas[i]->attack == NULL  */&&
-                areas[i]->conqueror != NULL && areas[i]->troop_inc_delay == 0 &&
-                (areas[i]->troop_cnt < areas[i]->capacity ||
-                    (ELE_GetAreaAppliedPotionType(areas[i]) == AREA_BEYOND_CAPACITY))) {
-                ++areas[i]->troop_cnt;
+        PRF_End(PRF_INPUT);
+        // Simulation, commands wait for the next tick
+        Uint64 now = SDL_GetPerformanceCounter();
+        lag += (now - last_time) * g_Speed;
+        last_time = now;
+        lag = SDL_min(lag, (Uint64)MAX_CATCHUP_TICKS * g_Speed * tick_time);
+        while (lag >= tick_time) {
+            lag -= tick_time;
+            ELE_SaveTroopPositions(map->troops);
+            if (pool != NULL) {
+                PRF_Begin(PRF_AI);
+                cmd_cnt += AI_Update(pool, map, cmds + cmd_cnt, SIM_MAX_TICK_CMDS - cmd_cnt);
+                PRF_End(PRF_AI);
             }
-            if (areas[i]->troop_cnt <= 0) {
-                areas[i]->troop_cnt = 0;
-                areas[i]->attack_cnt = 0;
-            }
-            if (areas[i]->attack_cnt == 0) ELE_AreaUnAttack(areas[i]);
-            if (areas[i]->attack != NULL) {
-                if (freeze_is_applied && ELE_GetAreaAppliedPotionType(areas[i]) != TROOP_FREEZE_OTHERS)
-                    ;
-                else if (areas[i]->attack_delay > 0) {
-                    areas[i]->attack_delay -= (ELE_GetAreaAppliedPotionType(areas[i]) == TROOP_SPEED_X2 ? 2 : 1);
-                }
-                else if (areas[i]->attack_cnt > 0) {
-                    for (int it = 0; it < 5; it++) {
-                        if (areas[i]->attack_cnt == 0) {
-                            ELE_AreaUnAttack(areas[i]);
-                            break;
-                        }
-                        areas[i]->troop_cnt--;
-                        areas[i]->attack_cnt--;
-                        int sx = areas[i]->center.x, sy = areas[i]->center.y;
-                        int dx = areas[i]->attack->center.x, dy = areas[i]->attack->center.y;
-                        double x, y;
-                        GME_Move(sx, sy, 10, sx, sy, dx, dy, &x, &y);
-                        double vert_theta, PI = acos(-1);
-                        if (sy != dy) {
-                            vert_theta = SDL_atan(-1.0 * (sx - dx) / (sy - dy));
-                        } else {
-                            vert_theta = (sx > dx ? PI / 2 : -PI / 2);
-                        }
-                        if (sy < dy) vert_theta += PI;
-                        if (it == 0) GME_Move2(x, y, 22, vert_theta, &x, &y);
-                        if (it == 1) GME_Move2(x, y, 11, vert_theta, &x, &y);
-                        if (it == 3) GME_Move2(x, y, 11, vert_theta + PI, &x, &y);
-                        if (it == 4) GME_Move2(x, y, 22, vert_theta + PI, &x, &y);
-                        Troop *troop = ELE_CreateTroop(troop_cnt++, areas[i]->conqueror, x, y, areas[i], areas[i]->attack, NULL, NULL);
-                        ELE_AddTroopToMap(map, troop);
-                    }
-                    areas[i]->attack_delay = 25;
-                }
-            }
-            int area_shield = ELE_GetAreaAppliedPotionType(areas[i]) == AREA_SHIELD;
-            int beyond_cap = ELE_GetAreaAppliedPotionType(areas[i]) == AREA_BEYOND_CAPACITY;
-            ELE_ColorArea(areas[i], (areas[i] == selected ? g_BlueColor :
-                (area_shield ? g_PotionColors[AREA_SHIELD] : 
-                (beyond_cap ? g_PotionColors[AREA_BEYOND_CAPACITY] : g_BackgroundColor))),
-                (areas[i]->conqueror ? areas[i]->conqueror->color : g_GreyColor),
-                (areas[i] == selected ? 5 :
-                (area_shield | beyond_cap ? 4 : 2)));
-            filledCircleRGBA(renderer, areas[i]->center.x, areas[i]->center.y, 16,
-                245, 245, 245, 255);
-        }
-        for (int i = 0; i < map->area_cnt; i++) {
-            char buffer[5];
-            sprintf(buffer, "%d", areas[i]->troop_cnt);
-            GME_WriteTTF(renderer, font, buffer, g_BlackColor,
-                areas[i]->center.x, areas[i]->center.y + 25);
+            SIM_Step(map, cmds, cmd_cnt);
+            if (journal != NULL) JRN_Record(journal, map, cmds, cmd_cnt);
+            if (recorder != NULL) RPL_RecordTick(recorder, map, cmds, cmd_cnt);
+            if (telemetry != NULL) TLM_RecordTick(telemetry, map);
+            cmd_cnt = 0;
+            if (SIM_GetWinner(map) != NULL) break;
         }
-        // Render Potion
-        if (rand() % 2400 == 0) {
-            GME_PutRandomPotion();
-        }
-        for (int i = 0; i < potion_cnt; i++) {
-            if (g_Potions[i] != NULL) {
-                if (g_Potions[i]->frames_onmap <= 0) {
-                    ELE_DestroyPotion(g_Potions[i]);
-                    g_Potions[i] = NULL;
-                    continue;
-                }
-                --g_Potions[i]->frames_onmap;
-                SDL_Texture *potion_texture = g_PotionTextures[g_Potions[i]->type];
-                SDL_Point center = g_Potions[i]->center;
-                int w, h;
-                SDL_QueryTexture(potion_texture, NULL, NULL, &w, &h);
-                SDL_Rect src = {0, 0, w, h};
-                SDL_Rect dst = {center.x - 30, center.y - 30, 60, 60};
-                SDL_RenderCopy(renderer, potion_texture, &src, &dst);
+        if (journal != NULL) {
+            if (SDL_GetTicks() - last_autosave >= (Uint32)g_AutosaveInterval * 1000) {
+                JRN_Checkpoint(journal, map, "bin/data/lastmap.bin");
+                last_autosave = SDL_GetTicks();
             }
+            JRN_Sync(journal, map);
         }
-        // Render Troops
-        for (Troop *troop = map->troops_head; troop != NULL; troop = troop->next) {
-            double size = 0.5;
-            if (troop->player->applied_potion != NULL &&
-                troop->player->applied_potion->type == TROOP_SPEED_X2)
-                size = 1;
-            if (!freeze_is_applied ||
-                (troop->player->applied_potion != NULL &&
-                troop->player->applied_potion->type == TROOP_FREEZE_OTHERS))
-                GME_Move(troop->x, troop->y, size, troop->sx, troop->sy, troop->dx, troop->dy, &troop->x, &troop->y);
-            filledCircleRGBA(renderer, troop->x, troop->y, 6, RGBAColor(g_BackgroundColor));
-            filledCircleRGBA(renderer, troop->x, troop->y, 5, RGBAColor(troop->player->color));
-        }
+        /* How far troops are drawn between their last two positions */
+        double alpha = SDL_min(1.0 * lag / tick_time, 1.0);
+        GME_DrawMatch(map, selected, alpha, font);
         roundedBoxRGBA(renderer, back_btn.x, back_btn.y, back_btn.x + back_btn.w,
             back_btn.y + back_btn.h, 10, RGBAColor(g_GreyColor));
         filledTrigonRGBA(renderer, back_btn.x + 20, back_btn.y + back_btn.h / 2,
@@ -1130,80 +1053,44 @@ int GME_RenderGame() {
             RGBAColor(g_BackgroundColor));
         roundedBoxRGBA(renderer, save_btn.x, save_btn.y, save_btn.x + save_btn.w,
             save_btn.y + save_btn.h, 10, RGBAColor(g_GreyColor));
-        GME_WriteTTF(renderer, font_big, "Save Map", g_WhiteColor,
+        TXT_Write(renderer, font_big, "Save Map", g_WhiteColor,
             save_btn.x + save_btn.w / 2, save_btn.y + save_btn.h / 2);
-        ELE_HandleCollisions(map);
-        for (int i = 0; i < potion_cnt; i++) {
-            if (g_Potions[i] == NULL) continue;
-            for (Troop *troop = map->troops_head; troop != NULL; troop = troop->next) {
-                if (troop->player->applied_potion != NULL) continue;
-                SDL_Point X = g_Potions[i]->center;
-                SDL_Point Y = {troop->x, troop->y};
-                if (abs(X.x - Y.x) + abs(X.y - Y.y) < 40) {
-                    troop->player->applied_potion = g_Potions[i];
-                    g_Potions[i] = NULL;
-                    break;
-                }
-            }
-        }
-        // AI
-        for (int i = 0; i < map->player_cnt; i++) {
-            if (map->players[i] == g_CurPlayer || map->players[i]->area_cnt == 0) continue;
-            if (map->players[i]->attack_delay) {
-                --map->players[i]->attack_delay;
-                continue;
-            }
-            if (rand() % 240) continue;
-            Player *player = map->players[i];
-            int from = rand() % player->area_cnt;
-            int to = rand() % map->area_cnt;
-            Area *src = NULL, *dst = NULL;
-            for (int i = 0; i < map->area_cnt; i++) {
-                if (map->areas[i]->conqueror == player) {
-                    if (from == 0) {
-                        src = map->areas[i];
-                        break;
-                    } else {
-                        --from;
-                    }
-                }
-            }
-            dst = map->areas[to];
-            for (int i = 0; i < 10; i++) {
-                if (dst == src ||
-                    (ELE_GetAreaAppliedPotionType(dst) == AREA_SHIELD &&
-                    dst->conqueror != src->conqueror)) {
-                    to = rand() % map->area_cnt;
-                    dst = map->areas[to];
-                } else {
-                    break;
-                }
-            }
-            ELE_AreaAttack(src, dst);
-            player->attack_delay = 60;
-        }
-        SDL_RenderPresent(renderer);
+#ifdef PRF_ENABLED
+        if (g_ShowProfile) GME_DrawProfile(font);
+#endif
+        VDO_Present();
     }
     LogInfo("Quiting game rendering");
-    TTF_CloseFont(font);
-    TTF_CloseFont(font_big);
+    AI_DestroyPool(pool);
+    RPL_StopRecording(recorder);
+    if (telemetry != NULL) TLM_Write(telemetry, TELEMETRY_FILE);
+    TLM_Destroy(telemetry);
+    int journaled = (journal != NULL);
+    if (winner == NULL && !sdl_quit) {
+        if (journaled) JRN_Checkpoint(journal, map, "bin/data/lastmap.bin");
+        else ASV_Save(map, "bin/data/lastmap.bin", MAP_FILE_MATCH | MAP_FILE_PACKED, 0);
+    }
+    /* On quit the journal alone carries the match since the last checkpoint */
+    JRN_Close(journal, map);
     if (sdl_quit) return 1;
-    if (winner == NULL) {
-        ELE_SaveMap(map, 1, g_Potions, potion_cnt);
-        return 0;
+    if (winner == NULL) return 0;
+    if (journaled) {
+        /* Not a match to continue anymore */
+        ASV_Flush();
+        remove("bin/data/lastmap.bin");
+        remove(JOURNAL_FILE);
     }
+    SIM_ScoreMatch(map, winner);
     for (int i = 0; i < map->player_cnt; i++) {
-        if (map->players[i] == winner) {
-            map->players[i]->score += map->player_cnt - 1;
-        } else {
-            map->players[i]->score -= 1;
-        }
+        ELE_RankPlayer(g_Registry, map->players[i]);
+        ELE_AppendPlayer(g_PlayerDB, map->players[i]);
     }
     quit = 0;
     sdl_quit = 0;
-    font = TTF_OpenFont("bin/fonts/SourceCodeProBold.ttf", 28);
+    font = TXT_GetFont("bin/fonts/SourceCodeProBold.ttf", 28);
     while (!quit) {
         while (SDL_PollEvent(&e) != 0) {
+            TXT_HandleRenderReset(&e);
             if (e.type == SDL_QUIT) {
                 quit = 1;
                 sdl_quit = 1;
@@ -1220,16 +1107,127 @@ int GME_RenderGame() {
         boxRGBA(renderer, 0, 0, w, h, RGBAColor(g_BackgroundColor));
         char buffer[50];
         sprintf(buffer, "%s won the game", winner->name);
-        GME_WriteTTF(renderer, font, buffer, g_BlackColor, w / 2, h / 2);
+        TXT_Write(renderer, font, buffer, g_BlackColor, w / 2, h / 2);
         roundedBoxRGBA(renderer, back_btn.x, back_btn.y, back_btn.x + back_btn.w,
             back_btn.y + back_btn.h, 10, RGBAColor(g_GreyColor));
         filledTrigonRGBA(renderer, back_btn.x + 20, back_btn.y + back_btn.h / 2,
             back_btn.x + back_btn.w - 20, back_btn.y + 15,
             back_btn.x + back_btn.w - 20, back_btn.y + back_btn.h - 15,
             RGBAColor(g_BackgroundColor));
-        SDL_RenderPresent(renderer);
+        VDO_Present();
     }
-    TTF_CloseFont(font);
     if (sdl_quit) return 1;
     return 0;
+}
+
+/*
+ * Plays filename back at 1x, 4x or 16x on keys 1 to 3. Left and right
+ * seek REPLAY_SEEK_SECONDS from the keyframe before, space pauses.
+ */
+int GME_WatchReplay(const char *filename) {
+    if (GME_RetrievePlayers() != 0) return -1;
+    RPL_Replay *replay = RPL_LoadReplay(filename);
+    if (replay == NULL) return -1;
+    /* Copies of the replay's players, those of another game stood in for */
+    PlayerRegistry *players = ELE_CreatePlayerRegistry();
+    for (int i = 0; i < replay->player_cnt; i++) {
+        int id = replay->player_ids[i];
+        Player *player = GME_GetPlayerById(id);
+        if (player != NULL) {
+            player = ELE_CreatePlayer(id, player->name, player->color, player->score);
+        } else {
+            char name[16];
+            sprintf(name, "Player %d", id);
+            player = ELE_CreatePlayer(id, name, g_PlayerColors[i % PLAYER_COLOR_CNT], 0);
+        }
+        if (ELE_AddPlayer(players, player) != 0) ELE_DestroyPlayer(player);
+    }
+    Map *map = RPL_Seek(replay, replay->first_frame, players);
+    int quit = (map == NULL), sdl_quit = 0;
+    int w, h;
+    VDO_GetWindowSize(&w, &h);
+    SDL_Renderer *renderer = VDO_GetRenderer();
+    SDL_Event e;
+    int back_btn_sz = 70;
+    SDL_Rect back_btn = {30, h - 25 - back_btn_sz, back_btn_sz, back_btn_sz};
+    TXT_Font *font = TXT_GetFont("bin/fonts/SourceCodeProBold.ttf", 18);
+    TXT_Font *font_big = TXT_GetFont("bin/fonts/SourceCodePro.ttf", 24);
+    GME_LoadPotionTextures();
+    int speed = 1, paused = 0, diverged = -1;
+    Uint64 tick_time = SDL_GetPerformanceFrequency() / SIM_TICK_RATE;
+    Uint64 last_time = SDL_GetPerformanceCounter(), lag = 0;
+    while (!quit) {
+        int seek = map->frame, seeking = 0;
+        while (SDL_PollEvent(&e) != 0) {
+            TXT_HandleRenderReset(&e);
+            if (e.type == SDL_QUIT) {
+                quit = sdl_quit = 1;
+            } else if (e.type == SDL_RENDER_DEVICE_RESET ||
+                (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)) {
+                for (int i = 0; i < map->area_cnt; i++) ELE_DestroyAreaSprite(map->areas[i]);
+            } else if (e.type == SDL_KEYDOWN) {
+                SDL_Keycode key = e.key.keysym.sym;
+                if (key == SDLK_1) speed = 1;
+                if (key == SDLK_2) speed = 4;
+                if (key == SDLK_3) speed = 16;
+                if (key == SDLK_SPACE) paused = !paused;
+                if (key == SDLK_LEFT || key == SDLK_RIGHT) {
+                    seek += (key == SDLK_LEFT ? -1 : 1) * REPLAY_SEEK_SECONDS * SIM_TICK_RATE;
+                    seeking = 1;
+                }
+                if (key == SDLK_ESCAPE) quit = 1;
+            } else if (e.type == SDL_MOUSEBUTTONDOWN) {
+                int x, y;
+                SDL_GetMouseState(&x, &y);
+                if (back_btn.x <= x && x <= back_btn.x + back_btn.w &&
+                    back_btn.y <= y && y <= back_btn.y + back_btn.h) quit = 1;
+            }
+        }
+        if (seeking) {
+            Map *seeked = RPL_Seek(replay, seek, players);
+            if (seeked != NULL) {
+                ELE_DestroyMap(map);
+                map = seeked;
+                lag = 0;
+            }
+        }
+        // Playback, at most MAX_CATCHUP_TICKS of lag like the game
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (!paused) lag += (now - last_time) * speed;
+        last_time = now;
+        lag = SDL_min(lag, (Uint64)MAX_CATCHUP_TICKS * speed * tick_time);
+        while (lag >= tick_time) {
+            lag -= tick_time;
+            ELE_SaveTroopPositions(map->troops);
+            int result = RPL_Step(replay, map);
+            if (result == 1 && diverged < 0) diverged = map->frame;
+            if (result == -1) {
+                lag = 0;
+                break;
+            }
+        }
+        double alpha = SDL_min(1.0 * lag / tick_time, 1.0);
+        GME_DrawMatch(map, NULL, alpha, font);
+        char buffer[64];
+        sprintf(buffer, "%s x%d  %d:%02d / %d:%02d", (paused ? "paused" : "playing"), speed,
+            map->frame / SIM_TICK_RATE / 60, map->frame / SIM_TICK_RATE % 60,
+            replay->last_frame / SIM_TICK_RATE / 60, replay->last_frame / SIM_TICK_RATE % 60);
+        TXT_Write(renderer, font_big, buffer, g_LightBlackColor, w / 2, h - 60);
+        if (diverged >= 0) {
+            sprintf(buffer, "Diverged from the recording at frame %d", diverged);
+            TXT_Write(renderer, font, buffer, g_BlackColor, w / 2, h - 30);
+        }
+        roundedBoxRGBA(renderer, back_btn.x, back_btn.y, back_btn.x + back_btn.w,
+            back_btn.y + back_btn.h, 10, RGBAColor(g_GreyColor));
+        filledTrigonRGBA(renderer, back_btn.x + 20, back_btn.y + back_btn.h / 2,
+            back_btn.x + back_btn.w - 20, back_btn.y + 15,
+            back_btn.x + back_btn.w - 20, back_btn.y + back_btn.h - 15,
+            RGBAColor(g_BackgroundColor));
+        VDO_Present();
+    }
+    GME_FreePotionTextures();
+    ELE_DestroyMap(map);
+    ELE_DestroyPlayerRegistry(players);
+    RPL_DestroyReplay(replay);
+    return sdl_quit;
 }
\ No newline at end of file
@@ -6,6 +6,12 @@
 #include "elems/map.h"
 
 extern int GME_Init(void);
+extern void GME_SetSeed(Uint64 seed);
+extern void GME_SetSpeed(int speed);
+extern void GME_SetAutosave(int seconds);
+extern void GME_SetAI(const char *name);
+extern void GME_SetAIBudget(int us);
+extern void GME_SetTrace(const char *filename);
 extern void GME_Quit(void);
 extern int GME_Start(void);
 
@@ -19,9 +25,6 @@ extern int GME_GetAreaCnt(void);
 
 extern int GME_GetCurPlayer(void);
 
-extern int GME_WriteTTF(SDL_Renderer *renderer, TTF_Font *font, const char *s, SDL_Color color,
-        int x, int y);
-
 extern int GME_MapStart(Map *map);
 extern void GME_MapQuit(Map *map);
 
@@ -32,5 +35,6 @@ extern int GME_GenerateTestArena(void);
 extern void GME_BuildRandMap(void);
 
 extern int GME_RenderGame(void);
+extern int GME_WatchReplay(const char *filename);
 
 #endif /* _GAME_H */
\ No newline at end of file
@@ -0,0 +1,258 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "journal.h"
+#include "autosave.h"
+#include "log.h"
+#include "elems/mapfile.h"
+
+const char JOURNAL_MAGIC[4] = {'S', 'I', 'O', 'J'};
+
+JournalRecord* JRN_AddRecord(JRN_Journal *journal, int frame, int type) {
+    if (journal->pending_cnt == journal->pending_size) {
+        journal->pending_size = SDL_max(2 * journal->pending_size, 16);
+        journal->pending = realloc(journal->pending, sizeof(JournalRecord) * journal->pending_size);
+    }
+    JournalRecord *record = &journal->pending[journal->pending_cnt++];
+    memset(record, 0, sizeof(JournalRecord));
+    record->frame = frame;
+    record->type = type;
+    return record;
+}
+
+/* Players whose applied potion changed in the last step */
+void JRN_AddPickups(JRN_Journal *journal, Map *map) {
+    for (int i = 0; i < journal->player_cnt; i++) {
+        Potion *potion = &map->player_states[i].potion;
+        int id = potion->id;
+        if (id != journal->potion_ids[i] && potion->type != POTION_NONE) {
+            JournalRecord *record = JRN_AddRecord(journal, map->frame, JRN_PICKUP);
+            record->player_id = map->players[i]->id;
+            record->a = potion->id;
+            record->b = potion->type;
+        }
+        journal->potion_ids[i] = id;
+    }
+}
+
+void JRN_AddCommands(JRN_Journal *journal, int frame, const SIM_Command *cmds, int cmd_cnt) {
+    for (int i = 0; i < cmd_cnt; i++) {
+        JournalRecord *record = JRN_AddRecord(journal, frame, JRN_COMMAND);
+        record->command = cmds[i].type;
+        record->player_id = cmds[i].player_id;
+        record->a = cmds[i].src_id;
+        record->b = cmds[i].dst_id;
+    }
+}
+
+/* filename replaced by header and the first record_cnt records, open to append to them */
+FILE* JRN_Rewrite(const char *filename, const JournalHeader *header, const JournalRecord *records, long record_cnt) {
+    Sint64 size = sizeof(JournalHeader) + sizeof(JournalRecord) * (Sint64)record_cnt;
+    Uint8 *data = malloc(size);
+    memcpy(data, header, sizeof(JournalHeader));
+    memcpy(data + sizeof(JournalHeader), records, sizeof(JournalRecord) * record_cnt);
+    int result = ELE_ReplaceFile(filename, data, size);
+    free(data);
+    return (result == 0 ? fopen(filename, "ab") : NULL);
+}
+
+JRN_Journal* JRN_Open(FILE *file, Map *map, Uint64 seed) {
+    JRN_Journal *journal = malloc(sizeof(JRN_Journal));
+    memset(journal, 0, sizeof(JRN_Journal));
+    journal->file = file;
+    journal->seed = seed;
+    journal->synced_frame = map->frame;
+    journal->player_cnt = map->player_cnt;
+    journal->potion_ids = malloc(sizeof(int) * SDL_max(map->player_cnt, 1));
+    for (int i = 0; i < map->player_cnt; i++) {
+        journal->potion_ids[i] = map->player_states[i].potion.id;
+    }
+    return journal;
+}
+
+/* Starts over, the journal of any earlier match is dropped */
+JRN_Journal* JRN_Create(const char *filename, Map *map, Uint64 seed) {
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        LogInfo("Unable to create journal %s", filename);
+        return NULL;
+    }
+    JournalHeader header = {0};
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.map_id = map->id;
+    header.commanded = map->commanded;
+    header.seed = seed;
+    if (fwrite(&header, sizeof(header), 1, file) != 1 || fflush(file) != 0) {
+        LogInfo("Unable to write journal %s", filename);
+        fclose(file);
+        return NULL;
+    }
+    return JRN_Open(file, map, seed);
+}
+
+/* Frame and checksum of a saved match, -1 if it isn't one */
+int JRN_ReadCheckpoint(const char *filename, Sint32 *frame, Uint32 *checksum) {
+    SDL_RWops *file = SDL_RWFromFile(filename, "rb");
+    if (file == NULL) return -1;
+    MapFileHeader header;
+    int result = SDL_RWread(file, &header, sizeof(header), 1);
+    SDL_RWclose(file);
+    if (result != 1 || memcmp(header.magic, MAP_FILE_MAGIC, sizeof(header.magic)) ||
+        header.version != MAP_FILE_VERSION || !(header.flags & MAP_FILE_MATCH)) return -1;
+    *frame = header.frame;
+    *checksum = header.checksum;
+    return 0;
+}
+
+/*
+ * map is the match loaded from checkpoint, with human and w, h set as
+ * they were. Plays the journal after that checkpoint and returns the
+ * journal to append to from there on, NULL if it isn't this match's.
+ * map->commanded is set as the match had it.
+ */
+JRN_Journal* JRN_Resume(const char *filename, const char *checkpoint, Map *map) {
+    Sint32 checkpoint_frame;
+    Uint32 checkpoint_checksum;
+    if (JRN_ReadCheckpoint(checkpoint, &checkpoint_frame, &checkpoint_checksum) != 0 ||
+        checkpoint_frame != map->frame) return NULL;
+    FILE *file = fopen(filename, "r+b");
+    if (file == NULL) return NULL;
+    JournalHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) ||
+        header.version != JOURNAL_VERSION || header.map_id != map->id) {
+        LogInfo("Journal %s is not of this match", filename);
+        fclose(file);
+        return NULL;
+    }
+    // Records, a torn one at the end is dropped
+    fseek(file, 0, SEEK_END);
+    long record_cnt = (ftell(file) - (long)sizeof(header)) / sizeof(JournalRecord);
+    JournalRecord *records = malloc(sizeof(JournalRecord) * SDL_max(record_cnt, 1));
+    fseek(file, sizeof(header), SEEK_SET);
+    if ((long)fread(records, sizeof(JournalRecord), record_cnt, file) != record_cnt) {
+        LogInfo("Unable to read journal %s", filename);
+        free(records);
+        fclose(file);
+        return NULL;
+    }
+    long start = record_cnt - 1;
+    for (; start >= 0; start--) {
+        JournalRecord *record = &records[start];
+        if (record->type == JRN_CHECKPOINT && record->frame == checkpoint_frame &&
+            record->checksum == checkpoint_checksum) break;
+    }
+    if (start < 0) {
+        LogInfo("Journal %s has no record of the checkpoint", filename);
+        free(records);
+        fclose(file);
+        return NULL;
+    }
+    // Replay
+    map->commanded = header.commanded;
+    JRN_Journal *journal = JRN_Open(file, map, header.seed);
+    int last_frame = records[record_cnt - 1].frame;
+    int replayed = 0, diverged = 0;
+    SIM_Command cmds[SIM_MAX_TICK_CMDS];
+    long i = start + 1, kept = record_cnt;
+    while (map->frame < last_frame && SIM_GetWinner(map) == NULL) {
+        int frame = map->frame + 1, cmd_cnt = 0;
+        long frame_start = i;
+        for (long j = i; j < record_cnt && records[j].frame <= frame; j++) {
+            JournalRecord *record = &records[j];
+            if (record->type != JRN_COMMAND || record->frame != frame || cmd_cnt == SIM_MAX_TICK_CMDS) continue;
+            cmds[cmd_cnt++] = (SIM_Command){record->command, record->player_id, record->a, record->b};
+        }
+        SIM_Step(map, cmds, cmd_cnt);
+        ++replayed;
+        JRN_AddPickups(journal, map);
+        // Pickups should come out as they went in
+        int pickup = 0;
+        for (; i < record_cnt && records[i].frame <= frame; i++) {
+            JournalRecord *record = &records[i];
+            if (record->type != JRN_PICKUP) continue;
+            if (pickup >= journal->pending_cnt || journal->pending[pickup].player_id != record->player_id ||
+                journal->pending[pickup].a != record->a) diverged = 1;
+            ++pickup;
+        }
+        if (pickup != journal->pending_cnt) diverged = 1;
+        if (diverged) {
+            LogInfo("Journal diverges from the replay at frame %d, cut there", frame);
+            /* The frame is recorded again as it replayed, its pickups are pending already */
+            JRN_AddCommands(journal, frame, cmds, cmd_cnt);
+            kept = frame_start;
+            break;
+        }
+        journal->pending_cnt = 0;
+    }
+    if (diverged) {
+        fclose(file);
+        journal->file = JRN_Rewrite(filename, &header, records, kept);
+        free(records);
+        if (journal->file == NULL) {
+            LogInfo("Unable to cut journal %s, the match won't be journaled", filename);
+            free(journal->pending);
+            free(journal->potion_ids);
+            free(journal);
+            return NULL;
+        }
+        JRN_Sync(journal, map);
+    } else {
+        free(records);
+        /* Appending right after the last whole record */
+        fseek(file, sizeof(header) + record_cnt * sizeof(JournalRecord), SEEK_SET);
+        journal->pending_cnt = 0;
+        journal->synced_frame = map->frame;
+    }
+    LogInfo("Replayed %d ticks of journal %s from frame %d", replayed, filename, checkpoint_frame);
+    return journal;
+}
+
+void JRN_Close(JRN_Journal *journal, Map *map) {
+    if (journal == NULL) return;
+    /* Everything up to now, not just up to the last JOURNAL_SYNC_TICKS */
+    if (journal->pending_cnt == 0 && map->frame != journal->synced_frame) {
+        JRN_AddRecord(journal, map->frame, JRN_TICK);
+    }
+    JRN_Sync(journal, map);
+    fclose(journal->file);
+    free(journal->pending);
+    free(journal->potion_ids);
+    free(journal);
+}
+
+/* After SIM_Step ran cmds */
+void JRN_Record(JRN_Journal *journal, Map *map, const SIM_Command *cmds, int cmd_cnt) {
+    JRN_AddCommands(journal, map->frame, cmds, cmd_cnt);
+    JRN_AddPickups(journal, map);
+}
+
+/* Saves the match to filename in the background and notes it */
+int JRN_Checkpoint(JRN_Journal *journal, Map *map, const char *filename) {
+    if (ASV_Save(map, filename, MAP_FILE_MATCH | MAP_FILE_PACKED, 0) != 0) return -1;
+    ASV_Stats stats;
+    ASV_GetStats(&stats);
+    JRN_AddRecord(journal, map->frame, JRN_CHECKPOINT)->checksum = stats.last_checksum;
+    return JRN_Sync(journal, map);
+}
+
+/* Writes out what was recorded, at most every JOURNAL_SYNC_TICKS when nothing was */
+int JRN_Sync(JRN_Journal *journal, Map *map) {
+    if (journal->pending_cnt == 0) {
+        if (map->frame - journal->synced_frame < JOURNAL_SYNC_TICKS) return 0;
+        JRN_AddRecord(journal, map->frame, JRN_TICK);
+    } else if (journal->pending[journal->pending_cnt - 1].frame != map->frame) {
+        JRN_AddRecord(journal, map->frame, JRN_TICK);
+    }
+    int result = 0;
+    if (fwrite(journal->pending, sizeof(JournalRecord), journal->pending_cnt, journal->file) !=
+        (size_t)journal->pending_cnt || fflush(journal->file) != 0) {
+        LogInfo("Unable to write journal");
+        result = -1;
+    }
+    journal->pending_cnt = 0;
+    journal->synced_frame = map->frame;
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef _JOURNAL_H
+#define _JOURNAL_H
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include "sim.h"
+#include "elems/map.h"
+
+/*
+ * Append-only log of a match, kept next to its lastmap checkpoint.
+ * Every command is appended with the tick it ran in, so are the potions
+ * picked up and a record for each checkpoint. A match that was closed
+ * or crashed resumes from the last checkpoint on disk and replays the
+ * journal after it through SIM_Step, which the RNG streams stored in
+ * the checkpoint make deterministic.
+ */
+
+#define JOURNAL_FILE "bin/data/lastmap.jnl"
+
+enum JRN_Constants {
+    JOURNAL_VERSION = 2,
+    /* Ticks without a record before a JRN_TICK, the most a crash loses */
+    JOURNAL_SYNC_TICKS = SIM_TICK_RATE
+};
+
+enum JRN_RecordTypes {
+    /* SIM_Command run by the step to frame */
+    JRN_COMMAND,
+    /* Potion a of type b applied to the player, checked on replay */
+    JRN_PICKUP,
+    /* lastmap saved at frame, checksum is its MapFileHeader::checksum */
+    JRN_CHECKPOINT,
+    /* Simulation got to frame */
+    JRN_TICK
+};
+
+struct JournalHeader {
+    char magic[4];
+    Uint32 version;
+    Sint32 map_id;
+    /* Map::commanded of the match, 0 in journals from before it */
+    Uint32 commanded;
+    /* Given to SIM_SeedMatch when the match started, 0 if unknown */
+    Uint64 seed;
+};
+typedef struct JournalHeader JournalHeader;
+
+struct JournalRecord {
+    Sint32 frame;
+    Uint16 type;
+    /* SIM_CommandTypes */
+    Uint16 command;
+    Sint32 player_id;
+    /* Source and target area ids of commands */
+    Sint32 a, b;
+    Uint32 checksum;
+};
+typedef struct JournalRecord JournalRecord;
+
+struct JRN_Journal {
+    FILE *file;
+    Uint64 seed;
+    /* Appended but not written yet */
+    JournalRecord *pending;
+    int pending_cnt;
+    int pending_size;
+    int synced_frame;
+    /* Potion applied to each player of the map after the last step, -1 for none */
+    int *potion_ids;
+    int player_cnt;
+};
+typedef struct JRN_Journal JRN_Journal;
+
+extern JRN_Journal* JRN_Create(const char *filename, Map *map, Uint64 seed);
+extern JRN_Journal* JRN_Resume(const char *filename, const char *checkpoint, Map *map);
+extern void JRN_Close(JRN_Journal *journal, Map *map);
+
+extern void JRN_Record(JRN_Journal *journal, Map *map, const SIM_Command *cmds, int cmd_cnt);
+extern int JRN_Checkpoint(JRN_Journal *journal, Map *map, const char *filename);
+extern int JRN_Sync(JRN_Journal *journal, Map *map);
+
+#endif /* _JOURNAL_H */
\ No newline at end of file
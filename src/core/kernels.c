@@ -0,0 +1,298 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include "kernels.h"
+#include "log.h"
+
+/* Vector variants need GCC/Clang to compile them for a single function */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define KRN_X86 1
+#define KRN_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#endif
+
+/* Scalar */
+
+void KRN_MoveScalar(
+    Fixed *x, Fixed *y, int *xi, int *yi,
+    const Fixed *vx, const Fixed *vy,
+    const int *owner, const int *speed, int cnt
+) {
+    for (int i = 0; i < cnt; i++) {
+        int size = speed[owner[i]];
+        x[i] += (size * vx[i]) >> KRN_SPEED_SHIFT;
+        y[i] += (size * vy[i]) >> KRN_SPEED_SHIFT;
+        xi[i] = ELE_FixedToInt(x[i]);
+        yi[i] = ELE_FixedToInt(y[i]);
+    }
+}
+
+void KRN_StatusScalar(
+    const Fixed *x, const Fixed *y, const int *xi, const int *yi,
+    const int *dx, const int *dy, int cnt, int w, int h, int dist, Uint8 *status
+) {
+    Fixed fw = ELE_IntToFixed(w), fh = ELE_IntToFixed(h);
+    for (int i = 0; i < cnt; i++) {
+        if (x[i] < 0 || y[i] < 0 || x[i] > fw || y[i] > fh) {
+            status[i] = TROOP_OUTSIDE;
+        } else if (abs(xi[i] - dx[i]) + abs(yi[i] - dy[i]) < dist) {
+            status[i] = TROOP_ARRIVED;
+        } else {
+            status[i] = TROOP_ALIVE;
+        }
+    }
+}
+
+int KRN_NearScalar(
+    const int *xs, const int *ys, int cnt,
+    int x, int y, int dist, int *near
+) {
+    int near_cnt = 0;
+    for (int k = 0; k < cnt; k++) {
+        if (abs(xs[k] - x) + abs(ys[k] - y) < dist) near[near_cnt++] = k;
+    }
+    return near_cnt;
+}
+
+#ifdef KRN_X86
+
+/* SSE2, four ints per step */
+
+KRN_TARGET("sse2")
+static inline __m128i KRN_Abs128(__m128i v) {
+    __m128i sign = _mm_srai_epi32(v, 31);
+    return _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+}
+
+/* Low 32 bits of a * b, which SSE2 only has for the even lanes */
+KRN_TARGET("sse2")
+static inline __m128i KRN_Mul128(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(
+        _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+        _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0))
+    );
+}
+
+KRN_TARGET("sse2")
+void KRN_MoveSSE2(
+    Fixed *x, Fixed *y, int *xi, int *yi,
+    const Fixed *vx, const Fixed *vy,
+    const int *owner, const int *speed, int cnt
+) {
+    int i = 0;
+    for (; i + 4 <= cnt; i += 4) {
+        __m128i size = _mm_set_epi32(speed[owner[i + 3]], speed[owner[i + 2]],
+            speed[owner[i + 1]], speed[owner[i]]);
+        __m128i nx = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(x + i)), _mm_srai_epi32(
+            KRN_Mul128(size, _mm_loadu_si128((const __m128i*)(vx + i))), KRN_SPEED_SHIFT));
+        __m128i ny = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(y + i)), _mm_srai_epi32(
+            KRN_Mul128(size, _mm_loadu_si128((const __m128i*)(vy + i))), KRN_SPEED_SHIFT));
+        _mm_storeu_si128((__m128i*)(x + i), nx);
+        _mm_storeu_si128((__m128i*)(y + i), ny);
+        _mm_storeu_si128((__m128i*)(xi + i), _mm_srai_epi32(nx, FIXED_SHIFT));
+        _mm_storeu_si128((__m128i*)(yi + i), _mm_srai_epi32(ny, FIXED_SHIFT));
+    }
+    KRN_MoveScalar(x + i, y + i, xi + i, yi + i, vx + i, vy + i, owner + i, speed, cnt - i);
+}
+
+KRN_TARGET("sse2")
+void KRN_StatusSSE2(
+    const Fixed *x, const Fixed *y, const int *xi, const int *yi,
+    const int *dx, const int *dy, int cnt, int w, int h, int dist, Uint8 *status
+) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wv = _mm_set1_epi32(ELE_IntToFixed(w)), hv = _mm_set1_epi32(ELE_IntToFixed(h));
+    const __m128i distv = _mm_set1_epi32(dist);
+    int i = 0;
+    for (; i + 4 <= cnt; i += 4) {
+        __m128i xv = _mm_loadu_si128((const __m128i*)(x + i));
+        __m128i yv = _mm_loadu_si128((const __m128i*)(y + i));
+        __m128i outside = _mm_or_si128(
+            _mm_or_si128(_mm_cmplt_epi32(xv, zero), _mm_cmplt_epi32(yv, zero)),
+            _mm_or_si128(_mm_cmpgt_epi32(xv, wv), _mm_cmpgt_epi32(yv, hv))
+        );
+        __m128i sum = _mm_add_epi32(
+            KRN_Abs128(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(xi + i)),
+                _mm_loadu_si128((const __m128i*)(dx + i)))),
+            KRN_Abs128(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(yi + i)),
+                _mm_loadu_si128((const __m128i*)(dy + i))))
+        );
+        int out_mask = _mm_movemask_ps(_mm_castsi128_ps(outside));
+        int arr_mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(sum, distv)));
+        for (int k = 0; k < 4; k++) {
+            status[i + k] = ((out_mask >> k) & 1 ? TROOP_OUTSIDE :
+                ((arr_mask >> k) & 1 ? TROOP_ARRIVED : TROOP_ALIVE));
+        }
+    }
+    KRN_StatusScalar(x + i, y + i, xi + i, yi + i, dx + i, dy + i, cnt - i, w, h, dist, status + i);
+}
+
+KRN_TARGET("sse2")
+int KRN_NearSSE2(
+    const int *xs, const int *ys, int cnt,
+    int x, int y, int dist, int *near
+) {
+    const __m128i xv = _mm_set1_epi32(x), yv = _mm_set1_epi32(y);
+    const __m128i distv = _mm_set1_epi32(dist);
+    int near_cnt = 0;
+    int k = 0;
+    for (; k + 4 <= cnt; k += 4) {
+        __m128i sum = _mm_add_epi32(
+            KRN_Abs128(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(xs + k)), xv)),
+            KRN_Abs128(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(ys + k)), yv))
+        );
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(sum, distv)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            near[near_cnt++] = k + bit;
+            mask &= mask - 1;
+        }
+    }
+    int tail_cnt = KRN_NearScalar(xs + k, ys + k, cnt - k, x, y, dist, near + near_cnt);
+    for (int t = 0; t < tail_cnt; t++) near[near_cnt + t] += k;
+    return near_cnt + tail_cnt;
+}
+
+/* AVX2, eight ints per step */
+
+KRN_TARGET("avx2")
+void KRN_MoveAVX2(
+    Fixed *x, Fixed *y, int *xi, int *yi,
+    const Fixed *vx, const Fixed *vy,
+    const int *owner, const int *speed, int cnt
+) {
+    int i = 0;
+    for (; i + 8 <= cnt; i += 8) {
+        __m256i size = _mm256_i32gather_epi32(speed, _mm256_loadu_si256((const __m256i*)(owner + i)), 4);
+        __m256i nx = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(x + i)), _mm256_srai_epi32(
+            _mm256_mullo_epi32(size, _mm256_loadu_si256((const __m256i*)(vx + i))), KRN_SPEED_SHIFT));
+        __m256i ny = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(y + i)), _mm256_srai_epi32(
+            _mm256_mullo_epi32(size, _mm256_loadu_si256((const __m256i*)(vy + i))), KRN_SPEED_SHIFT));
+        _mm256_storeu_si256((__m256i*)(x + i), nx);
+        _mm256_storeu_si256((__m256i*)(y + i), ny);
+        _mm256_storeu_si256((__m256i*)(xi + i), _mm256_srai_epi32(nx, FIXED_SHIFT));
+        _mm256_storeu_si256((__m256i*)(yi + i), _mm256_srai_epi32(ny, FIXED_SHIFT));
+    }
+    KRN_MoveScalar(x + i, y + i, xi + i, yi + i, vx + i, vy + i, owner + i, speed, cnt - i);
+}
+
+KRN_TARGET("avx2")
+void KRN_StatusAVX2(
+    const Fixed *x, const Fixed *y, const int *xi, const int *yi,
+    const int *dx, const int *dy, int cnt, int w, int h, int dist, Uint8 *status
+) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i wv = _mm256_set1_epi32(ELE_IntToFixed(w)), hv = _mm256_set1_epi32(ELE_IntToFixed(h));
+    const __m256i distv = _mm256_set1_epi32(dist);
+    int i = 0;
+    for (; i + 8 <= cnt; i += 8) {
+        __m256i xv = _mm256_loadu_si256((const __m256i*)(x + i));
+        __m256i yv = _mm256_loadu_si256((const __m256i*)(y + i));
+        __m256i outside = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(zero, xv), _mm256_cmpgt_epi32(zero, yv)),
+            _mm256_or_si256(_mm256_cmpgt_epi32(xv, wv), _mm256_cmpgt_epi32(yv, hv))
+        );
+        __m256i sum = _mm256_add_epi32(
+            _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(xi + i)),
+                _mm256_loadu_si256((const __m256i*)(dx + i)))),
+            _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(yi + i)),
+                _mm256_loadu_si256((const __m256i*)(dy + i))))
+        );
+        int out_mask = _mm256_movemask_ps(_mm256_castsi256_ps(outside));
+        int arr_mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(distv, sum)));
+        for (int k = 0; k < 8; k++) {
+            status[i + k] = ((out_mask >> k) & 1 ? TROOP_OUTSIDE :
+                ((arr_mask >> k) & 1 ? TROOP_ARRIVED : TROOP_ALIVE));
+        }
+    }
+    KRN_StatusScalar(x + i, y + i, xi + i, yi + i, dx + i, dy + i, cnt - i, w, h, dist, status + i);
+}
+
+KRN_TARGET("avx2")
+int KRN_NearAVX2(
+    const int *xs, const int *ys, int cnt,
+    int x, int y, int dist, int *near
+) {
+    const __m256i xv = _mm256_set1_epi32(x), yv = _mm256_set1_epi32(y);
+    const __m256i distv = _mm256_set1_epi32(dist);
+    int near_cnt = 0;
+    int k = 0;
+    for (; k + 8 <= cnt; k += 8) {
+        __m256i sum = _mm256_add_epi32(
+            _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(xs + k)), xv)),
+            _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(ys + k)), yv))
+        );
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(distv, sum)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            near[near_cnt++] = k + bit;
+            mask &= mask - 1;
+        }
+    }
+    int tail_cnt = KRN_NearScalar(xs + k, ys + k, cnt - k, x, y, dist, near + near_cnt);
+    for (int t = 0; t < tail_cnt; t++) near[near_cnt + t] += k;
+    return near_cnt + tail_cnt;
+}
+
+#endif /* KRN_X86 */
+
+KRN_MoveFunc KRN_MoveTroops = KRN_MoveScalar;
+KRN_StatusFunc KRN_TroopStatus = KRN_StatusScalar;
+KRN_NearFunc KRN_FindNear = KRN_NearScalar;
+
+int g_KernelLevel = KRN_SCALAR;
+
+int KRN_GetKernels(int level, KRN_MoveFunc *move, KRN_StatusFunc *status,
+        KRN_NearFunc *near) {
+    switch (level) {
+        case KRN_SCALAR:
+            *move = KRN_MoveScalar;
+            *status = KRN_StatusScalar;
+            *near = KRN_NearScalar;
+            return 0;
+#ifdef KRN_X86
+        case KRN_SSE2:
+            if (!SDL_HasSSE2()) return -1;
+            *move = KRN_MoveSSE2;
+            *status = KRN_StatusSSE2;
+            *near = KRN_NearSSE2;
+            return 0;
+        case KRN_AVX2:
+            if (!SDL_HasAVX2()) return -1;
+            *move = KRN_MoveAVX2;
+            *status = KRN_StatusAVX2;
+            *near = KRN_NearAVX2;
+            return 0;
+#endif
+    }
+    return -1;
+}
+
+/*
+ * Selects the kernels used by the simulation, falling back to narrower
+ * ones when the CPU lacks the requested level. Call before any match
+ * runs, the choice is shared by all threads.
+ */
+int KRN_Init(int level) {
+    if (level > KRN_AVX2) level = KRN_AVX2;
+    while (KRN_GetKernels(level, &KRN_MoveTroops, &KRN_TroopStatus, &KRN_FindNear) != 0) {
+        --level;
+    }
+    g_KernelLevel = level;
+    LogInfo("Simulation kernels: %s", KRN_GetLevelName(level));
+    return level;
+}
+
+int KRN_GetLevel() {
+    return g_KernelLevel;
+}
+
+const char* KRN_GetLevelName(int level) {
+    switch (level) {
+        case KRN_SCALAR: return "scalar";
+        case KRN_SSE2: return "sse2";
+        case KRN_AVX2: return "avx2";
+    }
+    return "best";
+}
\ No newline at end of file
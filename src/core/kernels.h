@@ -0,0 +1,60 @@
+#ifndef _KERNELS_H
+#define _KERNELS_H
+
+#include <SDL2/SDL.h>
+#include "elems/troop.h"
+
+/*
+ * Data-parallel loops of the simulation over flat troop arrays. They
+ * only do integer math, so every variant gives exactly the results of
+ * the scalar one. KRN_Init picks the widest the CPU supports.
+ */
+
+enum KRN_Levels {
+    KRN_SCALAR,
+    KRN_SSE2,
+    KRN_AVX2,
+    KRN_BEST
+};
+
+enum KRN_Constants {
+    /* Speeds are in 1 / (1 << KRN_SPEED_SHIFT) of the velocity per tick */
+    KRN_SPEED_SHIFT = 8,
+    KRN_SPEED_ONE = 1 << KRN_SPEED_SHIFT
+};
+
+enum KRN_TroopStatus {
+    TROOP_ALIVE,
+    TROOP_OUTSIDE,
+    TROOP_ARRIVED
+};
+
+/* x += speed[owner] * vx >> KRN_SPEED_SHIFT, same for y, xi and yi get the whole pixels */
+typedef void (*KRN_MoveFunc)(
+    Fixed *x, Fixed *y, int *xi, int *yi,
+    const Fixed *vx, const Fixed *vy,
+    const int *owner, const int *speed, int cnt
+);
+/* Outside [0, w] x [0, h] or less than dist (Manhattan) from (dx, dy) in whole pixels */
+typedef void (*KRN_StatusFunc)(
+    const Fixed *x, const Fixed *y, const int *xi, const int *yi,
+    const int *dx, const int *dy, int cnt, int w, int h, int dist, Uint8 *status
+);
+/* Writes the k with |xs[k] - x| + |ys[k] - y| < dist to near, returns how many */
+typedef int (*KRN_NearFunc)(
+    const int *xs, const int *ys, int cnt,
+    int x, int y, int dist, int *near
+);
+
+extern KRN_MoveFunc KRN_MoveTroops;
+extern KRN_StatusFunc KRN_TroopStatus;
+extern KRN_NearFunc KRN_FindNear;
+
+extern int KRN_Init(int level);
+extern int KRN_GetLevel(void);
+extern const char* KRN_GetLevelName(int level);
+
+extern int KRN_GetKernels(int level, KRN_MoveFunc *move, KRN_StatusFunc *status,
+        KRN_NearFunc *near);
+
+#endif /* _KERNELS_H */
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "prof.h"
+#include "log.h"
+
+#ifdef PRF_ENABLED
+
+const char *g_PrfPhaseNames[PRF_PHASE_CNT] = {
+    "frame", "input", "AI pool", "sim", "area production", "attack emission",
+    "potions", "troop movement", "collisions", "potion pickup", "sim AI",
+    "player panel", "areas", "text", "potion sprites", "troops", "overlay", "present"
+};
+
+struct PRF_Open {
+    int phase;
+    Uint64 start;
+    /* Time of the phases nested in it */
+    Uint64 nested;
+};
+typedef struct PRF_Open PRF_Open;
+
+struct PRF_Event {
+    int phase;
+    Uint64 start, duration;
+};
+typedef struct PRF_Event PRF_Event;
+
+int g_PrfOn = 0;
+SDL_threadID g_PrfThread;
+Uint64 g_PrfStart, g_PrfFrameStart;
+double g_PrfUsPerCount;
+
+PRF_Open g_PrfOpen[PRF_MAX_DEPTH];
+int g_PrfDepth = 0;
+
+/* Counts of the frame going on, then microseconds per frame of the last ones */
+Uint64 g_PrfFrame[PRF_PHASE_CNT];
+float g_PrfHistory[PRF_PHASE_CNT][PRF_HISTORY_FRAMES];
+int g_PrfFrameCnt = 0;
+
+char *g_PrfTraceFilename = NULL;
+PRF_Event *g_PrfEvents = NULL;
+int g_PrfEventCnt = 0, g_PrfEventSize = 0;
+
+/* Times the calling thread from here on, traced to trace_filename unless NULL */
+void PRF_Init(const char *trace_filename) {
+    g_PrfOn = 1;
+    g_PrfThread = SDL_ThreadID();
+    g_PrfStart = g_PrfFrameStart = SDL_GetPerformanceCounter();
+    g_PrfUsPerCount = 1e6 / SDL_GetPerformanceFrequency();
+    if (trace_filename != NULL) g_PrfTraceFilename = SDL_strdup(trace_filename);
+}
+
+void PRF_AddEvent(int phase, Uint64 start, Uint64 duration) {
+    if (g_PrfTraceFilename == NULL) return;
+    if (g_PrfEventCnt == g_PrfEventSize) {
+        if (g_PrfEventSize == PRF_MAX_TRACE_EVENTS) return;
+        int size = SDL_min(SDL_max(2 * g_PrfEventSize, 4096), PRF_MAX_TRACE_EVENTS);
+        PRF_Event *events = realloc(g_PrfEvents, sizeof(PRF_Event) * size);
+        if (events == NULL) return;
+        g_PrfEvents = events;
+        g_PrfEventSize = size;
+        if (size == PRF_MAX_TRACE_EVENTS) LogInfo("Trace is at %d events, the rest of the session is left out", size);
+    }
+    g_PrfEvents[g_PrfEventCnt++] = (PRF_Event){phase, start - g_PrfStart, duration};
+}
+
+int PRF_WriteTrace(const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        LogInfo("Unable to create trace %s", filename);
+        return -1;
+    }
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (int i = 0; i < g_PrfEventCnt; i++) {
+        PRF_Event *event = &g_PrfEvents[i];
+        fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}%s\n",
+            g_PrfPhaseNames[event->phase], event->start * g_PrfUsPerCount, event->duration * g_PrfUsPerCount,
+            (i + 1 < g_PrfEventCnt ? "," : ""));
+    }
+    fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+    int result = (fclose(file) == 0 ? 0 : -1);
+    LogInfo("Wrote %d trace events to %s", g_PrfEventCnt, filename);
+    return result;
+}
+
+void PRF_Quit() {
+    if (g_PrfTraceFilename != NULL) PRF_WriteTrace(g_PrfTraceFilename);
+    SDL_free(g_PrfTraceFilename);
+    g_PrfTraceFilename = NULL;
+    free(g_PrfEvents);
+    g_PrfEvents = NULL;
+    g_PrfEventCnt = g_PrfEventSize = 0;
+    g_PrfOn = 0;
+}
+
+void PRF_BeginPhase(int phase) {
+    if (!g_PrfOn || SDL_ThreadID() != g_PrfThread) return;
+    if (g_PrfDepth == PRF_MAX_DEPTH) return;
+    g_PrfOpen[g_PrfDepth++] = (PRF_Open){phase, SDL_GetPerformanceCounter(), 0};
+}
+
+void PRF_EndPhase(int phase) {
+    if (!g_PrfOn || SDL_ThreadID() != g_PrfThread) return;
+    if (g_PrfDepth == 0 || g_PrfOpen[g_PrfDepth - 1].phase != phase) return;
+    PRF_Open *open = &g_PrfOpen[--g_PrfDepth];
+    Uint64 duration = SDL_GetPerformanceCounter() - open->start;
+    g_PrfFrame[phase] += duration - SDL_min(open->nested, duration);
+    if (g_PrfDepth > 0) g_PrfOpen[g_PrfDepth - 1].nested += duration;
+    PRF_AddEvent(phase, open->start, duration);
+}
+
+/* After the frame is presented */
+void PRF_EndFrame() {
+    if (!g_PrfOn || SDL_ThreadID() != g_PrfThread) return;
+    Uint64 now = SDL_GetPerformanceCounter();
+    g_PrfFrame[PRF_FRAME] = now - g_PrfFrameStart;
+    PRF_AddEvent(PRF_FRAME, g_PrfFrameStart, now - g_PrfFrameStart);
+    g_PrfFrameStart = now;
+    int index = g_PrfFrameCnt++ % PRF_HISTORY_FRAMES;
+    for (int i = 0; i < PRF_PHASE_CNT; i++) {
+        g_PrfHistory[i][index] = g_PrfFrame[i] * g_PrfUsPerCount;
+        g_PrfFrame[i] = 0;
+    }
+}
+
+int PRF_CompareFloats(const void *a, const void *b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+/* PRF_PHASE_CNT stats into stats, returns the frames they are over */
+int PRF_GetStats(PRF_PhaseStats *stats) {
+    int cnt = SDL_min(g_PrfFrameCnt, PRF_HISTORY_FRAMES);
+    float sorted[PRF_HISTORY_FRAMES];
+    for (int i = 0; i < PRF_PHASE_CNT; i++) {
+        stats[i] = (PRF_PhaseStats){g_PrfPhaseNames[i], 0, 0};
+        if (cnt == 0) continue;
+        memcpy(sorted, g_PrfHistory[i], sizeof(float) * cnt);
+        qsort(sorted, cnt, sizeof(float), PRF_CompareFloats);
+        stats[i].p50 = sorted[cnt / 2];
+        stats[i].p99 = sorted[SDL_min(cnt - 1, cnt * 99 / 100)];
+    }
+    return cnt;
+}
+
+#endif /* PRF_ENABLED */
\ No newline at end of file
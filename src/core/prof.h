@@ -0,0 +1,73 @@
+#ifndef _PROF_H
+#define _PROF_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Per-phase frame profiler. PRF_Begin and PRF_End around a phase add
+ * its time to the frame, less the time of phases nested in it, and
+ * PRF_EndFrame closes the frame. The last PRF_HISTORY_FRAMES frames
+ * give the percentiles of each phase, and with a trace file every phase
+ * run is kept as a Chrome trace event, written by PRF_Quit.
+ *
+ * Only the thread that called PRF_Init is timed, so simulation run by
+ * AI workers doesn't count. Without PRF_ENABLED, as in release builds,
+ * the macros are empty and nothing here is compiled.
+ */
+
+enum PRF_Phases {
+    /* Between two PRF_EndFrame, set by it */
+    PRF_FRAME,
+    PRF_INPUT,
+    PRF_AI,
+    /* SIM_Step outside the phases below, like commands and applied potions */
+    PRF_SIM,
+    PRF_SIM_AREAS,
+    PRF_SIM_EMIT,
+    PRF_SIM_POTIONS,
+    PRF_SIM_MOVE,
+    PRF_SIM_COLLIDE,
+    PRF_SIM_PICKUP,
+    PRF_SIM_AI,
+    PRF_DRAW_PANEL,
+    PRF_DRAW_AREAS,
+    PRF_DRAW_TEXT,
+    PRF_DRAW_POTIONS,
+    PRF_DRAW_TROOPS,
+    PRF_OVERLAY,
+    PRF_PRESENT,
+    PRF_PHASE_CNT
+};
+
+enum PRF_Constants {
+    PRF_HISTORY_FRAMES = 240,
+    PRF_MAX_DEPTH = 8,
+    /* About half a minute at full speed, recording stops after */
+    PRF_MAX_TRACE_EVENTS = 1 << 20
+};
+
+struct PRF_PhaseStats {
+    const char *name;
+    /* Microseconds per frame over the history */
+    double p50, p99;
+};
+typedef struct PRF_PhaseStats PRF_PhaseStats;
+
+#ifdef PRF_ENABLED
+#define PRF_Begin(phase) PRF_BeginPhase(phase)
+#define PRF_End(phase) PRF_EndPhase(phase)
+#else
+#define PRF_Begin(phase) ((void)0)
+#define PRF_End(phase) ((void)0)
+#endif
+
+extern void PRF_Init(const char *trace_filename);
+extern void PRF_Quit(void);
+
+extern void PRF_BeginPhase(int phase);
+extern void PRF_EndPhase(int phase);
+extern void PRF_EndFrame(void);
+
+extern int PRF_GetStats(PRF_PhaseStats *stats);
+
+#endif /* _PROF_H */
\ No newline at end of file
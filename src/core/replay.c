@@ -0,0 +1,245 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "replay.h"
+#include "log.h"
+#include "elems/mapfile.h"
+#include "elems/player.h"
+
+const char REPLAY_MAGIC[4] = {'S', 'I', 'O', 'R'};
+
+void RPL_WriteChunkHeader(FILE *file, int type, int frame, int cnt, Sint64 size) {
+    ReplayChunk chunk = {type, frame, cnt, size};
+    fwrite(&chunk, sizeof(chunk), 1, file);
+}
+
+int RPL_WriteKeyframe(RPL_Recorder *recorder, Map *map) {
+    Sint64 size;
+    Uint8 *data = ELE_SerializeMap(map, MAP_FILE_MATCH | MAP_FILE_PACKED, &size);
+    if (data == NULL) return -1;
+    RPL_WriteChunkHeader(recorder->file, RPL_CHUNK_KEYFRAME, map->frame, 1, size);
+    fwrite(data, size, 1, recorder->file);
+    free(data);
+    return 0;
+}
+
+/* Ticks since the last keyframe, then map as the next keyframe unless NULL */
+int RPL_WriteTicks(RPL_Recorder *recorder, Map *map) {
+    if (recorder->tick_cnt > 0) {
+        RPL_WriteChunkHeader(recorder->file, RPL_CHUNK_TICKS, recorder->first_frame, recorder->tick_cnt,
+            sizeof(ReplayTick) * recorder->tick_cnt + sizeof(ReplayCommand) * recorder->cmd_cnt);
+        fwrite(recorder->ticks, sizeof(ReplayTick), recorder->tick_cnt, recorder->file);
+        fwrite(recorder->cmds, sizeof(ReplayCommand), recorder->cmd_cnt, recorder->file);
+    }
+    recorder->first_frame += recorder->tick_cnt;
+    recorder->tick_cnt = 0;
+    recorder->cmd_cnt = 0;
+    if (map != NULL && RPL_WriteKeyframe(recorder, map) != 0) return -1;
+    if (fflush(recorder->file) != 0 || ferror(recorder->file)) {
+        LogInfo("Unable to write replay");
+        return -1;
+    }
+    return 0;
+}
+
+/* Records map as it is from here on, the file is started over */
+RPL_Recorder* RPL_StartRecording(const char *filename, Map *map, Uint64 seed) {
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        LogInfo("Unable to create replay %s", filename);
+        return NULL;
+    }
+    ReplayHeader header = {0};
+    memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_VERSION;
+    header.map_id = map->id;
+    header.human_id = (map->human ? map->human->id : -1);
+    header.seed = seed;
+    header.w = map->w;
+    header.h = map->h;
+    header.commanded = map->commanded;
+    fwrite(&header, sizeof(header), 1, file);
+    /* Padded to 8 bytes so keyframes stay aligned for ELE_ParseMap */
+    int padded_cnt = (map->player_cnt + 1) / 2 * 2;
+    Sint32 *ids = calloc(SDL_max(padded_cnt, 2), sizeof(Sint32));
+    for (int i = 0; i < map->player_cnt; i++) ids[i] = map->players[i]->id;
+    RPL_WriteChunkHeader(file, RPL_CHUNK_PLAYERS, map->frame, map->player_cnt, sizeof(Sint32) * padded_cnt);
+    fwrite(ids, sizeof(Sint32), padded_cnt, file);
+    free(ids);
+    RPL_Recorder *recorder = malloc(sizeof(RPL_Recorder));
+    memset(recorder, 0, sizeof(RPL_Recorder));
+    recorder->file = file;
+    recorder->first_frame = map->frame;
+    if (RPL_WriteTicks(recorder, map) != 0) {
+        RPL_StopRecording(recorder);
+        return NULL;
+    }
+    return recorder;
+}
+
+/* After SIM_Step ran cmds */
+void RPL_RecordTick(RPL_Recorder *recorder, Map *map, const SIM_Command *cmds, int cmd_cnt) {
+    if (recorder->tick_cnt == recorder->tick_size) {
+        recorder->tick_size = SDL_max(2 * recorder->tick_size, RPL_KEYFRAME_TICKS);
+        recorder->ticks = realloc(recorder->ticks, sizeof(ReplayTick) * recorder->tick_size);
+    }
+    if (recorder->cmd_cnt + cmd_cnt > recorder->cmd_size) {
+        recorder->cmd_size = SDL_max(2 * recorder->cmd_size, recorder->cmd_cnt + cmd_cnt);
+        recorder->cmds = realloc(recorder->cmds, sizeof(ReplayCommand) * recorder->cmd_size);
+    }
+    recorder->ticks[recorder->tick_cnt++] = (ReplayTick){ELE_HashMatchState(map), cmd_cnt};
+    for (int i = 0; i < cmd_cnt; i++) {
+        recorder->cmds[recorder->cmd_cnt++] = (ReplayCommand){
+            cmds[i].type, cmds[i].player_id, cmds[i].src_id, cmds[i].dst_id
+        };
+    }
+    if (recorder->tick_cnt == RPL_KEYFRAME_TICKS) RPL_WriteTicks(recorder, map);
+}
+
+void RPL_StopRecording(RPL_Recorder *recorder) {
+    if (recorder == NULL) return;
+    RPL_WriteTicks(recorder, NULL);
+    fclose(recorder->file);
+    free(recorder->ticks);
+    free(recorder->cmds);
+    free(recorder);
+}
+
+/* A recording cut short ends at its last whole chunk */
+RPL_Replay* RPL_LoadReplay(const char *filename) {
+    SDL_RWops *file = SDL_RWFromFile(filename, "rb");
+    if (file == NULL) {
+        LogInfo("Unable to open replay %s", filename);
+        return NULL;
+    }
+    Sint64 size = SDL_RWsize(file);
+    Uint8 *data = (size >= (Sint64)sizeof(ReplayHeader) ? malloc(size) : NULL);
+    if (data == NULL || SDL_RWread(file, data, size, 1) != 1) {
+        LogInfo("Unable to read replay %s", filename);
+        free(data);
+        SDL_RWclose(file);
+        return NULL;
+    }
+    SDL_RWclose(file);
+    RPL_Replay *replay = malloc(sizeof(RPL_Replay));
+    memset(replay, 0, sizeof(RPL_Replay));
+    replay->data = data;
+    memcpy(&replay->header, data, sizeof(ReplayHeader));
+    if (memcmp(replay->header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) ||
+        replay->header.version != REPLAY_VERSION) {
+        LogInfo("%s is not a replay of this version", filename);
+        RPL_DestroyReplay(replay);
+        return NULL;
+    }
+    // Chunks, counted first and indexed after
+    int tick_cnt = 0;
+    Sint64 end = sizeof(ReplayHeader);
+    for (int pass = 0; pass < 2; pass++) {
+        Sint64 offset = sizeof(ReplayHeader);
+        int frame = -1;
+        tick_cnt = 0;
+        replay->keyframe_cnt = 0;
+        replay->cmd_cnt = 0;
+        while (offset + (Sint64)sizeof(ReplayChunk) <= (pass ? end : size)) {
+            const ReplayChunk *chunk = (const ReplayChunk*)(data + offset);
+            const Uint8 *payload = data + offset + sizeof(ReplayChunk);
+            if ((Sint64)chunk->size > size - offset - (Sint64)sizeof(ReplayChunk)) break;
+            if (chunk->type == RPL_CHUNK_PLAYERS && chunk->size >= sizeof(Sint32) * chunk->cnt) {
+                replay->player_ids = (const Sint32*)payload;
+                replay->player_cnt = chunk->cnt;
+            } else if (chunk->type == RPL_CHUNK_KEYFRAME) {
+                if (frame >= 0 && chunk->frame != frame) break;
+                if (frame < 0) replay->first_frame = frame = chunk->frame;
+                if (pass) replay->keyframes[replay->keyframe_cnt] = (RPL_Keyframe){chunk->frame, payload, chunk->size};
+                ++replay->keyframe_cnt;
+            } else if (chunk->type == RPL_CHUNK_TICKS) {
+                const ReplayTick *ticks = (const ReplayTick*)payload;
+                if (chunk->frame != frame || chunk->size < sizeof(ReplayTick) * chunk->cnt) break;
+                const ReplayCommand *cmds = (const ReplayCommand*)(ticks + chunk->cnt);
+                Uint32 i = 0;
+                for (; i < chunk->cnt; i++) {
+                    if (ticks[i].cmd_cnt < 0) break;
+                    if (pass) {
+                        replay->ticks[tick_cnt] = ticks[i];
+                        replay->cmd_start[tick_cnt] = replay->cmd_cnt;
+                        memcpy(replay->cmds + replay->cmd_cnt, cmds, sizeof(ReplayCommand) * ticks[i].cmd_cnt);
+                    }
+                    replay->cmd_cnt += ticks[i].cmd_cnt;
+                    cmds += ticks[i].cmd_cnt;
+                    ++tick_cnt;
+                }
+                if (i < chunk->cnt || (const Uint8*)cmds > payload + chunk->size) break;
+                frame += chunk->cnt;
+            }
+            offset += sizeof(ReplayChunk) + chunk->size;
+            if (!pass) end = offset;
+        }
+        if (!pass) {
+            replay->keyframes = malloc(sizeof(RPL_Keyframe) * SDL_max(replay->keyframe_cnt, 1));
+            replay->ticks = malloc(sizeof(ReplayTick) * SDL_max(tick_cnt, 1));
+            replay->cmd_start = malloc(sizeof(int) * SDL_max(tick_cnt, 1));
+            replay->cmds = malloc(sizeof(ReplayCommand) * SDL_max(replay->cmd_cnt, 1));
+        }
+    }
+    if (replay->keyframe_cnt == 0 || replay->player_ids == NULL) {
+        LogInfo("Replay %s has no match in it", filename);
+        RPL_DestroyReplay(replay);
+        return NULL;
+    }
+    replay->last_frame = replay->first_frame + tick_cnt;
+    LogInfo("Replay of map %d: frames %d to %d, %d keyframes, %d commands", replay->header.map_id,
+        replay->first_frame, replay->last_frame, replay->keyframe_cnt, replay->cmd_cnt);
+    return replay;
+}
+
+void RPL_DestroyReplay(RPL_Replay *replay) {
+    if (replay == NULL) return;
+    free(replay->keyframes);
+    free(replay->ticks);
+    free(replay->cmd_start);
+    free(replay->cmds);
+    free(replay->data);
+    free(replay);
+}
+
+/*
+ * The match at frame, played from the keyframe before it. registry must
+ * have every id of the replay. NULL if the keyframe can't be read.
+ */
+Map* RPL_Seek(RPL_Replay *replay, int frame, PlayerRegistry *registry) {
+    frame = SDL_max(replay->first_frame, SDL_min(frame, replay->last_frame));
+    int index = replay->keyframe_cnt - 1;
+    while (index > 0 && replay->keyframes[index].frame > frame) --index;
+    RPL_Keyframe *keyframe = &replay->keyframes[index];
+    Map *map = ELE_ParseMap(keyframe->data, keyframe->size, 1, 0, registry);
+    if (map == NULL) return NULL;
+    int human = ELE_GetPlayerIndexById(map, replay->header.human_id);
+    map->human = (human < 0 ? NULL : map->players[human]);
+    map->commanded = replay->header.commanded;
+    map->w = replay->header.w;
+    map->h = replay->header.h;
+    while (map->frame < frame) {
+        if (RPL_Step(replay, map) != 0) break;
+    }
+    return map;
+}
+
+/* One recorded tick: 0 if the state hashes as recorded, 1 if not, -1 past the end */
+int RPL_Step(RPL_Replay *replay, Map *map) {
+    int index = map->frame - replay->first_frame;
+    if (index < 0 || map->frame >= replay->last_frame) return -1;
+    SIM_Command cmds[SIM_MAX_TICK_CMDS];
+    const ReplayTick *tick = &replay->ticks[index];
+    int cmd_cnt = SDL_min(tick->cmd_cnt, SIM_MAX_TICK_CMDS);
+    for (int i = 0; i < cmd_cnt; i++) {
+        const ReplayCommand *cmd = &replay->cmds[replay->cmd_start[index] + i];
+        cmds[i] = (SIM_Command){cmd->type, cmd->player_id, cmd->src_id, cmd->dst_id};
+    }
+    SIM_Step(map, cmds, cmd_cnt);
+    if (ELE_HashMatchState(map) != tick->hash) {
+        LogInfo("Replay diverges at frame %d", map->frame);
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include "sim.h"
+#include "elems/map.h"
+
+/*
+ * Replays of whole matches. A replay file is a header and a sequence
+ * of chunks: the ids of the players, then a keyframe with the match as
+ * ELE_SerializeMap stores it and the ticks after it, with another
+ * keyframe every RPL_KEYFRAME_TICKS. A tick is the ELE_HashMatchState
+ * after it and the commands it ran, so playing back is SIM_Step from a
+ * keyframe with a check for divergence after each tick.
+ */
+
+#define REPLAY_FILE "bin/data/lastmatch.rpl"
+
+enum RPL_Constants {
+    REPLAY_VERSION = 3,
+    RPL_KEYFRAME_TICKS = 10 * SIM_TICK_RATE
+};
+
+enum RPL_ChunkTypes {
+    /* cnt Sint32 player ids, in Map::players order */
+    RPL_CHUNK_PLAYERS,
+    /* A map file of the match at frame */
+    RPL_CHUNK_KEYFRAME,
+    /* cnt ReplayTicks from frame on, then their ReplayCommands */
+    RPL_CHUNK_TICKS
+};
+
+struct ReplayHeader {
+    char magic[4];
+    Uint32 version;
+    Sint32 map_id;
+    /* Player driven by the recorded commands, -1 for none */
+    Sint32 human_id;
+    Uint64 seed;
+    /* Map::w and h */
+    Sint32 w, h;
+    /* Map::commanded */
+    Uint32 commanded;
+    Uint32 reserved;
+};
+typedef struct ReplayHeader ReplayHeader;
+
+struct ReplayChunk {
+    Uint32 type;
+    Sint32 frame;
+    Uint32 cnt;
+    /* Bytes following */
+    Uint32 size;
+};
+typedef struct ReplayChunk ReplayChunk;
+
+struct ReplayTick {
+    /* ELE_HashMatchState after the tick */
+    Uint32 hash;
+    Sint32 cmd_cnt;
+};
+typedef struct ReplayTick ReplayTick;
+
+struct ReplayCommand {
+    Sint32 type;
+    Sint32 player_id;
+    Sint32 src_id;
+    Sint32 dst_id;
+};
+typedef struct ReplayCommand ReplayCommand;
+
+struct RPL_Recorder {
+    FILE *file;
+    int first_frame;
+    /* Ticks since the last keyframe, written with the next one */
+    ReplayTick *ticks;
+    int tick_cnt;
+    int tick_size;
+    ReplayCommand *cmds;
+    int cmd_cnt;
+    int cmd_size;
+};
+typedef struct RPL_Recorder RPL_Recorder;
+
+struct RPL_Keyframe {
+    int frame;
+    const Uint8 *data;
+    Sint64 size;
+};
+typedef struct RPL_Keyframe RPL_Keyframe;
+
+struct RPL_Replay {
+    Uint8 *data;
+    ReplayHeader header;
+    const Sint32 *player_ids;
+    int player_cnt;
+    RPL_Keyframe *keyframes;
+    int keyframe_cnt;
+    /* Ticks to first_frame + 1 ... last_frame, indexed from first_frame */
+    int first_frame, last_frame;
+    ReplayTick *ticks;
+    /* Index of each tick's first command */
+    int *cmd_start;
+    ReplayCommand *cmds;
+    int cmd_cnt;
+};
+typedef struct RPL_Replay RPL_Replay;
+
+extern RPL_Recorder* RPL_StartRecording(const char *filename, Map *map, Uint64 seed);
+extern void RPL_RecordTick(RPL_Recorder *recorder, Map *map, const SIM_Command *cmds, int cmd_cnt);
+extern void RPL_StopRecording(RPL_Recorder *recorder);
+
+extern RPL_Replay* RPL_LoadReplay(const char *filename);
+extern void RPL_DestroyReplay(RPL_Replay *replay);
+
+extern Map* RPL_Seek(RPL_Replay *replay, int frame, PlayerRegistry *registry);
+extern int RPL_Step(RPL_Replay *replay, Map *map);
+
+#endif /* _REPLAY_H */
\ No newline at end of file
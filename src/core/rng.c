@@ -0,0 +1,46 @@
+#include <SDL2/SDL.h>
+#include "rng.h"
+
+Uint64 RNG_SplitMix(Uint64 *x) {
+    Uint64 z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void RNG_Seed(RNG *rng, Uint64 seed, int stream) {
+    Uint64 x = seed ^ (0xD1B54A32D192ED03ull * (Uint64)(stream + 1));
+    Uint64 a = RNG_SplitMix(&x), b = RNG_SplitMix(&x);
+    rng->s[0] = (Uint32)a;
+    rng->s[1] = (Uint32)(a >> 32);
+    rng->s[2] = (Uint32)b;
+    rng->s[3] = (Uint32)(b >> 32);
+    /* All zero is the one state xoshiro never leaves */
+    if (!(rng->s[0] | rng->s[1] | rng->s[2] | rng->s[3])) rng->s[0] = 1;
+}
+
+Uint32 RNG_Rotl(Uint32 x, int k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+Uint32 RNG_Next(RNG *rng) {
+    Uint32 *s = rng->s;
+    Uint32 result = RNG_Rotl(s[1] * 5, 7) * 9;
+    Uint32 t = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = RNG_Rotl(s[3], 11);
+    return result;
+}
+
+/* Multiply-shift instead of a division, bias is below 2^-32 * n */
+int RNG_Below(RNG *rng, int n) {
+    return (int)(((Uint64)RNG_Next(rng) * (Uint32)n) >> 32);
+}
+
+double RNG_Double(RNG *rng) {
+    return (RNG_Next(rng) >> 8) * (1.0 / 16777216.0);
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef _RNG_H
+#define _RNG_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * xoshiro128** generator. State is carried by whoever needs random
+ * numbers, so equal seeds give equal sequences on any thread.
+ */
+
+struct RNG {
+    Uint32 s[4];
+};
+typedef struct RNG RNG;
+
+/* Different streams of one seed are independent sequences */
+extern void RNG_Seed(RNG *rng, Uint64 seed, int stream);
+
+extern Uint32 RNG_Next(RNG *rng);
+/* Uniform in [0, n), n > 0 */
+extern int RNG_Below(RNG *rng, int n);
+/* Uniform in [0, 1) */
+extern double RNG_Double(RNG *rng);
+
+#endif /* _RNG_H */
\ No newline at end of file
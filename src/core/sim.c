@@ -0,0 +1,279 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "kernels.h"
+#include "rng.h"
+#include "log.h"
+#include "prof.h"
+#include "elems/player.h"
+#include "elems/area.h"
+#include "elems/potion.h"
+#include "elems/troop.h"
+#include "elems/map.h"
+
+enum SIM_Constants {
+    START_TROOP_CNT = 30,
+    START_TROOP_RATE = 60, /* Frame */
+    ATTACK_DELAY = 25, /* Frame */
+    ATTACK_WAVE_CNT = 5,
+    AI_ATTACK_DELAY = 60, /* Frame */
+    AI_ATTACK_CHANCE = 240,
+    POTION_CHANCE = 2400,
+    POTION_FRAMES = 1500,
+    POTION_PICKUP_DIST = 40
+};
+
+void SIM_SeedMatch(Map *map, Uint64 seed) {
+    for (int i = 0; i < MAP_RNG_CNT; i++) RNG_Seed(&map->rng[i], seed, i);
+}
+
+int SIM_StartMatch(Map *map, Player **players, int player_cnt) {
+    map->player_cnt = player_cnt;
+    free(map->players);
+    map->players = malloc(sizeof(Player*) * player_cnt);
+    memcpy(map->players, players, sizeof(Player*) * player_cnt);
+    ELE_ResetMapState(map);
+    for (int i = 0; i < map->area_cnt; i++) {
+        map->area_states[i].troop_cnt = START_TROOP_CNT;
+        map->area_states[i].troop_rate = START_TROOP_RATE;
+    }
+    for (int i = 0; i < map->player_cnt; i++) {
+        map->player_states[i].troop_rate = START_TROOP_RATE;
+        int start_area = RNG_Below(&map->rng[MAP_RNG_START], map->area_cnt);
+        for (int i = 0; i < 20; i++) {
+            if (map->area_states[start_area].conqueror < 0) break;
+            start_area = RNG_Below(&map->rng[MAP_RNG_START], map->area_cnt);
+        }
+        if (map->area_states[start_area].conqueror >= 0) return -1;
+        ELE_AreaConquer(map, start_area, i);
+    }
+    return 0;
+}
+
+Player* SIM_GetWinner(Map *map) {
+    Player *winner = NULL;
+    int players = 0;
+    for (int i = 0; i < map->player_cnt; i++) {
+        if (map->player_states[i].troop_cnt + map->player_states[i].area_cnt != 0) {
+            winner = map->players[i];
+            ++players;
+        }
+    }
+    return (players == 1 ? winner : NULL);
+}
+
+void SIM_ScoreMatch(Map *map, Player *winner) {
+    for (int i = 0; i < map->player_cnt; i++) {
+        if (map->players[i] == winner) {
+            map->players[i]->score += map->player_cnt - 1;
+        } else {
+            map->players[i]->score -= 1;
+        }
+    }
+}
+
+void SIM_PutRandomPotion(Map *map) {
+    RNG *rng = &map->rng[MAP_RNG_POTION];
+    int type = RNG_Below(rng, 4);
+    SDL_Point center;
+    int area_cnt = map->area_cnt;
+    SDL_assert(area_cnt > 0);
+    int from = RNG_Below(rng, area_cnt);
+    int to = RNG_Below(rng, area_cnt);
+    Area *src = map->areas[from], *dst = map->areas[to];
+    center.x = src->center.x; center.y = src->center.y;
+    int size = RNG_Below(rng, SDL_max(abs(src->center.x - dst->center.x) + 1, abs(src->center.y - dst->center.y) + 1));
+    Fixed ux, uy;
+    ELE_GetDirection(src->center, dst->center, &ux, &uy);
+    center.x = center.x + size * ux / FIXED_ONE;
+    center.y = center.y + size * uy / FIXED_ONE;
+    ELE_AddPotionToMap(map, ELE_MakePotion(map->potion_cnt, type, POTION_FRAMES, POTION_FRAMES, center));
+}
+
+void SIM_ApplyCommand(Map *map, const SIM_Command *cmd) {
+    if (cmd->type != SIM_CMD_ATTACK) return;
+    int src = ELE_GetAreaIndexById(map, cmd->src_id);
+    int dst = ELE_GetAreaIndexById(map, cmd->dst_id);
+    if (src < 0 || dst < 0 || src == dst) return;
+    /*
+     * Checked against the map as it is now, a policy decides on a
+     * snapshot that may be a few ticks old. It never redirects an
+     * attack, so a source already attacking means the command is stale.
+     */
+    AreaState *state = &map->area_states[src];
+    int conqueror = state->conqueror;
+    if (conqueror < 0 || map->players[conqueror]->id != cmd->player_id) return;
+    if ((map->commanded >> conqueror & 1) && state->attack >= 0) return;
+    if (ELE_GetAreaAppliedPotionType(map, dst) == AREA_SHIELD && map->area_states[dst].conqueror != conqueror) return;
+    ELE_AreaAttack(map, src, dst);
+}
+
+void SIM_EmitTroops(Map *map, int i) {
+    Area *area = map->areas[i];
+    AreaState *state = &map->area_states[i];
+    Fixed ux, uy;
+    ELE_GetDirection(area->center, map->areas[state->attack]->center, &ux, &uy);
+    /* Troops of a wave are spread offsets[it] pixels across the path, along (-uy, ux) */
+    const int offsets[ATTACK_WAVE_CNT] = {22, 11, 0, -11, -22};
+    for (int it = 0; it < ATTACK_WAVE_CNT; it++) {
+        if (state->attack_cnt == 0) {
+            ELE_AreaUnAttack(map, i);
+            break;
+        }
+        state->troop_cnt--;
+        state->attack_cnt--;
+        Fixed x = ELE_IntToFixed(area->center.x) + 10 * ux - offsets[it] * uy;
+        Fixed y = ELE_IntToFixed(area->center.y) + 10 * uy + offsets[it] * ux;
+        ELE_AddTroopToMap(map, map->next_troop_id++, state->conqueror, x, y,
+            i, state->attack);
+    }
+    state->attack_delay = ATTACK_DELAY;
+}
+
+void SIM_RunAI(Map *map, int player) {
+    PlayerState *state = &map->player_states[player];
+    if (state->attack_delay) {
+        --state->attack_delay;
+        return;
+    }
+    RNG *rng = &map->rng[MAP_RNG_AI];
+    if (RNG_Below(rng, AI_ATTACK_CHANCE)) return;
+    int from = RNG_Below(rng, state->area_cnt);
+    int to = RNG_Below(rng, map->area_cnt);
+    int src = -1, dst = -1;
+    for (int i = 0; i < map->area_cnt; i++) {
+        if (map->area_states[i].conqueror == player) {
+            if (from == 0) {
+                src = i;
+                break;
+            } else {
+                --from;
+            }
+        }
+    }
+    dst = to;
+    for (int i = 0; i < 10; i++) {
+        if (dst == src ||
+            (ELE_GetAreaAppliedPotionType(map, dst) == AREA_SHIELD &&
+            map->area_states[dst].conqueror != map->area_states[src].conqueror)) {
+            to = RNG_Below(rng, map->area_cnt);
+            dst = to;
+        } else {
+            break;
+        }
+    }
+    ELE_AreaAttack(map, src, dst);
+    state->attack_delay = AI_ATTACK_DELAY;
+}
+
+void SIM_MoveTroops(Map *map, int freeze_is_applied) {
+    /* Distance per tick for each owner, 0 while frozen */
+    int speed[MAP_MAX_PLAYER_CNT];
+    for (int i = 0; i < map->player_cnt; i++) {
+        int type = map->player_states[i].potion.type;
+        speed[i] = (type == TROOP_SPEED_X2 ? KRN_SPEED_ONE : KRN_SPEED_ONE / 2);
+        if (freeze_is_applied && type != TROOP_FREEZE_OTHERS) speed[i] = 0;
+    }
+    TroopStore *troops = map->troops;
+    KRN_MoveTroops(troops->x, troops->y, troops->xi, troops->yi,
+        troops->vx, troops->vy, troops->owner, speed, troops->cnt);
+}
+
+void SIM_Step(Map *map, const SIM_Command *cmds, int cmd_cnt) {
+    PRF_Begin(PRF_SIM);
+    ++map->frame;
+    for (int i = 0; i < cmd_cnt; i++) {
+        SIM_ApplyCommand(map, &cmds[i]);
+    }
+    // Player applied potions
+    int freeze_is_applied = 0;
+    for (int i = 0; i < map->player_cnt; i++) {
+        Potion *potion = &map->player_states[i].potion;
+        if (potion->type != POTION_NONE) {
+            if (potion->frames_applied <= 0) {
+                *potion = ELE_MakeEmptyPotion();
+            } else {
+                --potion->frames_applied;
+            }
+        }
+        freeze_is_applied |= (potion->type == TROOP_FREEZE_OTHERS);
+    }
+    // Areas
+    PRF_Begin(PRF_SIM_AREAS);
+    for (int i = 0; i < map->area_cnt; i++) {
+        AreaState *area = &map->area_states[i];
+        if (area->troop_inc_delay > 0) --area->troop_inc_delay;
+        if (map->frame % area->troop_rate == 0 &&
+            area->conqueror >= 0 && area->troop_inc_delay == 0 &&
+            (area->troop_cnt < map->areas[i]->capacity ||
+                (ELE_GetAreaAppliedPotionType(map, i) == AREA_BEYOND_CAPACITY))) {
+            ++area->troop_cnt;
+        }
+        if (area->troop_cnt <= 0) {
+            area->troop_cnt = 0;
+            area->attack_cnt = 0;
+        }
+        if (area->attack_cnt == 0) ELE_AreaUnAttack(map, i);
+        if (area->attack >= 0) {
+            if (freeze_is_applied && ELE_GetAreaAppliedPotionType(map, i) != TROOP_FREEZE_OTHERS)
+                ;
+            else if (area->attack_delay > 0) {
+                area->attack_delay -= (ELE_GetAreaAppliedPotionType(map, i) == TROOP_SPEED_X2 ? 2 : 1);
+            }
+            else if (area->attack_cnt > 0) {
+                PRF_Begin(PRF_SIM_EMIT);
+                SIM_EmitTroops(map, i);
+                PRF_End(PRF_SIM_EMIT);
+            }
+        }
+    }
+    PRF_End(PRF_SIM_AREAS);
+    // Potions
+    PRF_Begin(PRF_SIM_POTIONS);
+    if (RNG_Below(&map->rng[MAP_RNG_POTION], POTION_CHANCE) == 0) {
+        SIM_PutRandomPotion(map);
+    }
+    for (int i = 0; i < map->potion_cnt; i++) {
+        Potion *potion = &map->potions[i];
+        if (potion->type == POTION_NONE) continue;
+        if (potion->frames_onmap <= 0) {
+            *potion = ELE_MakeEmptyPotion();
+            continue;
+        }
+        --potion->frames_onmap;
+    }
+    PRF_End(PRF_SIM_POTIONS);
+    // Troops
+    PRF_Begin(PRF_SIM_MOVE);
+    SIM_MoveTroops(map, freeze_is_applied);
+    PRF_End(PRF_SIM_MOVE);
+    PRF_Begin(PRF_SIM_COLLIDE);
+    ELE_HandleCollisions(map);
+    PRF_End(PRF_SIM_COLLIDE);
+    PRF_Begin(PRF_SIM_PICKUP);
+    TroopStore *troops = map->troops;
+    for (int i = 0; i < map->potion_cnt; i++) {
+        if (map->potions[i].type == POTION_NONE) continue;
+        SDL_Point center = map->potions[i].center;
+        int near_cnt = KRN_FindNear(troops->xi, troops->yi, troops->cnt,
+            center.x, center.y, POTION_PICKUP_DIST, troops->near);
+        for (int k = 0; k < near_cnt; k++) {
+            PlayerState *player = &map->player_states[troops->owner[troops->near[k]]];
+            if (player->potion.type != POTION_NONE) continue;
+            player->potion = map->potions[i];
+            map->potions[i] = ELE_MakeEmptyPotion();
+            ++map->counters.potions_picked;
+            break;
+        }
+    }
+    PRF_End(PRF_SIM_PICKUP);
+    // AI
+    PRF_Begin(PRF_SIM_AI);
+    for (int i = 0; i < map->player_cnt; i++) {
+        if (map->players[i] == map->human || (map->commanded >> i & 1) ||
+            map->player_states[i].area_cnt == 0) continue;
+        SIM_RunAI(map, i);
+    }
+    PRF_End(PRF_SIM_AI);
+    PRF_End(PRF_SIM);
+}
\ No newline at end of file
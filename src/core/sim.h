@@ -0,0 +1,38 @@
+#ifndef _SIM_H
+#define _SIM_H
+
+#include "elems/map.h"
+
+enum SIM_Rates {
+    /* Every delay in the simulation is counted in these ticks */
+    SIM_TICK_RATE = 60
+};
+
+enum SIM_Limits {
+    /* Commands one SIM_Step is given at most, the human's and every AI_Policy's */
+    SIM_MAX_TICK_CMDS = 32
+};
+
+enum SIM_CommandTypes {
+    SIM_CMD_ATTACK
+};
+
+struct SIM_Command {
+    int type;
+    int player_id;
+    int src_id;
+    int dst_id;
+};
+typedef struct SIM_Command SIM_Command;
+
+extern void SIM_SeedMatch(Map *map, Uint64 seed);
+
+extern int SIM_StartMatch(Map *map, Player **players, int player_cnt);
+extern void SIM_ScoreMatch(Map *map, Player *winner);
+
+extern void SIM_Step(Map *map, const SIM_Command *cmds, int cmd_cnt);
+extern void SIM_MoveTroops(Map *map, int freeze_is_applied);
+
+extern Player* SIM_GetWinner(Map *map);
+
+#endif /* _SIM_H */
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include <SDL2/SDL.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "telemetry.h"
+#include "log.h"
+
+struct TLM_Counter {
+    const char *name;
+    size_t offset;
+    size_t size;
+};
+typedef struct TLM_Counter TLM_Counter;
+
+/* Columns of the csv and keys of the json, in MapCounters order */
+const TLM_Counter g_TLMCounters[] = {
+    {"troops_spawned", offsetof(MapCounters, troops_spawned), sizeof(Uint32)},
+    {"troops_removed", offsetof(MapCounters, troops_removed), sizeof(Uint32)},
+    {"pair_tests", offsetof(MapCounters, pair_tests), sizeof(Uint64)},
+    {"collisions", offsetof(MapCounters, collisions), sizeof(Uint32)},
+    {"arrivals", offsetof(MapCounters, arrivals), sizeof(Uint32)},
+    {"conquests", offsetof(MapCounters, conquests), sizeof(Uint32)},
+    {"potions_spawned", offsetof(MapCounters, potions_spawned), sizeof(Uint32)},
+    {"potions_picked", offsetof(MapCounters, potions_picked), sizeof(Uint32)}
+};
+
+/* What pair_tests counts, in the json so the numbers can be read without the source */
+const char g_TLMPairTestsAre[] = "troops checked for a collision with a live troop after them, once per pair";
+
+Uint64 TLM_GetCounter(const MapCounters *counters, int i) {
+    const Uint8 *field = (const Uint8*)counters + g_TLMCounters[i].offset;
+    return (g_TLMCounters[i].size == sizeof(Uint64) ? *(const Uint64*)field : *(const Uint32*)field);
+}
+
+void TLM_AddToCounter(MapCounters *counters, int i, Uint64 add) {
+    Uint8 *field = (Uint8*)counters + g_TLMCounters[i].offset;
+    if (g_TLMCounters[i].size == sizeof(Uint64)) {
+        *(Uint64*)field += add;
+    } else {
+        *(Uint32*)field += (Uint32)add;
+    }
+}
+
+/* Counts from the next tick of map on, what it took to load or start the match left out */
+TLM_Telemetry* TLM_Start(Map *map, Uint64 seed) {
+    TLM_Telemetry *telemetry = malloc(sizeof(TLM_Telemetry));
+    memset(telemetry, 0, sizeof(TLM_Telemetry));
+    telemetry->ticks = malloc(sizeof(TLM_Tick) * TLM_RING_TICKS);
+    if (telemetry->ticks == NULL) {
+        LogInfo("Unable to allocate telemetry");
+        free(telemetry);
+        return NULL;
+    }
+    telemetry->map_id = map->id;
+    telemetry->seed = seed;
+    telemetry->start = SDL_GetPerformanceCounter();
+    telemetry->first_frame = map->frame + 1;
+    telemetry->peak_troop_cnt = map->troops->cnt;
+    telemetry->peak_frame = map->frame;
+    memset(&map->counters, 0, sizeof(MapCounters));
+    return telemetry;
+}
+
+void TLM_Destroy(TLM_Telemetry *telemetry) {
+    if (telemetry == NULL) return;
+    free(telemetry->ticks);
+    free(telemetry);
+}
+
+/* After SIM_Step */
+void TLM_RecordTick(TLM_Telemetry *telemetry, Map *map) {
+    TLM_Tick *tick = &telemetry->ticks[telemetry->tick_cnt++ % TLM_RING_TICKS];
+    tick->frame = map->frame;
+    tick->ms = 1000.0 * (SDL_GetPerformanceCounter() - telemetry->start) / SDL_GetPerformanceFrequency();
+    tick->troop_cnt = map->troops->cnt;
+    tick->counters = map->counters;
+    for (int i = 0; i < (int)SDL_arraysize(g_TLMCounters); i++) {
+        TLM_AddToCounter(&telemetry->totals, i, TLM_GetCounter(&map->counters, i));
+    }
+    if (tick->troop_cnt > telemetry->peak_troop_cnt) {
+        telemetry->peak_troop_cnt = tick->troop_cnt;
+        telemetry->peak_frame = map->frame;
+    }
+    memset(&map->counters, 0, sizeof(MapCounters));
+}
+
+int TLM_WriteCSV(TLM_Telemetry *telemetry, const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        LogInfo("Unable to create %s", filename);
+        return -1;
+    }
+    fprintf(file, "frame,ms,troops");
+    for (int i = 0; i < (int)SDL_arraysize(g_TLMCounters); i++) fprintf(file, ",%s", g_TLMCounters[i].name);
+    fprintf(file, "\n");
+    int first = SDL_max(0, telemetry->tick_cnt - TLM_RING_TICKS);
+    for (int t = first; t < telemetry->tick_cnt; t++) {
+        TLM_Tick *tick = &telemetry->ticks[t % TLM_RING_TICKS];
+        fprintf(file, "%d,%.3f,%u", tick->frame, tick->ms, tick->troop_cnt);
+        for (int i = 0; i < (int)SDL_arraysize(g_TLMCounters); i++) {
+            fprintf(file, ",%llu", (unsigned long long)TLM_GetCounter(&tick->counters, i));
+        }
+        fprintf(file, "\n");
+    }
+    return (fclose(file) == 0 ? 0 : -1);
+}
+
+int TLM_WriteJSON(TLM_Telemetry *telemetry, const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        LogInfo("Unable to create %s", filename);
+        return -1;
+    }
+    int tick_cnt = SDL_max(telemetry->tick_cnt, 1);
+    MapCounters *totals = &telemetry->totals;
+    fprintf(file, "{\n  \"map_id\": %d,\n  \"seed\": %llu,\n", telemetry->map_id, (unsigned long long)telemetry->seed);
+    fprintf(file, "  \"first_frame\": %d,\n  \"ticks\": %d,\n  \"csv_ticks\": %d,\n", telemetry->first_frame,
+        telemetry->tick_cnt, SDL_min(telemetry->tick_cnt, TLM_RING_TICKS));
+    fprintf(file, "  \"peak_troops\": %u,\n  \"peak_frame\": %d,\n", telemetry->peak_troop_cnt, telemetry->peak_frame);
+    fprintf(file, "  \"collision_hit_rate\": %.6f,\n",
+        (totals->pair_tests ? 1.0 * totals->collisions / totals->pair_tests : 0.0));
+    fprintf(file, "  \"totals\": {");
+    for (int i = 0; i < (int)SDL_arraysize(g_TLMCounters); i++) {
+        fprintf(file, "%s\n    \"%s\": %llu", (i ? "," : ""), g_TLMCounters[i].name,
+            (unsigned long long)TLM_GetCounter(totals, i));
+    }
+    fprintf(file, "\n  },\n  \"per_tick\": {");
+    for (int i = 0; i < (int)SDL_arraysize(g_TLMCounters); i++) {
+        fprintf(file, "%s\n    \"%s\": %.3f", (i ? "," : ""), g_TLMCounters[i].name,
+            1.0 * TLM_GetCounter(totals, i) / tick_cnt);
+    }
+    fprintf(file, "\n  },\n  \"pair_tests_are\": \"%s\"\n}\n", g_TLMPairTestsAre);
+    return (fclose(file) == 0 ? 0 : -1);
+}
+
+/* prefix.csv with the ticks in the ring and prefix.json with the match's totals */
+int TLM_Write(TLM_Telemetry *telemetry, const char *prefix) {
+    char filename[256];
+    snprintf(filename, sizeof(filename), "%s.csv", prefix);
+    int result = TLM_WriteCSV(telemetry, filename);
+    snprintf(filename, sizeof(filename), "%s.json", prefix);
+    result |= TLM_WriteJSON(telemetry, filename);
+    if (result == 0) LogInfo("Telemetry of %d ticks in %s.csv and .json", telemetry->tick_cnt, prefix);
+    return result;
+}
\ No newline at end of file
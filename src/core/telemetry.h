@@ -0,0 +1,49 @@
+#ifndef _TELEMETRY_H
+#define _TELEMETRY_H
+
+#include <SDL2/SDL.h>
+#include "elems/map.h"
+
+/*
+ * Work the simulation did in each tick of a match, from Map::counters.
+ * TLM_RecordTick takes them after every SIM_Step and clears them. The
+ * last TLM_RING_TICKS ticks are kept, the totals cover the whole match.
+ * TLM_Write puts the ticks in prefix.csv and a summary in prefix.json.
+ */
+
+#define TELEMETRY_FILE "bin/data/lastmatch"
+
+enum TLM_Constants {
+    TLM_RING_TICKS = 1 << 15
+};
+
+struct TLM_Tick {
+    Sint32 frame;
+    /* Since TLM_Start, to line ticks up with frame times */
+    float ms;
+    Uint32 troop_cnt;
+    MapCounters counters;
+};
+typedef struct TLM_Tick TLM_Tick;
+
+struct TLM_Telemetry {
+    int map_id;
+    Uint64 seed;
+    Uint64 start;
+    TLM_Tick *ticks;
+    /* Ticks recorded in all, the ring holds the last TLM_RING_TICKS of them */
+    int tick_cnt;
+    int first_frame;
+    MapCounters totals;
+    Uint32 peak_troop_cnt;
+    int peak_frame;
+};
+typedef struct TLM_Telemetry TLM_Telemetry;
+
+extern TLM_Telemetry* TLM_Start(Map *map, Uint64 seed);
+extern void TLM_Destroy(TLM_Telemetry *telemetry);
+
+extern void TLM_RecordTick(TLM_Telemetry *telemetry, Map *map);
+extern int TLM_Write(TLM_Telemetry *telemetry, const char *prefix);
+
+#endif /* _TELEMETRY_H */
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdlib.h>
+#include <string.h>
+#include "text.h"
+#include "video.h"
+#include "log.h"
+
+enum TXT_PrivateConstants {
+    ATLAS_COLS = 16,
+    MAX_BATCH_GLYPHS = 128
+};
+
+/* Fonts live until TXT_Quit, screens ask for them every time they open */
+TXT_Font *g_Fonts = NULL;
+
+TXT_Glyph* TXT_GetGlyph(TXT_Font *font, char c) {
+    if (c < TXT_FIRST_GLYPH || c > TXT_LAST_GLYPH) c = '?';
+    return &font->glyphs[c - TXT_FIRST_GLYPH];
+}
+
+/* White glyphs on a transparent atlas, tinted with color mod when drawn */
+int TXT_BuildAtlas(TXT_Font *font) {
+    SDL_Surface *glyphs[TXT_GLYPH_CNT];
+    int cell_w = 1, cell_h = 1;
+    for (int i = 0; i < TXT_GLYPH_CNT; i++) {
+        char s[2] = {TXT_FIRST_GLYPH + i, 0};
+        glyphs[i] = TTF_RenderText_Solid(font->ttf, s, (SDL_Color){255, 255, 255, 255});
+        if (glyphs[i] != NULL) {
+            cell_w = SDL_max(cell_w, glyphs[i]->w);
+            cell_h = SDL_max(cell_h, glyphs[i]->h);
+        }
+        int advance = 0;
+        TTF_GlyphMetrics(font->ttf, TXT_FIRST_GLYPH + i, NULL, NULL, NULL, NULL, &advance);
+        font->glyphs[i].advance = advance;
+    }
+    int rows = (TXT_GLYPH_CNT + ATLAS_COLS - 1) / ATLAS_COLS;
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_COLS * cell_w, rows * cell_h,
+        32, SDL_PIXELFORMAT_ARGB8888);
+    if (atlas == NULL) {
+        LogError("Unable to create glyph atlas: %s");
+        for (int i = 0; i < TXT_GLYPH_CNT; i++) SDL_FreeSurface(glyphs[i]);
+        return -1;
+    }
+    SDL_FillRect(atlas, NULL, SDL_MapRGBA(atlas->format, 0, 0, 0, 0));
+    for (int i = 0; i < TXT_GLYPH_CNT; i++) {
+        SDL_Rect *rect = &font->glyphs[i].rect;
+        rect->x = (i % ATLAS_COLS) * cell_w;
+        rect->y = (i / ATLAS_COLS) * cell_h;
+        rect->w = (glyphs[i] ? glyphs[i]->w : 0);
+        rect->h = (glyphs[i] ? glyphs[i]->h : 0);
+        if (glyphs[i] == NULL) continue;
+        SDL_BlitSurface(glyphs[i], NULL, atlas, rect);
+        SDL_FreeSurface(glyphs[i]);
+    }
+    font->atlas = SDL_CreateTextureFromSurface(VDO_GetRenderer(), atlas);
+    SDL_FreeSurface(atlas);
+    if (font->atlas == NULL) {
+        LogError("Unable to create glyph atlas texture: %s");
+        return -1;
+    }
+    SDL_SetTextureBlendMode(font->atlas, SDL_BLENDMODE_BLEND);
+    font->height = cell_h;
+    font->digit_advance = TXT_GetGlyph(font, '0')->advance;
+    for (char c = '1'; c <= '9'; c++) {
+        if (TXT_GetGlyph(font, c)->advance != font->digit_advance) font->digit_advance = -1;
+    }
+    return 0;
+}
+
+TXT_Font* TXT_GetFont(const char *path, int size) {
+    for (TXT_Font *font = g_Fonts; font != NULL; font = font->next) {
+        if (font->size == size && !strcmp(font->path, path)) return font;
+    }
+    TXT_Font *font = malloc(sizeof(TXT_Font));
+    memset(font, 0, sizeof(TXT_Font));
+    SDL_strlcpy(font->path, path, sizeof(font->path));
+    font->size = size;
+    font->ttf = TTF_OpenFont(path, size);
+    if (font->ttf == NULL) {
+        LogInfo("TTF_Error: %s", TTF_GetError());
+        free(font);
+        return NULL;
+    }
+    if (TXT_BuildAtlas(font) != 0) {
+        TTF_CloseFont(font->ttf);
+        free(font);
+        return NULL;
+    }
+    font->next = g_Fonts;
+    g_Fonts = font;
+    return font;
+}
+
+void TXT_Quit() {
+    while (g_Fonts != NULL) {
+        TXT_Font *next = g_Fonts->next;
+        SDL_DestroyTexture(g_Fonts->atlas);
+        TTF_CloseFont(g_Fonts->ttf);
+        free(g_Fonts);
+        g_Fonts = next;
+    }
+}
+
+/*
+ * Every event loop passes its events here. After a reset of the render
+ * targets or the device the atlases are gone and are built again.
+ */
+void TXT_HandleRenderReset(const SDL_Event *e) {
+    if (e->type != SDL_RENDER_TARGETS_RESET && e->type != SDL_RENDER_DEVICE_RESET) return;
+    for (TXT_Font *font = g_Fonts; font != NULL; font = font->next) {
+        SDL_DestroyTexture(font->atlas);
+        font->atlas = NULL;
+        /* Logged by TXT_BuildAtlas if it fails, the font then draws nothing */
+        TXT_BuildAtlas(font);
+    }
+}
+
+int TXT_GetWidth(TXT_Font *font, const char *s) {
+    int width = 0;
+    for (; *s; s++) width += TXT_GetGlyph(font, *s)->advance;
+    return width;
+}
+
+/* Every glyph of s in one draw call, left edge at x and top at y */
+void TXT_DrawGlyphs(SDL_Renderer *renderer, TXT_Font *font, const char *s, int len,
+        SDL_Color color, int x, int y) {
+    /* Lost to a render reset it couldn't be rebuilt after */
+    if (font->atlas == NULL) return;
+    SDL_SetTextureColorMod(font->atlas, color.r, color.g, color.b);
+    SDL_SetTextureAlphaMod(font->atlas, color.a);
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    SDL_Vertex vertices[4 * MAX_BATCH_GLYPHS];
+    int indices[6 * MAX_BATCH_GLYPHS];
+    int atlas_w, atlas_h;
+    SDL_QueryTexture(font->atlas, NULL, NULL, &atlas_w, &atlas_h);
+    SDL_Color white = {255, 255, 255, 255};
+    int quad_cnt = 0;
+    for (int i = 0; i < len; i++) {
+        TXT_Glyph *glyph = TXT_GetGlyph(font, s[i]);
+        SDL_Rect r = glyph->rect;
+        float x1 = x, y1 = y, x2 = x + r.w, y2 = y + r.h;
+        float u1 = 1.0f * r.x / atlas_w, v1 = 1.0f * r.y / atlas_h;
+        float u2 = 1.0f * (r.x + r.w) / atlas_w, v2 = 1.0f * (r.y + r.h) / atlas_h;
+        SDL_Vertex *v = &vertices[4 * quad_cnt];
+        v[0] = (SDL_Vertex){{x1, y1}, white, {u1, v1}};
+        v[1] = (SDL_Vertex){{x2, y1}, white, {u2, v1}};
+        v[2] = (SDL_Vertex){{x2, y2}, white, {u2, v2}};
+        v[3] = (SDL_Vertex){{x1, y2}, white, {u1, v2}};
+        int *idx = &indices[6 * quad_cnt], base = 4 * quad_cnt;
+        idx[0] = base; idx[1] = base + 1; idx[2] = base + 2;
+        idx[3] = base; idx[4] = base + 2; idx[5] = base + 3;
+        x += glyph->advance;
+        if (++quad_cnt == MAX_BATCH_GLYPHS || i == len - 1) {
+            SDL_RenderGeometry(renderer, font->atlas, vertices, 4 * quad_cnt, indices, 6 * quad_cnt);
+            quad_cnt = 0;
+        }
+    }
+#else
+    /* The renderer batches consecutive copies from one texture */
+    for (int i = 0; i < len; i++) {
+        TXT_Glyph *glyph = TXT_GetGlyph(font, s[i]);
+        SDL_Rect box = {x, y, glyph->rect.w, glyph->rect.h};
+        SDL_RenderCopy(renderer, font->atlas, &glyph->rect, &box);
+        x += glyph->advance;
+    }
+#endif
+}
+
+int TXT_Write(SDL_Renderer *renderer, TXT_Font *font, const char *s, SDL_Color color,
+        int x, int y) {
+    if (font == NULL) return -1;
+    int width = TXT_GetWidth(font, s);
+    TXT_DrawGlyphs(renderer, font, s, strlen(s), color, x - width / 2, y - font->height / 2);
+    return 0;
+}
+
+/* Counters change every tick, so skip sprintf and measure digits directly */
+int TXT_WriteInt(SDL_Renderer *renderer, TXT_Font *font, int value, SDL_Color color,
+        int x, int y) {
+    if (font == NULL) return -1;
+    char buffer[12];
+    int len = 0;
+    unsigned int u = (value < 0 ? -(unsigned int)value : (unsigned int)value);
+    do {
+        buffer[sizeof(buffer) - 1 - len++] = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    if (value < 0) buffer[sizeof(buffer) - 1 - len++] = '-';
+    const char *s = buffer + sizeof(buffer) - len;
+    int width;
+    if (font->digit_advance >= 0 && value >= 0) {
+        width = len * font->digit_advance;
+    } else {
+        width = 0;
+        for (int i = 0; i < len; i++) width += TXT_GetGlyph(font, s[i])->advance;
+    }
+    TXT_DrawGlyphs(renderer, font, s, len, color, x - width / 2, y - font->height / 2);
+    return 0;
+}
\ No newline at end of file
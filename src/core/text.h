@@ -0,0 +1,50 @@
+#ifndef _TEXT_H
+#define _TEXT_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+/*
+ * Text drawn from a glyph atlas built once per (font file, size), so
+ * writing a string costs no surface or texture allocation.
+ */
+
+enum TXT_Constants {
+    TXT_FIRST_GLYPH = 32,
+    TXT_LAST_GLYPH = 126,
+    TXT_GLYPH_CNT = TXT_LAST_GLYPH - TXT_FIRST_GLYPH + 1
+};
+
+struct TXT_Glyph {
+    SDL_Rect rect; /* In the atlas */
+    int advance;
+};
+typedef struct TXT_Glyph TXT_Glyph;
+
+struct TXT_Font {
+    char path[64];
+    int size;
+    TTF_Font *ttf;
+    SDL_Texture *atlas;
+    int height;
+    TXT_Glyph glyphs[TXT_GLYPH_CNT];
+    /* Every digit has this advance, -1 if they differ */
+    int digit_advance;
+
+    struct TXT_Font *next;
+};
+typedef struct TXT_Font TXT_Font;
+
+extern TXT_Font* TXT_GetFont(const char *path, int size);
+extern void TXT_Quit(void);
+extern void TXT_HandleRenderReset(const SDL_Event *e);
+
+extern int TXT_GetWidth(TXT_Font *font, const char *s);
+
+/* Both write centered at (x, y) */
+extern int TXT_Write(SDL_Renderer *renderer, TXT_Font *font, const char *s, SDL_Color color,
+        int x, int y);
+extern int TXT_WriteInt(SDL_Renderer *renderer, TXT_Font *font, int value, SDL_Color color,
+        int x, int y);
+
+#endif /* _TEXT_H */
\ No newline at end of file
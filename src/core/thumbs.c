@@ -0,0 +1,168 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include "thumbs.h"
+#include "video.h"
+#include "log.h"
+
+MapCatalog *g_ThumbCatalog = NULL;
+THB_Slot *g_ThumbSlots = NULL;
+SDL_Color g_ThumbFill, g_ThumbBorder;
+SDL_Thread *g_ThumbThread = NULL;
+/* Posted whenever the worker may have something new to bake */
+SDL_sem *g_ThumbWake = NULL;
+/* Held for moving a slot out of or into THB_EMPTY */
+SDL_mutex *g_ThumbLock = NULL;
+SDL_atomic_t g_ThumbFirst, g_ThumbQuit;
+
+int THB_InWindow(int index, int first) {
+    return first - THB_WINDOW <= index && index < first + 2 * THB_WINDOW;
+}
+
+/* Area pixels in fill, those next to the outside in border, the rest transparent */
+SDL_Surface* THB_Bake(const Uint8 *thumbnail) {
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, MAP_THUMB_W, MAP_THUMB_H,
+        32, SDL_PIXELFORMAT_ARGB8888);
+    if (surface == NULL) return NULL;
+    Uint32 fill = SDL_MapRGBA(surface->format, g_ThumbFill.r, g_ThumbFill.g, g_ThumbFill.b, g_ThumbFill.a);
+    Uint32 border = SDL_MapRGBA(surface->format, g_ThumbBorder.r, g_ThumbBorder.g, g_ThumbBorder.b, g_ThumbBorder.a);
+    for (int y = 0; y < MAP_THUMB_H; y++) {
+        Uint32 *row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+        for (int x = 0; x < MAP_THUMB_W; x++) {
+            if (!ELE_GetThumbnailPixel(thumbnail, x, y)) {
+                row[x] = 0;
+            } else if (ELE_GetThumbnailPixel(thumbnail, x - 1, y) && ELE_GetThumbnailPixel(thumbnail, x + 1, y) &&
+                ELE_GetThumbnailPixel(thumbnail, x, y - 1) && ELE_GetThumbnailPixel(thumbnail, x, y + 1)) {
+                row[x] = fill;
+            } else {
+                row[x] = border;
+            }
+        }
+    }
+    return surface;
+}
+
+/* Empty slot in the window closest to the shown page, -1 if none. Under g_ThumbLock */
+int THB_NextSlot(int first) {
+    int cnt = g_ThumbCatalog->entry_cnt;
+    for (int d = 0; d < 2 * THB_WINDOW; d++) {
+        int index = first + d;
+        if (index < cnt && SDL_AtomicGet(&g_ThumbSlots[index].state) == THB_EMPTY) return index;
+        index = first - 1 - d;
+        if (d < THB_WINDOW && index >= 0 &&
+            SDL_AtomicGet(&g_ThumbSlots[index].state) == THB_EMPTY) return index;
+    }
+    return -1;
+}
+
+int THB_Worker(void *data) {
+    (void)data;
+    while (!SDL_AtomicGet(&g_ThumbQuit)) {
+        SDL_LockMutex(g_ThumbLock);
+        int index = THB_NextSlot(SDL_AtomicGet(&g_ThumbFirst));
+        if (index >= 0) SDL_AtomicSet(&g_ThumbSlots[index].state, THB_BAKING);
+        SDL_UnlockMutex(g_ThumbLock);
+        if (index < 0) {
+            SDL_SemWait(g_ThumbWake);
+            continue;
+        }
+        THB_Slot *slot = &g_ThumbSlots[index];
+        SDL_Surface *surface = THB_Bake(g_ThumbCatalog->entries[index].thumbnail);
+        SDL_LockMutex(g_ThumbLock);
+        /* Dropped if the page moved away while it was baked */
+        if (surface != NULL && THB_InWindow(index, SDL_AtomicGet(&g_ThumbFirst))) {
+            slot->surface = surface;
+            SDL_AtomicSet(&slot->state, THB_BAKED);
+        } else {
+            SDL_FreeSurface(surface);
+            SDL_AtomicSet(&slot->state, THB_EMPTY);
+        }
+        SDL_UnlockMutex(g_ThumbLock);
+        if (surface == NULL) {
+            LogError("Unable to bake thumbnail: %s");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Render thread only, slots the worker is baking are left to it */
+void THB_EmptySlot(THB_Slot *slot) {
+    SDL_LockMutex(g_ThumbLock);
+    int state = SDL_AtomicGet(&slot->state);
+    if (state != THB_BAKING) {
+        if (state == THB_BAKED) SDL_FreeSurface(slot->surface);
+        if (state == THB_UPLOADED && slot->texture != NULL) SDL_DestroyTexture(slot->texture);
+        slot->surface = NULL;
+        slot->texture = NULL;
+        SDL_AtomicSet(&slot->state, THB_EMPTY);
+    }
+    SDL_UnlockMutex(g_ThumbLock);
+}
+
+/* catalog must outlive THB_Quit */
+int THB_Start(MapCatalog *catalog, SDL_Color fill, SDL_Color border) {
+    g_ThumbCatalog = catalog;
+    g_ThumbFill = fill;
+    g_ThumbBorder = border;
+    g_ThumbSlots = calloc(SDL_max(catalog->entry_cnt, 1), sizeof(THB_Slot));
+    SDL_AtomicSet(&g_ThumbFirst, 0);
+    SDL_AtomicSet(&g_ThumbQuit, 0);
+    g_ThumbWake = SDL_CreateSemaphore(0);
+    g_ThumbLock = SDL_CreateMutex();
+    g_ThumbThread = SDL_CreateThread(THB_Worker, "thumbs", NULL);
+    if (g_ThumbThread == NULL) {
+        LogError("Unable to create thumbnail thread: %s");
+        return -1;
+    }
+    return 0;
+}
+
+void THB_Quit() {
+    if (g_ThumbSlots == NULL) return;
+    SDL_AtomicSet(&g_ThumbQuit, 1);
+    if (g_ThumbThread != NULL) {
+        SDL_SemPost(g_ThumbWake);
+        SDL_WaitThread(g_ThumbThread, NULL);
+    }
+    for (int i = 0; i < g_ThumbCatalog->entry_cnt; i++) THB_EmptySlot(&g_ThumbSlots[i]);
+    SDL_DestroySemaphore(g_ThumbWake);
+    SDL_DestroyMutex(g_ThumbLock);
+    free(g_ThumbSlots);
+    g_ThumbSlots = NULL;
+    g_ThumbThread = NULL;
+    g_ThumbCatalog = NULL;
+}
+
+/* Index of the first entry shown, frees what fell out of the window */
+void THB_SetPage(int first) {
+    if (SDL_AtomicGet(&g_ThumbFirst) == first) return;
+    SDL_AtomicSet(&g_ThumbFirst, first);
+    for (int i = 0; i < g_ThumbCatalog->entry_cnt; i++) {
+        if (!THB_InWindow(i, first)) THB_EmptySlot(&g_ThumbSlots[i]);
+    }
+    SDL_SemPost(g_ThumbWake);
+}
+
+/* NULL until the worker got to it */
+SDL_Texture* THB_GetTexture(int index) {
+    if (g_ThumbSlots == NULL || index < 0 || index >= g_ThumbCatalog->entry_cnt) return NULL;
+    THB_Slot *slot = &g_ThumbSlots[index];
+    if (SDL_AtomicGet(&slot->state) == THB_BAKED) {
+        slot->texture = SDL_CreateTextureFromSurface(VDO_GetRenderer(), slot->surface);
+        SDL_FreeSurface(slot->surface);
+        slot->surface = NULL;
+        /* Uploaded even on failure so it is not baked over and over */
+        SDL_AtomicSet(&slot->state, THB_UPLOADED);
+        if (slot->texture == NULL) LogError("Unable to create thumbnail texture: %s");
+    }
+    return slot->texture;
+}
+
+/* After a render device reset, textures are baked again */
+void THB_DropTextures() {
+    if (g_ThumbSlots == NULL) return;
+    for (int i = 0; i < g_ThumbCatalog->entry_cnt; i++) {
+        if (SDL_AtomicGet(&g_ThumbSlots[i].state) == THB_UPLOADED) THB_EmptySlot(&g_ThumbSlots[i]);
+    }
+    SDL_SemPost(g_ThumbWake);
+}
\ No newline at end of file
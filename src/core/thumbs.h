@@ -0,0 +1,43 @@
+#ifndef _THUMBS_H
+#define _THUMBS_H
+
+#include <SDL2/SDL.h>
+#include "elems/catalog.h"
+
+/*
+ * Thumbnail textures of catalog entries for the map chooser. A worker
+ * thread bakes the catalog bitmaps into surfaces, entries of the shown
+ * page first; the render thread only uploads finished ones. Textures
+ * outside THB_WINDOW entries around the page are dropped again.
+ */
+
+enum THB_Constants {
+    THB_WINDOW = 27
+};
+
+enum THB_SlotStates {
+    /* Nothing baked, the worker may take it */
+    THB_EMPTY,
+    /* Taken by the worker, the render thread leaves it alone */
+    THB_BAKING,
+    THB_BAKED,
+    THB_UPLOADED
+};
+
+struct THB_Slot {
+    SDL_atomic_t state;
+    /* Set by the worker while THB_BAKING */
+    SDL_Surface *surface;
+    /* Render thread only */
+    SDL_Texture *texture;
+};
+typedef struct THB_Slot THB_Slot;
+
+extern int THB_Start(MapCatalog *catalog, SDL_Color fill, SDL_Color border);
+extern void THB_Quit(void);
+
+extern void THB_SetPage(int first);
+extern SDL_Texture* THB_GetTexture(int index);
+extern void THB_DropTextures(void);
+
+#endif /* _THUMBS_H */
\ No newline at end of file
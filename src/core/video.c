@@ -1,9 +1,11 @@
 #include <SDL2/SDL.h>
 #include "video.h"
 #include "log.h"
+#include "prof.h"
 
 const int DEFAULT_WINDOW_W = 1024;
 const int DEFAULT_WINDOW_H = 768;
+const int DEFAULT_FPS = 60;
 
 const char *g_title = "state.io";
 
@@ -11,6 +13,11 @@ SDL_Window *g_Window = NULL;
 
 SDL_Renderer *g_Renderer = NULL;
 
+int g_VSync = 0;
+/* Frames per second VDO_Present sleeps to without vsync, 0 for no limit */
+int g_FPS = DEFAULT_FPS;
+Uint64 g_NextFrame = 0;
+
 int VDO_CreateWindow() {
     Uint32 flags = SDL_WINDOW_SHOWN;
     g_Window = SDL_CreateWindow(
@@ -37,6 +44,7 @@ int VDO_CreateRenderer() {
         return -1;
     }
     Uint32 flags = SDL_RENDERER_ACCELERATED;
+    if (g_VSync) flags |= SDL_RENDERER_PRESENTVSYNC;
     g_Renderer = SDL_CreateRenderer(
         g_Window,
         -1,
@@ -76,6 +84,37 @@ SDL_Renderer * VDO_GetRenderer() {
     return g_Renderer;
 }
 
+/* Only takes effect for renderers created afterwards */
+void VDO_SetVSync(int vsync) {
+    g_VSync = vsync;
+}
+
+void VDO_SetFPS(int fps) {
+    g_FPS = SDL_max(fps, 0);
+}
+
 int VDO_GetFPS() {
-    return 60;
+    return g_FPS;
+}
+
+/*
+ * Presents and, unless vsync already blocks, sleeps until the next
+ * frame. The profiler's frame ends here, sleep included.
+ */
+void VDO_Present() {
+    PRF_Begin(PRF_PRESENT);
+    SDL_RenderPresent(g_Renderer);
+    PRF_End(PRF_PRESENT);
+    if (!g_VSync && g_FPS != 0) {
+        Uint64 freq = SDL_GetPerformanceFrequency();
+        Uint64 period = freq / g_FPS;
+        Uint64 now = SDL_GetPerformanceCounter();
+        /* Late frames push the schedule back rather than rushing to catch up */
+        if (g_NextFrame == 0 || now > g_NextFrame + period) g_NextFrame = now;
+        g_NextFrame += period;
+        if (now < g_NextFrame) SDL_Delay((g_NextFrame - now) * 1000 / freq);
+    }
+#ifdef PRF_ENABLED
+    PRF_EndFrame();
+#endif
 }
\ No newline at end of file
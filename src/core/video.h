@@ -14,6 +14,10 @@ extern void VDO_GetWindowSize(int *w, int *h);
 
 extern SDL_Renderer * VDO_GetRenderer(void);
 
+extern void VDO_SetVSync(int vsync);
+extern void VDO_SetFPS(int fps);
 extern int VDO_GetFPS(void);
 
+extern void VDO_Present(void);
+
 #endif /* _VIDEO_H */
\ No newline at end of file
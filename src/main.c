@@ -1,11 +1,41 @@
+#include <stdlib.h>
+#include <string.h>
 #include "core/game.h"
+#include "core/video.h"
 
-int main() {
+int main(int argc, char *argv[]) {
+    const char *seed = NULL, *replay = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--vsync")) {
+            VDO_SetVSync(1);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--fps")) {
+            VDO_SetFPS(atoi(argv[++i]));
+        } else if (i + 1 < argc && !strcmp(argv[i], "--speed")) {
+            GME_SetSpeed(atoi(argv[++i]));
+        } else if (i + 1 < argc && !strcmp(argv[i], "--autosave")) {
+            GME_SetAutosave(atoi(argv[++i]));
+        } else if (i + 1 < argc && !strcmp(argv[i], "--ai")) {
+            GME_SetAI(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--ai-budget")) {
+            GME_SetAIBudget(atoi(argv[++i]));
+        } else if (i + 1 < argc && !strcmp(argv[i], "--trace")) {
+            GME_SetTrace(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--seed")) {
+            seed = argv[++i];
+        } else if (i + 1 < argc && !strcmp(argv[i], "--replay")) {
+            replay = argv[++i];
+        }
+    }
     if (GME_Init() != 0) {
         GME_Quit();
         return 1;
     }
     atexit(GME_Quit);
-    GME_Start();
+    if (seed != NULL) GME_SetSeed(strtoull(seed, NULL, 10));
+    if (replay != NULL) {
+        GME_WatchReplay(replay);
+    } else {
+        GME_Start();
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "core/sim.h"
+#include "core/kernels.h"
+#include "core/log.h"
+#include "core/elems/player.h"
+#include "core/elems/map.h"
+
+enum BAT_Constants {
+    DEFAULT_PLAYER_CNT = 5,
+    MAX_PLAYER_CNT = 11,
+    DEFAULT_MATCH_CNT = 100,
+    DEFAULT_MAX_TICKS = 216000, /* One hour at 60 frames */
+    MAX_THREAD_CNT = 256
+};
+
+struct BAT_Result {
+    int map;
+    Uint64 seed;
+    /* Player id, -1 if there was none within max_ticks */
+    int winner;
+    int ticks;
+    int score[MAX_PLAYER_CNT];
+};
+typedef struct BAT_Result BAT_Result;
+
+struct BAT_Batch {
+    /* Mapped once, workers only read their geometry */
+    Map **maps;
+    const char **map_names;
+    int map_cnt;
+    int player_cnt;
+    int match_cnt;
+    int max_ticks;
+    Uint64 seed;
+    SDL_atomic_t next_match;
+    BAT_Result *results;
+};
+typedef struct BAT_Batch BAT_Batch;
+
+void BAT_Usage(const char *prog) {
+    printf("usage: %s [--maps FILE...] [--matches N] [--threads N] [--players N]\n", prog);
+    printf("       [--ticks N] [--seed N] [--out FILE]\n");
+}
+
+/* Match number match plays on maps[match % map_cnt] with seed + match */
+void BAT_RunMatch(BAT_Batch *batch, int match, Player **players, BAT_Result *result) {
+    result->map = match % batch->map_cnt;
+    result->seed = batch->seed + match;
+    result->winner = -1;
+    result->ticks = 0;
+    for (int i = 0; i < batch->player_cnt; i++) {
+        players[i]->score = 0;
+    }
+    Map *map = ELE_CloneMapGeometry(batch->maps[result->map]);
+    SIM_SeedMatch(map, result->seed);
+    if (SIM_StartMatch(map, players, batch->player_cnt) == 0) {
+        Player *winner = NULL;
+        while (result->ticks < batch->max_ticks) {
+            winner = SIM_GetWinner(map);
+            if (winner != NULL) break;
+            SIM_Step(map, NULL, 0);
+            ++result->ticks;
+        }
+        if (winner != NULL) {
+            SIM_ScoreMatch(map, winner);
+            result->winner = winner->id;
+        }
+    }
+    for (int i = 0; i < batch->player_cnt; i++) {
+        result->score[i] = players[i]->score;
+    }
+    ELE_DestroyMap(map);
+}
+
+int BAT_Worker(void *data) {
+    BAT_Batch *batch = data;
+    Player *players[MAX_PLAYER_CNT];
+    for (int i = 0; i < batch->player_cnt; i++) {
+        char name[16];
+        sprintf(name, "AI%d", i);
+        players[i] = ELE_CreatePlayer(i, name, (SDL_Color){0, 0, 0, 255}, 0);
+    }
+    int match;
+    while ((match = SDL_AtomicAdd(&batch->next_match, 1)) < batch->match_cnt) {
+        BAT_RunMatch(batch, match, players, &batch->results[match]);
+    }
+    for (int i = 0; i < batch->player_cnt; i++) {
+        ELE_DestroyPlayer(players[i]);
+    }
+    return 0;
+}
+
+void BAT_WriteResults(BAT_Batch *batch, FILE *out) {
+    fprintf(out, "match,map,seed,winner,ticks");
+    for (int i = 0; i < batch->player_cnt; i++) {
+        fprintf(out, ",score%d", i);
+    }
+    fprintf(out, "\n");
+    for (int i = 0; i < batch->match_cnt; i++) {
+        BAT_Result *result = &batch->results[i];
+        fprintf(out, "%d,%s,%llu,%d,%d", i, batch->map_names[result->map],
+            (unsigned long long)result->seed, result->winner, result->ticks);
+        for (int j = 0; j < batch->player_cnt; j++) {
+            fprintf(out, ",%d", result->score[j]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    BAT_Batch batch;
+    const char *default_map = "bin/data/map0";
+    batch.map_names = malloc(sizeof(char*) * argc);
+    batch.map_cnt = 0;
+    batch.player_cnt = DEFAULT_PLAYER_CNT;
+    batch.match_cnt = DEFAULT_MATCH_CNT;
+    batch.max_ticks = DEFAULT_MAX_TICKS;
+    batch.seed = time(NULL);
+    int thread_cnt = SDL_GetCPUCount();
+    const char *out_name = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--maps")) {
+            while (i + 1 < argc && strncmp(argv[i + 1], "--", 2)) {
+                batch.map_names[batch.map_cnt++] = argv[++i];
+            }
+        } else if (i + 1 < argc && !strcmp(argv[i], "--matches")) {
+            batch.match_cnt = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--threads")) {
+            thread_cnt = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--players")) {
+            batch.player_cnt = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--ticks")) {
+            batch.max_ticks = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--seed")) {
+            batch.seed = strtoull(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--out")) {
+            out_name = argv[++i];
+        } else {
+            BAT_Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (batch.map_cnt == 0) batch.map_names[batch.map_cnt++] = default_map;
+    if (batch.player_cnt < 2 || batch.player_cnt > MAX_PLAYER_CNT) {
+        LogInfo("Player count must be in [2, %d]", MAX_PLAYER_CNT);
+        return 1;
+    }
+    if (batch.match_cnt < 0) batch.match_cnt = 0;
+    thread_cnt = SDL_max(1, SDL_min(thread_cnt, MAX_THREAD_CNT));
+    KRN_Init(KRN_BEST);
+    batch.maps = malloc(sizeof(Map*) * batch.map_cnt);
+    for (int i = 0; i < batch.map_cnt; i++) {
+        batch.maps[i] = ELE_MapMapFile(batch.map_names[i], 0, NULL);
+        if (batch.maps[i] == NULL || batch.maps[i]->area_cnt < batch.player_cnt) {
+            LogInfo("Unable to use map %s", batch.map_names[i]);
+            return 1;
+        }
+    }
+    FILE *out = stdout;
+    if (out_name != NULL && (out = fopen(out_name, "w")) == NULL) {
+        LogInfo("Unable to open %s", out_name);
+        return 1;
+    }
+    batch.results = malloc(sizeof(BAT_Result) * SDL_max(batch.match_cnt, 1));
+    SDL_AtomicSet(&batch.next_match, 0);
+    Uint64 start = SDL_GetPerformanceCounter();
+    SDL_Thread *threads[MAX_THREAD_CNT];
+    for (int i = 0; i < thread_cnt; i++) {
+        threads[i] = SDL_CreateThread(BAT_Worker, "batch", &batch);
+    }
+    for (int i = 0; i < thread_cnt; i++) {
+        if (threads[i] == NULL) {
+            /* Remaining matches are picked up by the other workers */
+            LogError("Unable to create worker thread: %s");
+            continue;
+        }
+        SDL_WaitThread(threads[i], NULL);
+    }
+    /* Covers the case where no worker could be started */
+    BAT_Worker(&batch);
+    double secs = 1.0 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    BAT_WriteResults(&batch, out);
+    if (out != stdout) fclose(out);
+    int wins[MAX_PLAYER_CNT] = {0}, draws = 0;
+    for (int i = 0; i < batch.match_cnt; i++) {
+        if (batch.results[i].winner < 0) ++draws;
+        else ++wins[batch.results[i].winner];
+    }
+    fprintf(stderr, "%d matches on %d maps with %d threads in %.2f s (%.1f matches/s)\n",
+        batch.match_cnt, batch.map_cnt, thread_cnt, secs, batch.match_cnt / (secs > 0 ? secs : 1e-9));
+    for (int i = 0; i < batch.player_cnt; i++) {
+        fprintf(stderr, "AI%d: %d wins\n", i, wins[i]);
+    }
+    fprintf(stderr, "no winner: %d\n", draws);
+    for (int i = 0; i < batch.map_cnt; i++) {
+        ELE_DestroyMap(batch.maps[i]);
+    }
+    free(batch.maps);
+    free(batch.map_names);
+    free(batch.results);
+    return 0;
+}
\ No newline at end of file
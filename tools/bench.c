@@ -0,0 +1,655 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "core/sim.h"
+#include "core/kernels.h"
+#include "core/rng.h"
+#include "core/log.h"
+#include "core/autosave.h"
+#include "core/elems/player.h"
+#include "core/elems/registry.h"
+#include "core/elems/playerdb.h"
+#include "core/elems/area.h"
+#include "core/elems/troop.h"
+#include "core/elems/map.h"
+#include "core/elems/mapfile.h"
+
+enum BEN_Constants {
+    PLAYER_CNT = 5,
+    DEFAULT_TROOP_CNT = 5000,
+    DEFAULT_TICK_CNT = 1000,
+    NEAR_QUERY_CNT = 64,
+    DEFAULT_DRAW_CNT = 100000000,
+    DEFAULT_MAP_AREA_CNT = 10000,
+    DEFAULT_MAP_REP_CNT = 3,
+    DEFAULT_SAVE_CNT = 100,
+    DEFAULT_CLONE_CNT = 100000,
+    CLONE_BATCH_CNT = 256,
+    DEFAULT_REGISTRY_PLAYER_CNT = 50000,
+    DEFAULT_SCORE_UPDATE_CNT = 1000000,
+    DEFAULT_MATCH_RESULT_CNT = 10000,
+    SCOREBOARD_ROWS = 15,
+    DEFAULT_AREA_QUERY_CNT = 10000,
+    AREA_PICK_DIST = 25,
+    NEAREST_AREA_CNT = 33,
+    SHIPPED_MAP_CNT = 3,
+    SYNTHETIC_VERTEX_CNT = 360
+};
+
+struct BEN_Benchmark {
+    const char *name;
+    const char *usage;
+    int (*run)(int argc, char *argv[]);
+};
+typedef struct BEN_Benchmark BEN_Benchmark;
+
+Player *g_BenchPlayers[PLAYER_CNT];
+RNG g_BenchRng;
+
+double BEN_Seconds(Uint64 start) {
+    return 1.0 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+}
+
+int BEN_ArgInt(int argc, char *argv[], int i, int def) {
+    return (i < argc ? atoi(argv[i]) : def);
+}
+
+/* Map file mapid with PLAYER_CNT AI players placed, or NULL */
+Map* BEN_LoadMatch(int mapid) {
+    for (int i = 0; i < PLAYER_CNT; i++) {
+        if (g_BenchPlayers[i] != NULL) continue;
+        char name[16];
+        sprintf(name, "AI%d", i);
+        g_BenchPlayers[i] = ELE_CreatePlayer(i, name, (SDL_Color){0, 0, 0, 255}, 0);
+    }
+    Map *map = ELE_LoadMap(mapid, 0, NULL);
+    if (map == NULL) return NULL;
+    if (SIM_StartMatch(map, g_BenchPlayers, PLAYER_CNT) != 0) {
+        ELE_DestroyMap(map);
+        return NULL;
+    }
+    return map;
+}
+
+/* Troops between random pairs of areas, somewhere along their path */
+void BEN_SpawnTroops(Map *map, int troop_cnt) {
+    for (int i = 0; i < troop_cnt; i++) {
+        int from = RNG_Below(&g_BenchRng, map->area_cnt);
+        int to = RNG_Below(&g_BenchRng, map->area_cnt);
+        if (from == to) to = (from + 1) % map->area_cnt;
+        Area *src = map->areas[from], *dst = map->areas[to];
+        Fixed ux, uy;
+        ELE_GetDirection(src->center, dst->center, &ux, &uy);
+        int t = 20 + RNG_Below(&g_BenchRng, 100);
+        ELE_AddTroopToMap(map, map->next_troop_id++, i % map->player_cnt,
+            ELE_IntToFixed(src->center.x) + t * ux, ELE_IntToFixed(src->center.y) + t * uy, from, to);
+    }
+}
+
+/* Per tick direction from the troop's source and destination, as GME_Move used to */
+void BEN_TrigMoveTroops(Map *map) {
+    TroopStore *troops = map->troops;
+    for (int i = 0; i < troops->cnt; i++) {
+        SDL_Point s = map->areas[troops->src[i]]->center;
+        double PI = acos(-1), theta;
+        if (s.x != troops->dx[i]) {
+            theta = atan(1.0 * (s.y - troops->dy[i]) / (s.x - troops->dx[i]));
+        } else {
+            theta = (s.y < troops->dy[i] ? PI / 2 : -PI / 2);
+        }
+        if (s.x > troops->dx[i]) theta += PI;
+        troops->x[i] = troops->x[i] + 0.5 * cos(theta) * FIXED_ONE;
+        troops->y[i] = troops->y[i] + 0.5 * sin(theta) * FIXED_ONE;
+    }
+}
+
+int BEN_Move(int argc, char *argv[]) {
+    int troop_cnt = BEN_ArgInt(argc, argv, 0, DEFAULT_TROOP_CNT);
+    int tick_cnt = BEN_ArgInt(argc, argv, 1, DEFAULT_TICK_CNT);
+    Map *map = BEN_LoadMatch(0);
+    if (map == NULL) return 1;
+    BEN_SpawnTroops(map, troop_cnt);
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < tick_cnt; i++) BEN_TrigMoveTroops(map);
+    double trig = BEN_Seconds(start);
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < tick_cnt; i++) SIM_MoveTroops(map, 0);
+    double velocity = BEN_Seconds(start);
+    double troop_ticks = 1.0 * troop_cnt * tick_cnt;
+    printf("move %d troops x %d ticks\n", troop_cnt, tick_cnt);
+    printf("  trig      %8.2f ns/troop %10.1f us/tick\n",
+        trig * 1e9 / troop_ticks, trig * 1e6 / tick_cnt);
+    printf("  velocity  %8.2f ns/troop %10.1f us/tick\n",
+        velocity * 1e9 / troop_ticks, velocity * 1e6 / tick_cnt);
+    ELE_DestroyMap(map);
+    return 0;
+}
+
+/*
+ * Runs every kernel variant the CPU supports on the same troops and
+ * checks its output against the scalar one.
+ */
+int BEN_Kernels(int argc, char *argv[]) {
+    int troop_cnt = BEN_ArgInt(argc, argv, 0, DEFAULT_TROOP_CNT);
+    int tick_cnt = BEN_ArgInt(argc, argv, 1, DEFAULT_TICK_CNT);
+    Map *map = BEN_LoadMatch(0);
+    if (map == NULL) return 1;
+    BEN_SpawnTroops(map, troop_cnt);
+    TroopStore *troops = map->troops;
+    int n = troops->cnt;
+    int speed[PLAYER_CNT] = {KRN_SPEED_ONE / 2, KRN_SPEED_ONE, KRN_SPEED_ONE / 2, 0, KRN_SPEED_ONE / 2};
+    Fixed *x = malloc(sizeof(Fixed) * n), *y = malloc(sizeof(Fixed) * n);
+    int *xi = malloc(sizeof(int) * n), *yi = malloc(sizeof(int) * n);
+    Uint8 *status = malloc(n);
+    int *near = malloc(sizeof(int) * n);
+    Fixed *ref_x = malloc(sizeof(Fixed) * n), *ref_y = malloc(sizeof(Fixed) * n);
+    int *ref_xi = malloc(sizeof(int) * n), *ref_yi = malloc(sizeof(int) * n);
+    Uint8 *ref_status = malloc(n);
+    Uint64 ref_near = 0;
+    printf("kernels %d troops x %d ticks, million troops/s\n", n, tick_cnt);
+    printf("  %-8s %10s %10s %10s\n", "variant", "move", "status", "near");
+    for (int level = KRN_SCALAR; level < KRN_BEST; level++) {
+        KRN_MoveFunc move;
+        KRN_StatusFunc status_func;
+        KRN_NearFunc near_func;
+        if (KRN_GetKernels(level, &move, &status_func, &near_func) != 0) {
+            printf("  %-8s unsupported\n", KRN_GetLevelName(level));
+            continue;
+        }
+        memcpy(x, troops->x, sizeof(Fixed) * n);
+        memcpy(y, troops->y, sizeof(Fixed) * n);
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int t = 0; t < tick_cnt; t++) {
+            move(x, y, xi, yi, troops->vx, troops->vy, troops->owner, speed, n);
+        }
+        double move_secs = BEN_Seconds(start);
+        start = SDL_GetPerformanceCounter();
+        for (int t = 0; t < tick_cnt; t++) {
+            status_func(troops->x, troops->y, troops->xi, troops->yi, troops->dx, troops->dy,
+                n, map->w, map->h, 40, status);
+        }
+        double status_secs = BEN_Seconds(start);
+        /* Checksum of every hit so variants can be compared */
+        Uint64 near_sum = 0;
+        start = SDL_GetPerformanceCounter();
+        for (int t = 0; t < tick_cnt; t++) {
+            int q = (t % NEAR_QUERY_CNT) * (n / NEAR_QUERY_CNT);
+            int near_cnt = near_func(troops->xi, troops->yi, n, troops->xi[q], troops->yi[q], 40, near);
+            for (int k = 0; k < near_cnt; k++) near_sum = near_sum * 31 + near[k];
+        }
+        double near_secs = BEN_Seconds(start);
+        int same = 1;
+        if (level == KRN_SCALAR) {
+            memcpy(ref_x, x, sizeof(Fixed) * n);
+            memcpy(ref_y, y, sizeof(Fixed) * n);
+            memcpy(ref_xi, xi, sizeof(int) * n);
+            memcpy(ref_yi, yi, sizeof(int) * n);
+            memcpy(ref_status, status, n);
+            ref_near = near_sum;
+        } else {
+            same = !memcmp(ref_x, x, sizeof(Fixed) * n) && !memcmp(ref_y, y, sizeof(Fixed) * n) &&
+                !memcmp(ref_xi, xi, sizeof(int) * n) && !memcmp(ref_yi, yi, sizeof(int) * n) &&
+                !memcmp(ref_status, status, n) && ref_near == near_sum;
+        }
+        double troop_ticks = 1.0 * n * tick_cnt / 1e6;
+        printf("  %-8s %10.1f %10.1f %10.1f%s\n", KRN_GetLevelName(level),
+            troop_ticks / move_secs, troop_ticks / status_secs, troop_ticks / near_secs,
+            (same ? "" : "  MISMATCH"));
+    }
+    free(x); free(y); free(xi); free(yi); free(status); free(near);
+    free(ref_x); free(ref_y); free(ref_xi); free(ref_yi); free(ref_status);
+    ELE_DestroyMap(map);
+    return 0;
+}
+
+/* Draws in [0, 2400) as the potion spawn does every tick */
+int BEN_Rng(int argc, char *argv[]) {
+    int draw_cnt = BEN_ArgInt(argc, argv, 0, DEFAULT_DRAW_CNT);
+    unsigned int sum = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < draw_cnt; i++) sum += rand() % 2400;
+    double libc = BEN_Seconds(start);
+    RNG rng;
+    RNG_Seed(&rng, 1, 0);
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < draw_cnt; i++) sum += RNG_Below(&rng, 2400);
+    double own = BEN_Seconds(start);
+    printf("rng %d draws (checksum %u)\n", draw_cnt, sum);
+    printf("  rand()    %8.2f ns/draw\n", libc * 1e9 / draw_cnt);
+    printf("  RNG_Below %8.2f ns/draw\n", own * 1e9 / draw_cnt);
+    return 0;
+}
+
+/* area_cnt round areas with bumpy borders on a square grid */
+Map* BEN_CreateSyntheticMap(int area_cnt) {
+    Map *map = ELE_CreateMap(0, NULL, 0, NULL, 0);
+    map->areas = malloc(sizeof(Area*) * area_cnt);
+    int cols = ceil(sqrt(area_cnt));
+    double PI = acos(-1);
+    SDL_Point vertices[SYNTHETIC_VERTEX_CNT];
+    for (int i = 0; i < area_cnt; i++) {
+        SDL_Point center = {100 + 200 * (i % cols), 100 + 200 * (i / cols)};
+        int radius = 60 + RNG_Below(&g_BenchRng, 30);
+        for (int v = 0; v < SYNTHETIC_VERTEX_CNT; v++) {
+            double alpha = 2 * PI * v / SYNTHETIC_VERTEX_CNT;
+            double r = radius + 4 * sin(5 * alpha) + RNG_Below(&g_BenchRng, 2);
+            vertices[v].x = center.x + cos(alpha) * r;
+            vertices[v].y = center.y + sin(alpha) * r;
+        }
+        map->areas[i] = ELE_CreateArea(i, ELE_GetAreaCapacityByRadius(radius),
+            center, radius, vertices, SYNTHETIC_VERTEX_CNT);
+        map->area_cnt++;
+    }
+    ELE_ResetMapState(map);
+    return map;
+}
+
+/* Map without match state in the v1 layout, one field per write */
+int BEN_SaveLegacyMap(Map *map, const char *filename) {
+    SDL_RWops *file = SDL_RWFromFile(filename, "w+b");
+    if (file == NULL) return -1;
+    SDL_RWwrite(file, &map->id, sizeof(int), 1);
+    SDL_RWwrite(file, &map->area_cnt, sizeof(int), 1);
+    for (int i = 0; i < map->area_cnt; i++) {
+        Area *area = map->areas[i];
+        AreaState *state = &map->area_states[i];
+        int conq_id = -1;
+        SDL_RWwrite(file, &area->id, sizeof(int), 1);
+        SDL_RWwrite(file, &conq_id, sizeof(int), 1);
+        SDL_RWwrite(file, &area->capacity, sizeof(int), 1);
+        SDL_RWwrite(file, &state->troop_cnt, sizeof(int), 1);
+        SDL_RWwrite(file, &state->troop_rate, sizeof(int), 1);
+        SDL_RWwrite(file, &state->troop_inc_delay, sizeof(int), 1);
+        SDL_RWwrite(file, &area->center, sizeof(SDL_Point), 1);
+        SDL_RWwrite(file, &area->radius, sizeof(int), 1);
+        SDL_RWwrite(file, &area->vertex_cnt, sizeof(int), 1);
+        for (int v = 0; v < area->vertex_cnt; v++) {
+            SDL_RWwrite(file, &area->vertices[v], sizeof(SDL_Point), 1);
+        }
+    }
+    SDL_RWclose(file);
+    return 0;
+}
+
+Sint64 BEN_FileSize(const char *filename) {
+    SDL_RWops *file = SDL_RWFromFile(filename, "rb");
+    if (file == NULL) return 0;
+    Sint64 size = SDL_RWsize(file);
+    SDL_RWclose(file);
+    return size;
+}
+
+/* flags of ELE_SaveMapFile, -1 for BEN_SaveLegacyMap */
+int BEN_SaveMapAs(Map *map, const char *filename, int flags) {
+    if (flags < 0) return BEN_SaveLegacyMap(map, filename);
+    return ELE_SaveMapFile(map, filename, flags);
+}
+
+int BEN_MapIO(int argc, char *argv[]) {
+    int area_cnt = BEN_ArgInt(argc, argv, 0, DEFAULT_MAP_AREA_CNT);
+    int rep_cnt = BEN_ArgInt(argc, argv, 1, DEFAULT_MAP_REP_CNT);
+    /* v2m is v2 loaded by ELE_MapMapFile */
+    const char *names[] = {"v1", "v2", "v2p", "v2m"};
+    const char *filenames[] = {"bench_map_v1.bin", "bench_map_v2.bin", "bench_map_v2p.bin", "bench_map_v2m.bin"};
+    int flags[] = {-1, 0, MAP_FILE_PACKED, 0};
+    int mapped[] = {0, 0, 0, 1};
+    int fmt_cnt = sizeof(flags) / sizeof(flags[0]);
+    Map *map = BEN_CreateSyntheticMap(area_cnt);
+    printf("mapio %d areas x %d vertices, %d reps\n", area_cnt, SYNTHETIC_VERTEX_CNT, rep_cnt);
+    printf("  %-4s %8s %10s %10s %10s %10s\n", "fmt", "MB", "save ms", "save MB/s", "load ms", "load MB/s");
+    for (int f = 0; f < fmt_cnt; f++) {
+        double save = 0, load = 0;
+        for (int r = 0; r < rep_cnt; r++) {
+            Uint64 start = SDL_GetPerformanceCounter();
+            if (BEN_SaveMapAs(map, filenames[f], flags[f]) != 0) return 1;
+            save += BEN_Seconds(start);
+            start = SDL_GetPerformanceCounter();
+            Map *loaded = (mapped[f] ? ELE_MapMapFile(filenames[f], 0, NULL)
+                : ELE_LoadMapFile(filenames[f], 0, NULL));
+            load += BEN_Seconds(start);
+            if (loaded == NULL || loaded->area_cnt != area_cnt) return 1;
+            ELE_DestroyMap(loaded);
+        }
+        double mb = BEN_FileSize(filenames[f]) / 1e6;
+        printf("  %-4s %8.2f %10.1f %10.1f %10.1f %10.1f\n", names[f], mb,
+            save * 1e3 / rep_cnt, mb * rep_cnt / save,
+            load * 1e3 / rep_cnt, mb * rep_cnt / load);
+        remove(filenames[f]);
+    }
+    ELE_DestroyMap(map);
+    return 0;
+}
+
+/* Time a match stalls per save, written in place versus handed to ASV_Save */
+int BEN_Autosave(int argc, char *argv[]) {
+    int troop_cnt = BEN_ArgInt(argc, argv, 0, DEFAULT_TROOP_CNT);
+    int save_cnt = BEN_ArgInt(argc, argv, 1, DEFAULT_SAVE_CNT);
+    const char *filename = "bench_lastmap.bin";
+    Uint32 flags = MAP_FILE_MATCH | MAP_FILE_PACKED;
+    Map *map = BEN_LoadMatch(0);
+    if (map == NULL) return 1;
+    BEN_SpawnTroops(map, troop_cnt);
+    double sync_max = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < save_cnt; i++) {
+        Uint64 save_start = SDL_GetPerformanceCounter();
+        if (ELE_SaveMapFile(map, filename, flags) != 0) return 1;
+        sync_max = SDL_max(sync_max, BEN_Seconds(save_start));
+    }
+    double sync = BEN_Seconds(start);
+    if (ASV_Init() != 0) return 1;
+    double async_max = 0;
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < save_cnt; i++) {
+        Uint64 save_start = SDL_GetPerformanceCounter();
+        if (ASV_Save(map, filename, flags, 0) != 0) return 1;
+        async_max = SDL_max(async_max, BEN_Seconds(save_start));
+    }
+    double async = BEN_Seconds(start);
+    ASV_Flush();
+    ASV_Stats stats;
+    ASV_GetStats(&stats);
+    ASV_Quit();
+    printf("autosave %d troops, %d saves of %lld bytes\n", troop_cnt, save_cnt, (long long)stats.last_size);
+    printf("  %-12s %10s %10s\n", "stall", "avg us", "max us");
+    printf("  %-12s %10.1f %10.1f\n", "synchronous", sync * 1e6 / save_cnt, sync_max * 1e6);
+    printf("  %-12s %10.1f %10.1f\n", "ASV_Save", async * 1e6 / save_cnt, async_max * 1e6);
+    printf("  snapshots: avg %llu us max %llu us\n",
+        (unsigned long long)(stats.total_snapshot_us / SDL_max(stats.snapshot_cnt, 1)),
+        (unsigned long long)stats.max_snapshot_us);
+    printf("  writer: %d writes avg %llu us max %llu us, %d snapshots superseded\n",
+        stats.write_cnt, (unsigned long long)(stats.total_write_us / SDL_max(stats.write_cnt, 1)),
+        (unsigned long long)stats.max_write_us, stats.superseded_cnt);
+    remove(filename);
+    ELE_DestroyMap(map);
+    return 0;
+}
+
+/*
+ * Match clones per second as a search would take them, CLONE_BATCH_CNT
+ * from one arena between resets, for each shipped map and troop count.
+ */
+int BEN_Clone(int argc, char *argv[]) {
+    int clone_cnt = BEN_ArgInt(argc, argv, 0, DEFAULT_CLONE_CNT);
+    const int troop_cnts[] = {0, 500, 5000};
+    ARN_Arena *arena = ARN_Create(0);
+    printf("clone %d matches\n", clone_cnt);
+    printf("  %-4s %7s %10s %12s %10s\n", "map", "troops", "bytes", "clones/s", "ns/clone");
+    for (int m = 0; m < SHIPPED_MAP_CNT; m++) {
+        for (int t = 0; t < (int)(sizeof(troop_cnts) / sizeof(troop_cnts[0])); t++) {
+            Map *map = BEN_LoadMatch(m);
+            if (map == NULL) continue;
+            BEN_SpawnTroops(map, troop_cnts[t]);
+            ARN_Reset(arena);
+            Map *clone = ELE_CloneMatch(map, arena, NULL);
+            if (clone == NULL || ELE_HashMatchState(clone) != ELE_HashMatchState(map)) {
+                printf("  map %d: clone differs from the match\n", m);
+                return 1;
+            }
+            Sint64 bytes = arena->used;
+            Uint64 start = SDL_GetPerformanceCounter();
+            for (int i = 0; i < clone_cnt; i++) {
+                if (i % CLONE_BATCH_CNT == 0) ARN_Reset(arena);
+                if (ELE_CloneMatch(map, arena, NULL) == NULL) return 1;
+            }
+            double seconds = BEN_Seconds(start);
+            printf("  %-4d %7d %10lld %12.0f %10.1f\n", m, troop_cnts[t], (long long)bytes,
+                clone_cnt / seconds, seconds * 1e9 / clone_cnt);
+            ELE_DestroyMap(map);
+        }
+    }
+    ARN_Destroy(arena);
+    return 0;
+}
+
+/* Registry of player_cnt players named P0 on, with random scores */
+PlayerRegistry* BEN_CreateRegistry(int player_cnt) {
+    PlayerRegistry *registry = ELE_CreatePlayerRegistry();
+    SDL_Color color = {0, 0, 0, 255};
+    for (int i = 0; i < player_cnt; i++) {
+        char name[16];
+        sprintf(name, "P%d", i);
+        ELE_AddPlayer(registry, ELE_CreatePlayer(i, name, color, RNG_Below(&g_BenchRng, 1000)));
+    }
+    return registry;
+}
+
+int BEN_CmpPlayersByRank(const void *first, const void *second) {
+    Player *f = *(Player**)first;
+    Player *s = *(Player**)second;
+    if (f->score != s->score) return (f->score < s->score ? 1 : -1);
+    return (f->id > s->id) - (f->id < s->id);
+}
+
+/*
+ * A registry of player_cnt players taking match results: score updates
+ * with the player ranked again, rank lookups and scoreboard pages, next
+ * to sorting a copy of every player and finding one by scanning.
+ */
+int BEN_Registry(int argc, char *argv[]) {
+    int player_cnt = SDL_max(BEN_ArgInt(argc, argv, 0, DEFAULT_REGISTRY_PLAYER_CNT), 1);
+    int update_cnt = BEN_ArgInt(argc, argv, 1, DEFAULT_SCORE_UPDATE_CNT);
+    Uint64 start = SDL_GetPerformanceCounter();
+    PlayerRegistry *registry = BEN_CreateRegistry(player_cnt);
+    double add = BEN_Seconds(start);
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < update_cnt; i++) {
+        Player *player = registry->players[RNG_Below(&g_BenchRng, player_cnt)];
+        player->score += (int)RNG_Below(&g_BenchRng, 5) - 1;
+        ELE_RankPlayer(registry, player);
+    }
+    double update = BEN_Seconds(start);
+    int rank_sum = 0;
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < update_cnt; i++) {
+        rank_sum += ELE_GetPlayerRank(registry, registry->players[RNG_Below(&g_BenchRng, player_cnt)]);
+    }
+    double rank = BEN_Seconds(start);
+    Player *page[SCOREBOARD_ROWS];
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < update_cnt; i++) {
+        rank_sum += ELE_GetPlayersByRank(registry, RNG_Below(&g_BenchRng, player_cnt), SCOREBOARD_ROWS, page);
+    }
+    double paging = BEN_Seconds(start);
+    int find_cnt = SDL_max(update_cnt / 100, 1);
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < find_cnt; i++) {
+        rank_sum += (ELE_FindPlayerById(registry, RNG_Below(&g_BenchRng, player_cnt)) != NULL);
+    }
+    double find = BEN_Seconds(start);
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < find_cnt; i++) {
+        rank_sum += (ELE_GetPlayerById(registry->players, player_cnt, RNG_Below(&g_BenchRng, player_cnt)) != NULL);
+    }
+    double scan = BEN_Seconds(start);
+    Player **sorted = malloc(sizeof(Player*) * player_cnt);
+    Player **ranked = malloc(sizeof(Player*) * player_cnt);
+    start = SDL_GetPerformanceCounter();
+    memcpy(sorted, registry->players, sizeof(Player*) * player_cnt);
+    qsort(sorted, player_cnt, sizeof(Player*), BEN_CmpPlayersByRank);
+    double sort = BEN_Seconds(start);
+    ELE_GetPlayersByRank(registry, 0, player_cnt, ranked);
+    int same = !memcmp(sorted, ranked, sizeof(Player*) * player_cnt);
+    printf("registry %d players, %d score updates (checksum %d)\n", player_cnt, update_cnt, rank_sum);
+    printf("  add          %10.1f ns/player\n", add * 1e9 / player_cnt);
+    printf("  rank again   %10.1f ns/update\n", update * 1e9 / SDL_max(update_cnt, 1));
+    printf("  rank of      %10.1f ns/query\n", rank * 1e9 / SDL_max(update_cnt, 1));
+    printf("  page of %-4d %10.1f ns/page\n", SCOREBOARD_ROWS, paging * 1e9 / SDL_max(update_cnt, 1));
+    printf("  find by id   %10.1f ns/lookup\n", find * 1e9 / find_cnt);
+    printf("  scan for id  %10.1f ns/lookup\n", scan * 1e9 / find_cnt);
+    printf("  sort a copy  %10.1f us/scoreboard\n", sort * 1e6);
+    printf("  ranking %s the sorted copy\n", (same ? "matches" : "differs from"));
+    free(sorted);
+    free(ranked);
+    ELE_DestroyPlayerRegistry(registry);
+    return !same;
+}
+
+/*
+ * Players database taking match_cnt results of PLAYER_CNT players, one
+ * record appended per player, next to rewriting every player as each
+ * save used to, then loaded back with the records appended.
+ */
+int BEN_PlayerDB(int argc, char *argv[]) {
+    int player_cnt = SDL_max(BEN_ArgInt(argc, argv, 0, DEFAULT_REGISTRY_PLAYER_CNT), PLAYER_CNT);
+    int match_cnt = BEN_ArgInt(argc, argv, 1, DEFAULT_MATCH_RESULT_CNT);
+    const char *filename = "bench_players.db";
+    remove(filename);
+    PlayerRegistry *registry = BEN_CreateRegistry(player_cnt);
+    PlayerDB *db = ELE_OpenPlayerDB(filename, registry);
+    if (db == NULL) return 1;
+    Uint64 start = SDL_GetPerformanceCounter();
+    if (ELE_CompactPlayerDB(db, registry) != 0) return 1;
+    double rewrite = BEN_Seconds(start);
+    Sint64 rewrite_size = BEN_FileSize(filename);
+    start = SDL_GetPerformanceCounter();
+    for (int m = 0; m < match_cnt; m++) {
+        for (int i = 0; i < PLAYER_CNT; i++) {
+            Player *player = registry->players[RNG_Below(&g_BenchRng, player_cnt)];
+            player->score += (i == 0 ? PLAYER_CNT - 1 : -1);
+            ELE_RankPlayer(registry, player);
+            ELE_AppendPlayer(db, player);
+        }
+    }
+    double append = BEN_Seconds(start);
+    Sint64 size = BEN_FileSize(filename);
+    /* Closed without compacting, to load every record appended */
+    fclose(db->file);
+    db->file = NULL;
+    ELE_ClosePlayerDB(db, registry);
+    PlayerRegistry *loaded = ELE_CreatePlayerRegistry();
+    start = SDL_GetPerformanceCounter();
+    db = ELE_OpenPlayerDB(filename, loaded);
+    double load = BEN_Seconds(start);
+    int same = (db != NULL && loaded->player_cnt == player_cnt);
+    for (int i = 0; same && i < player_cnt; i++) {
+        Player *player = ELE_FindPlayerById(loaded, registry->players[i]->id);
+        same = (player != NULL && player->score == registry->players[i]->score &&
+            ELE_GetPlayerRank(loaded, player) == ELE_GetPlayerRank(registry, registry->players[i]));
+    }
+    printf("playerdb %d players, %d match results\n", player_cnt, match_cnt);
+    printf("  rewrite all  %10.2f ms %10lld bytes/save\n", rewrite * 1e3, (long long)rewrite_size);
+    printf("  append       %10.2f us %10lld bytes/match\n", append * 1e6 / SDL_max(match_cnt, 1),
+        (long long)(size - rewrite_size) / SDL_max(match_cnt, 1));
+    printf("  load         %10.2f ms %10lld bytes\n", load * 1e3, (long long)size);
+    printf("  loaded players %s the saved ones\n", (same ? "match" : "differ from"));
+    ELE_ClosePlayerDB(db, loaded);
+    ELE_DestroyPlayerRegistry(loaded);
+    ELE_DestroyPlayerRegistry(registry);
+    remove(filename);
+    return !same;
+}
+
+/* Nearest max areas to (x, y) by looking at every one, ordered as ELE_GetNearestAreas */
+int BEN_ScanNearestAreas(Map *map, int x, int y, int *areas, int max) {
+    Sint64 dists[max];
+    int cnt = 0;
+    for (int i = 0; i < map->area_cnt; i++) {
+        Sint64 dx = map->areas[i]->center.x - x, dy = map->areas[i]->center.y - y;
+        Sint64 dist = dx * dx + dy * dy;
+        if (cnt == max && dist >= dists[cnt - 1]) continue;
+        int at = (cnt < max ? cnt++ : cnt - 1);
+        for (; at > 0 && dists[at - 1] > dist; at--) {
+            dists[at] = dists[at - 1];
+            areas[at] = areas[at - 1];
+        }
+        dists[at] = dist;
+        areas[at] = i;
+    }
+    return cnt;
+}
+
+/*
+ * Clicks around area centers and nearest area queries anywhere on a map
+ * of area_cnt areas, through the area grid and by looking at every area.
+ */
+int BEN_AreaQueries(int argc, char *argv[]) {
+    int area_cnt = SDL_max(BEN_ArgInt(argc, argv, 0, DEFAULT_MAP_AREA_CNT), 1);
+    int query_cnt = SDL_max(BEN_ArgInt(argc, argv, 1, DEFAULT_AREA_QUERY_CNT), 1);
+    Map *map = BEN_CreateSyntheticMap(area_cnt);
+    int w = map->area_grid->cols * map->area_grid->cell_size;
+    int h = map->area_grid->rows * map->area_grid->cell_size;
+    SDL_Point *clicks = malloc(sizeof(SDL_Point) * query_cnt);
+    SDL_Point *points = malloc(sizeof(SDL_Point) * query_cnt);
+    for (int i = 0; i < query_cnt; i++) {
+        SDL_Point center = map->areas[RNG_Below(&g_BenchRng, area_cnt)]->center;
+        clicks[i].x = center.x + (int)RNG_Below(&g_BenchRng, 2 * AREA_PICK_DIST) - AREA_PICK_DIST;
+        clicks[i].y = center.y + (int)RNG_Below(&g_BenchRng, 2 * AREA_PICK_DIST) - AREA_PICK_DIST;
+        points[i].x = RNG_Below(&g_BenchRng, w);
+        points[i].y = RNG_Below(&g_BenchRng, h);
+    }
+    int *picked = malloc(sizeof(int) * query_cnt);
+    int near[NEAREST_AREA_CNT], scanned[NEAREST_AREA_CNT];
+    int same = 1, hit_cnt = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < query_cnt; i++) picked[i] = ELE_GetAreaAt(map, clicks[i].x, clicks[i].y, AREA_PICK_DIST);
+    double pick = BEN_Seconds(start);
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < query_cnt; i++) {
+        int found = -1;
+        for (int a = 0; a < map->area_cnt && found < 0; a++) {
+            SDL_Point center = map->areas[a]->center;
+            if (abs(clicks[i].x - center.x) + abs(clicks[i].y - center.y) < AREA_PICK_DIST) found = a;
+        }
+        hit_cnt += (found >= 0);
+        same &= (found == picked[i]);
+    }
+    double pick_scan = BEN_Seconds(start);
+    int near_sum = 0;
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < query_cnt; i++) {
+        near_sum += ELE_GetNearestAreas(map, points[i].x, points[i].y, near, NEAREST_AREA_CNT);
+    }
+    double nearest = BEN_Seconds(start);
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < query_cnt; i++) {
+        near_sum += BEN_ScanNearestAreas(map, points[i].x, points[i].y, scanned, NEAREST_AREA_CNT);
+    }
+    double nearest_scan = BEN_Seconds(start);
+    for (int i = 0; i < query_cnt && same; i++) {
+        int cnt = ELE_GetNearestAreas(map, points[i].x, points[i].y, near, NEAREST_AREA_CNT);
+        same = (cnt == BEN_ScanNearestAreas(map, points[i].x, points[i].y, scanned, NEAREST_AREA_CNT) &&
+            !memcmp(near, scanned, sizeof(int) * cnt));
+    }
+    printf("areas %d areas, %d queries, %dx%d cells (checksum %d)\n", area_cnt, query_cnt,
+        map->area_grid->cols, map->area_grid->rows, near_sum);
+    printf("  pick          %10.1f ns/click, %d hit\n", pick * 1e9 / query_cnt, hit_cnt);
+    printf("  pick by scan  %10.1f ns/click\n", pick_scan * 1e9 / query_cnt);
+    printf("  nearest %-4d  %10.1f ns/query\n", NEAREST_AREA_CNT, nearest * 1e9 / query_cnt);
+    printf("  by scan       %10.1f ns/query\n", nearest_scan * 1e9 / query_cnt);
+    printf("  grid %s the scans\n", (same ? "matches" : "differs from"));
+    free(clicks);
+    free(points);
+    free(picked);
+    ELE_DestroyMap(map);
+    return !same;
+}
+
+const BEN_Benchmark g_Benchmarks[] = {
+    {"move", "[troops] [ticks]", BEN_Move},
+    {"kernels", "[troops] [ticks]", BEN_Kernels},
+    {"rng", "[draws]", BEN_Rng},
+    {"mapio", "[areas] [reps]", BEN_MapIO},
+    {"autosave", "[troops] [saves]", BEN_Autosave},
+    {"clone", "[clones]", BEN_Clone},
+    {"registry", "[players] [updates]", BEN_Registry},
+    {"playerdb", "[players] [matches]", BEN_PlayerDB},
+    {"areas", "[areas] [queries]", BEN_AreaQueries}
+};
+
+int main(int argc, char *argv[]) {
+    int bench_cnt = sizeof(g_Benchmarks) / sizeof(g_Benchmarks[0]);
+    srand(1);
+    RNG_Seed(&g_BenchRng, 1, 0);
+    for (int i = 0; i < bench_cnt; i++) {
+        if (argc > 1 && !strcmp(argv[1], g_Benchmarks[i].name)) {
+            return g_Benchmarks[i].run(argc - 2, argv + 2);
+        }
+    }
+    printf("usage: %s <benchmark> [args]\n", argv[0]);
+    for (int i = 0; i < bench_cnt; i++) {
+        printf("  %s %s\n", g_Benchmarks[i].name, g_Benchmarks[i].usage);
+    }
+    return 1;
+}
\ No newline at end of file
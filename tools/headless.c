@@ -0,0 +1,179 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "core/sim.h"
+#include "core/ai.h"
+#include "core/kernels.h"
+#include "core/replay.h"
+#include "core/telemetry.h"
+#include "core/log.h"
+#include "core/elems/player.h"
+#include "core/elems/registry.h"
+#include "core/elems/map.h"
+
+enum HDL_Constants {
+    DEFAULT_PLAYER_CNT = 5,
+    MAX_PLAYER_CNT = 11,
+    DEFAULT_MAX_TICKS = 216000 /* One hour at 60 frames */
+};
+
+void HDL_Usage(const char *prog) {
+    printf("usage: %s [--map N] [--players N] [--ticks N] [--seed N] [--brute]\n", prog);
+    printf("       [--kernels scalar|sse2|avx2] [--record FILE] [--telemetry PREFIX]\n");
+    printf("       [--ai greedy|lookahead|random] [--ai-players N] [--ai-threads N] [--ai-budget US]\n");
+    printf("       %s --replay FILE [--seek FRAME]\n", prog);
+}
+
+/* Plays a replay from seek to its end as fast as it goes */
+int HDL_Replay(const char *filename, int seek) {
+    RPL_Replay *replay = RPL_LoadReplay(filename);
+    if (replay == NULL) return 1;
+    PlayerRegistry *players = ELE_CreatePlayerRegistry();
+    for (int i = 0; i < replay->player_cnt; i++) {
+        char name[16];
+        sprintf(name, "AI%d", replay->player_ids[i]);
+        Player *player = ELE_CreatePlayer(replay->player_ids[i], name, (SDL_Color){0, 0, 0, 255}, 0);
+        if (ELE_AddPlayer(players, player) != 0) ELE_DestroyPlayer(player);
+    }
+    Uint64 start = SDL_GetPerformanceCounter();
+    Map *map = RPL_Seek(replay, SDL_max(seek, replay->first_frame), players);
+    int result = (map == NULL);
+    if (map != NULL) {
+        double seek_secs = 1.0 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+        int seek_frame = map->frame;
+        start = SDL_GetPerformanceCounter();
+        int diverged = 0;
+        while (!diverged && map->frame < replay->last_frame) {
+            diverged = (RPL_Step(replay, map) != 0);
+        }
+        double secs = 1.0 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+        int ticks = map->frame - seek_frame;
+        Player *winner = SIM_GetWinner(map);
+        printf("replay of map %d seed %llu: seek to %d in %.1f ms, %s at %d, %s (%.0f ticks/s)\n",
+            replay->header.map_id, (unsigned long long)replay->header.seed, seek_frame, seek_secs * 1000,
+            (diverged ? "diverged" : "matched"), map->frame, (winner ? winner->name : "no winner"),
+            ticks / (secs > 0 ? secs : 1e-9));
+        result = diverged;
+        ELE_DestroyMap(map);
+    }
+    ELE_DestroyPlayerRegistry(players);
+    RPL_DestroyReplay(replay);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    int mapid = 0;
+    int player_cnt = DEFAULT_PLAYER_CNT;
+    int max_ticks = DEFAULT_MAX_TICKS;
+    Uint64 seed = time(NULL);
+    int collision_mode = COLLISION_GRID;
+    int kernel_level = KRN_BEST;
+    const char *record = NULL, *replay = NULL, *telemetry_prefix = NULL;
+    int seek = 0;
+    /* Players 0 to ai_player_cnt - 1 go with policy, the rest with SIM_RunAI */
+    const AI_Policy *policy = NULL;
+    int ai_player_cnt = 1, ai_thread_cnt = 0;
+    Uint64 ai_budget = 0;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && !strcmp(argv[i], "--map")) {
+            mapid = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--players")) {
+            player_cnt = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--ticks")) {
+            max_ticks = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--seed")) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--kernels")) {
+            ++i;
+            for (kernel_level = KRN_SCALAR; kernel_level < KRN_BEST; kernel_level++) {
+                if (!strcmp(argv[i], KRN_GetLevelName(kernel_level))) break;
+            }
+        } else if (i + 1 < argc && !strcmp(argv[i], "--record")) {
+            record = argv[++i];
+        } else if (i + 1 < argc && !strcmp(argv[i], "--telemetry")) {
+            telemetry_prefix = argv[++i];
+        } else if (i + 1 < argc && !strcmp(argv[i], "--replay")) {
+            replay = argv[++i];
+        } else if (i + 1 < argc && !strcmp(argv[i], "--seek")) {
+            seek = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--ai")) {
+            policy = AI_GetPolicy(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--ai-players")) {
+            ai_player_cnt = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--ai-threads")) {
+            ai_thread_cnt = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--ai-budget")) {
+            ai_budget = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--brute")) {
+            collision_mode = COLLISION_BRUTE;
+        } else {
+            HDL_Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (player_cnt < 2 || player_cnt > MAX_PLAYER_CNT) {
+        LogInfo("Player count must be in [2, %d]", MAX_PLAYER_CNT);
+        return 1;
+    }
+    KRN_Init(kernel_level);
+    if (replay != NULL) return HDL_Replay(replay, seek);
+    Player *players[MAX_PLAYER_CNT];
+    for (int i = 0; i < player_cnt; i++) {
+        char name[16];
+        sprintf(name, "AI%d", i);
+        players[i] = ELE_CreatePlayer(i, name, (SDL_Color){0, 0, 0, 255}, 0);
+    }
+    Map *map = ELE_LoadMap(mapid, 0, NULL);
+    if (map == NULL) return 1;
+    map->collision_mode = collision_mode;
+    SIM_SeedMatch(map, seed);
+    if (SIM_StartMatch(map, players, player_cnt) != 0) {
+        LogInfo("Unable to place players on map %d", mapid);
+        ELE_DestroyMap(map);
+        return 1;
+    }
+    AI_Pool *pool = NULL;
+    if (policy != NULL) {
+        map->commanded = (1u << SDL_max(0, SDL_min(ai_player_cnt, player_cnt))) - 1;
+        pool = AI_CreatePool(policy, map, ai_thread_cnt, ai_budget);
+    }
+    RPL_Recorder *recorder = (record ? RPL_StartRecording(record, map, seed) : NULL);
+    TLM_Telemetry *telemetry = (telemetry_prefix ? TLM_Start(map, seed) : NULL);
+    Player *winner = NULL;
+    SIM_Command cmds[SIM_MAX_TICK_CMDS];
+    Uint64 start = SDL_GetPerformanceCounter();
+    int tick;
+    for (tick = 0; tick < max_ticks; tick++) {
+        winner = SIM_GetWinner(map);
+        if (winner != NULL) break;
+        int cmd_cnt = (pool ? AI_Update(pool, map, cmds, SIM_MAX_TICK_CMDS) : 0);
+        SIM_Step(map, cmds, cmd_cnt);
+        if (recorder != NULL) RPL_RecordTick(recorder, map, cmds, cmd_cnt);
+        if (telemetry != NULL) TLM_RecordTick(telemetry, map);
+    }
+    RPL_StopRecording(recorder);
+    double secs = 1.0 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    printf("map %d seed %llu: %s after %d ticks (%.0f ticks/s)\n",
+        mapid, (unsigned long long)seed, (winner ? winner->name : "no winner"), tick, tick / (secs > 0 ? secs : 1e-9));
+    if (telemetry != NULL) {
+        TLM_Write(telemetry, telemetry_prefix);
+        printf("peak %u troops at %d, %u of %llu pair tests hit\n", telemetry->peak_troop_cnt,
+            telemetry->peak_frame, telemetry->totals.collisions, (unsigned long long)telemetry->totals.pair_tests);
+        TLM_Destroy(telemetry);
+    }
+    if (pool != NULL) {
+        AI_Stats stats;
+        AI_GetStats(pool, &stats);
+        AI_DestroyPool(pool);
+        int decisions = SDL_max(stats.decision_cnt, 1);
+        printf("AI %s: %d decisions, %d commands, %.1f candidates each, %.0f us each, %.0f us max, %d over budget\n",
+            policy->name, stats.decision_cnt, stats.command_cnt, 1.0 * stats.evaluation_cnt / decisions,
+            1.0 * stats.total_us / decisions, 1.0 * stats.max_us, stats.timeout_cnt);
+    }
+    ELE_DestroyMap(map);
+    for (int i = 0; i < player_cnt; i++) {
+        ELE_DestroyPlayer(players[i]);
+    }
+    return 0;
+}
\ No newline at end of file